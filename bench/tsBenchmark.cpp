@@ -0,0 +1,533 @@
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsPacketSource.h"
+#include "tsUdpPacketSource.h"
+#include "tsPacketHeaderBatch.h"
+#include "tsStreamParser.h"
+#include "tsStreamGenerator.h"
+#include "tsRemuxer.h"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+/*
+Benchmarks of the parsing hot paths on synthetic streams (TS_StreamGenerator) - no sample files needed, the same
+bytes on every run. Throughput is reported as items_per_second (packets/s) and bytes_per_second.
+Some benchmarks also check an invariant of the measured code and report an error (SkipWithError) when it breaks.
+
+  cmake --build <build> --target run_benchmarks   - runs all, results in <build>/benchmark_results.json
+  TSBenchmark --benchmark_filter=Demux            - subset, --benchmark_out=<file> --benchmark_out_format=json
+*/
+
+//=============================================================================================================================================================================
+// streams
+//=============================================================================================================================================================================
+struct xStream {
+    std::vector<uint8_t> Data;
+    uint64_t NumPackets = 0;
+    std::vector<const uint8_t *> Packets;          //aligned streams only
+    std::vector<const uint8_t *> AdaptationFields; //packets with adaptation field
+    std::vector<const uint8_t *> PesHeaders;       //first byte of PES (packets with payload_unit_start_indicator)
+    std::vector<uint32_t> PesHeaderSizes;          //bytes of the packet from the PES start
+};
+
+static constexpr uint64_t NumStreamPackets = 100000;
+
+//NumPIDs, impaired (loss, misalignment) - generated once per configuration
+static const xStream &xGetStream(uint32_t NumPIDs, bool Impaired) {
+    static std::map<std::tuple<uint32_t, bool>, std::unique_ptr<xStream>> Streams;
+    std::unique_ptr<xStream> &Stream = Streams[std::make_tuple(NumPIDs, Impaired)];
+    if (Stream) return *Stream;
+
+    Stream.reset(new xStream);
+    TS_StreamGenerator::Config Config;
+    Config.NumPackets = NumStreamPackets;
+    Config.NumPIDs = NumPIDs;
+    Config.AdaptationFieldPermille = 100;
+    Config.PcrInterval = 40;
+    if (Impaired) {
+        Config.LossPermille = 5;
+        Config.MisalignmentInterval = 5000;
+    }
+    TS_StreamGenerator Generator(Config);
+    Generator.Generate(Stream->Data);
+    Stream->NumPackets = Generator.getNumPackets();
+    if (Impaired) return *Stream;
+
+    TS_PacketHeader Header;
+    TS_AdaptationField AdaptationField;
+    for (uint64_t i = 0; i < Stream->NumPackets; i++) {
+        const uint8_t *Packet = Stream->Data.data() + i * TS::TS_PacketLength;
+        Stream->Packets.push_back(Packet);
+        Header.Parse(Packet);
+        uint32_t PayloadOffset = TS::TS_HeaderLength;
+        if (Header.hasAdaptationField()) {
+            Stream->AdaptationFields.push_back(Packet);
+            AdaptationField.Parse(Packet);
+            PayloadOffset += 1 + AdaptationField.getAFLength();
+        }
+        if (Header.getPayloadUnitStartIndicator() && Header.getPID() >= Config.FirstPID &&
+            Header.getPID() < Config.FirstPID + NumPIDs) {
+            Stream->PesHeaders.push_back(Packet + PayloadOffset);
+            Stream->PesHeaderSizes.push_back(TS::TS_PacketLength - PayloadOffset);
+        }
+    }
+    return *Stream;
+}
+
+static void xSetThroughput(benchmark::State &State, uint64_t NumPackets, uint64_t NumBytes) {
+    State.SetItemsProcessed((int64_t) (State.iterations() * NumPackets));
+    State.SetBytesProcessed((int64_t) (State.iterations() * NumBytes));
+}
+
+//=============================================================================================================================================================================
+// header parsers
+//=============================================================================================================================================================================
+static void BM_PacketHeaderParse(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    TS_PacketHeader Header;
+    for (auto _ : State) {
+        uint32_t Sum = 0;
+        for (const uint8_t *Packet : Stream.Packets) {
+            Header.Parse(Packet);
+            Sum += Header.getPID() + Header.getContinuityCounter();
+        }
+        benchmark::DoNotOptimize(Sum);
+    }
+    xSetThroughput(State, Stream.Packets.size(), Stream.Packets.size() * TS::TS_PacketLength);
+}
+BENCHMARK(BM_PacketHeaderParse);
+
+//Arg: TS_PacketHeaderBatch::eKernel
+static void BM_PacketHeaderBatch(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    TS_PacketHeaderBatch Batch(TS_PacketSource::DefaultBatchSize);
+    if (!Batch.setKernel((TS_PacketHeaderBatch::eKernel) State.range(0))) {
+        State.SkipWithError("kernel not supported");
+        return;
+    }
+    const uint32_t BatchSize = TS_PacketSource::DefaultBatchSize;
+    for (auto _ : State) {
+        for (uint64_t i = 0; i < Stream.NumPackets; i += BatchSize) {
+            Batch.Decode(Stream.Data.data() + i * TS::TS_PacketLength,
+                         (uint32_t) std::min<uint64_t>(BatchSize, Stream.NumPackets - i));
+            benchmark::DoNotOptimize(Batch.PID.data());
+        }
+    }
+    xSetThroughput(State, Stream.NumPackets, Stream.NumPackets * TS::TS_PacketLength);
+}
+BENCHMARK(BM_PacketHeaderBatch)->Arg((int64_t) TS_PacketHeaderBatch::eKernel::Scalar)
+                               ->Arg((int64_t) TS_PacketHeaderBatch::eKernel::AVX2);
+
+//only the requested fields - PID + continuity counter, PID + PCR
+static void BM_LitePidCcParse(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    TS_PidCcHeader Header;
+    for (auto _ : State) {
+        uint32_t Sum = 0;
+        for (const uint8_t *Packet : Stream.Packets) {
+            Header.Parse(Packet);
+            Sum += Header.getPID() + Header.getContinuityCounter();
+        }
+        benchmark::DoNotOptimize(Sum);
+    }
+    xSetThroughput(State, Stream.Packets.size(), Stream.Packets.size() * TS::TS_PacketLength);
+}
+BENCHMARK(BM_LitePidCcParse);
+
+static void BM_LitePcrParse(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    TS_PcrHeader Header;
+    for (auto _ : State) {
+        int64_t Sum = 0;
+        for (const uint8_t *Packet : Stream.Packets) {
+            Header.Parse(Packet);
+            Sum += Header.getPID() + Header.getPCR();
+        }
+        benchmark::DoNotOptimize(Sum);
+    }
+    xSetThroughput(State, Stream.Packets.size(), Stream.Packets.size() * TS::TS_PacketLength);
+}
+BENCHMARK(BM_LitePcrParse);
+
+//full header and adaptation field parse of every packet - reference for BM_LitePcrParse
+static void BM_FullPcrParse(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    TS_PacketHeader Header;
+    TS_AdaptationField AdaptationField;
+    for (auto _ : State) {
+        int64_t Sum = 0;
+        for (const uint8_t *Packet : Stream.Packets) {
+            Header.Parse(Packet);
+            Sum += Header.getPID();
+            if (!Header.hasAdaptationField()) continue;
+            AdaptationField.Parse(Packet);
+            if (AdaptationField.getPCR()) Sum += AdaptationField.getPCR_data();
+        }
+        benchmark::DoNotOptimize(Sum);
+    }
+    xSetThroughput(State, Stream.Packets.size(), Stream.Packets.size() * TS::TS_PacketLength);
+}
+BENCHMARK(BM_FullPcrParse);
+
+static void BM_AdaptationFieldParse(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    TS_AdaptationField AdaptationField;
+    for (auto _ : State) {
+        int64_t Sum = 0;
+        for (const uint8_t *Packet : Stream.AdaptationFields) {
+            AdaptationField.Parse(Packet);
+            Sum += AdaptationField.getPCR() ? AdaptationField.getPCR_data() : AdaptationField.getAFLength();
+        }
+        benchmark::DoNotOptimize(Sum);
+    }
+    xSetThroughput(State, Stream.AdaptationFields.size(), Stream.AdaptationFields.size() * TS::TS_PacketLength);
+}
+BENCHMARK(BM_AdaptationFieldParse);
+
+static void BM_PesHeaderParse(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    PES_PacketHeader Header;
+    for (auto _ : State) {
+        uint64_t Sum = 0;
+        for (size_t i = 0; i < Stream.PesHeaders.size(); i++) {
+            Header.Parse(Stream.PesHeaders[i], Stream.PesHeaderSizes[i]);
+            Sum += Header.getHeaderLen() + (Header.hasPTS() ? Header.getPTS() : 0);
+        }
+        benchmark::DoNotOptimize(Sum);
+    }
+    xSetThroughput(State, Stream.PesHeaders.size(), Stream.PesHeaders.size() * TS::TS_PacketLength);
+}
+BENCHMARK(BM_PesHeaderParse);
+
+//clock reference flags not covered by adaptation_field_length and a PES header longer than 255 bytes
+static void BM_MalformedHeaderParse(benchmark::State &State) {
+    uint8_t ShortPCR[TS::TS_PacketLength], ShortOPCR[TS::TS_PacketLength];
+    memset(ShortPCR, 0xFF, sizeof(ShortPCR));
+    memset(ShortOPCR, 0xFF, sizeof(ShortOPCR));
+    const uint8_t ShortPCRHeader[] = {TS::TS_SyncByte, 0x01, 0x00, 0x20, 1, 0x10};
+    const uint8_t ShortOPCRHeader[] = {TS::TS_SyncByte, 0x01, 0x00, 0x20, 7, 0x18};
+    memcpy(ShortPCR, ShortPCRHeader, sizeof(ShortPCRHeader));
+    memcpy(ShortOPCR, ShortOPCRHeader, sizeof(ShortOPCRHeader));
+    const uint8_t LongPES[] = {0x00, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x80, 0x00, 250};
+    TS_AdaptationField AdaptationField;
+    PES_PacketHeader Header;
+    bool Valid = true;
+    for (auto _ : State) {
+        AdaptationField.Parse(ShortPCR);
+        Valid &= !AdaptationField.getPCR() && !AdaptationField.getOPCR() && AdaptationField.getStuffing() == 0;
+        AdaptationField.Parse(ShortOPCR);
+        Valid &= AdaptationField.getPCR() && !AdaptationField.getOPCR() && AdaptationField.getStuffing() == 0;
+        Header.Parse(LongPES, sizeof(LongPES));
+        Valid &= Header.getHeaderLen() == TS::PES_HeaderLength + 3 + 250;
+        benchmark::DoNotOptimize(AdaptationField.getPCR_data());
+    }
+    if (!Valid) State.SkipWithError("malformed header decoded");
+    xSetThroughput(State, 3, 3 * TS::TS_PacketLength);
+}
+BENCHMARK(BM_MalformedHeaderParse);
+
+//=============================================================================================================================================================================
+// packet sources
+//=============================================================================================================================================================================
+//192/204 byte packets behind a few junk bytes read in blocks - block boundaries cut through packets, fails on any
+//sync loss or lost packet, Args: packet size, junk bytes before the first packet
+static void BM_BlockSourceSync(benchmark::State &State) {
+    TS_StreamGenerator::Config Config;
+    Config.NumPackets = 20000;
+    Config.PacketSize = (uint32_t) State.range(0);
+    TS_StreamGenerator Generator(Config);
+    std::vector<uint8_t> Data((size_t) State.range(1), 0);
+    Generator.Generate(Data);
+
+    FILE *File = tmpfile();
+    if (File == nullptr || fwrite(Data.data(), 1, Data.size(), File) != Data.size() || fflush(File) != 0) {
+        State.SkipWithError("cannot write temporary file");
+        if (File) fclose(File);
+        return;
+    }
+    TS_PacketSpan Span;
+    for (auto _ : State) {
+        fseek(File, 0, SEEK_SET);
+        TS_BlockPacketSource Source(fileno(File));
+        while (Source.ReadBatch(Span)) benchmark::DoNotOptimize(Span.Data);
+        State.counters["SyncLosses"] = Source.getNumSyncLosses();
+        if (Source.getNumSyncLosses() != 0 || Source.getNumPacketsRead() != Generator.getNumPackets()) {
+            State.SkipWithError("block source lost sync");
+            break;
+        }
+    }
+    fclose(File);
+    xSetThroughput(State, Generator.getNumPackets(), Data.size());
+}
+BENCHMARK(BM_BlockSourceSync)->ArgNames({"PacketSize", "Offset"})
+                             ->Args({192, 0})->Args({192, 7})->Args({204, 4})->Args({204, 16});
+
+#if !defined(_WIN32)
+//7 packet datagrams over loopback, received by TS_UdpPacketSource - fails unless every packet arrives intact (in the
+//order sent) and, with RTP, every datagram is recognized and sequence gaps and late datagrams are counted. RTP bursts
+//alternate a plain header and a header with a CSRC, skip one sequence number, send one pair of datagrams swapped
+//(one gap, one late) and one datagram twice (one late), Arg: RTP
+static void BM_UdpLoopback(benchmark::State &State) {
+    static constexpr uint32_t NumDatagrams = 64;        //per burst, well within the default socket buffer
+    static constexpr uint32_t PacketsPerDatagram = 7;
+    static constexpr uint32_t Skipped = NumDatagrams / 2;  //datagrams from here on have their sequence number +1
+    static constexpr uint32_t Swapped = 10;                //sent after Swapped + 1
+    static constexpr uint32_t Duplicated = 20;
+    const bool Rtp = State.range(0) != 0;
+    const xStream &Stream = xGetStream(4, false);
+    TS_UdpPacketSource Source("127.0.0.1", 0);
+    Source.setIdleTimeout(1000);
+    const int Sender = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in Target;
+    memset(&Target, 0, sizeof(Target));
+    Target.sin_family = AF_INET;
+    Target.sin_port = htons(Source.getLocalPort());
+    inet_pton(AF_INET, "127.0.0.1", &Target.sin_addr);
+    if (!Source.isGood() || Sender < 0) {
+        State.SkipWithError("cannot open loopback sockets");
+        if (Sender >= 0) close(Sender);
+        return;
+    }
+
+    //send order of datagram indexes
+    std::vector<uint32_t> Order;
+    for (uint32_t d = 0; d < NumDatagrams; d++) {
+        Order.push_back(d);
+        if (Rtp && d == Duplicated) Order.push_back(d);
+    }
+    if (Rtp) std::swap(Order[Swapped], Order[Swapped + 1]);
+    std::vector<const uint8_t *> Expected;
+
+    uint8_t Datagram[16 + PacketsPerDatagram * TS::TS_PacketLength];
+    uint16_t Sequence = 0;
+    uint64_t NumBursts = 0;
+    TS_PacketSpan Span;
+    for (auto _ : State) {
+        Expected.clear();
+        for (uint32_t d : Order) {
+            uint32_t HeaderLength = 0;
+            if (Rtp) {
+                const uint16_t DatagramSequence = (uint16_t) (Sequence + d + (d >= Skipped ? 1 : 0));
+                HeaderLength = (d & 1) ? 16 : 12;
+                memset(Datagram, 0, HeaderLength);
+                Datagram[0] = (uint8_t) (0x80 | ((d & 1) ? 1 : 0)); //version 2, CSRC count
+                Datagram[1] = 33;                                    //MP2T
+                Datagram[2] = (uint8_t) (DatagramSequence >> 8);
+                Datagram[3] = (uint8_t) DatagramSequence;
+            }
+            memcpy(Datagram + HeaderLength, Stream.Packets[d * PacketsPerDatagram],
+                   PacketsPerDatagram * TS::TS_PacketLength);
+            for (uint32_t p = 0; p < PacketsPerDatagram; p++)
+                Expected.push_back(Stream.Packets[d * PacketsPerDatagram + p]);
+            sendto(Sender, Datagram, HeaderLength + PacketsPerDatagram * TS::TS_PacketLength, 0,
+                   (struct sockaddr *) &Target, sizeof(Target));
+        }
+        Sequence = (uint16_t) (Sequence + NumDatagrams + 1);
+        NumBursts++;
+
+        uint32_t NumReceived = 0;
+        bool Intact = true;
+        while (NumReceived < Expected.size() && Source.ReadBatch(Span)) {
+            for (uint32_t i = 0; i < Span.NumPackets && NumReceived + i < Expected.size(); i++)
+                Intact &= memcmp(Span.getPacket(i), Expected[NumReceived + i], TS::TS_PacketLength) == 0;
+            NumReceived += Span.NumPackets;
+        }
+        if (NumReceived != Expected.size() || !Intact) {
+            State.SkipWithError("packets lost or corrupted on loopback");
+            break;
+        }
+    }
+    close(Sender);
+    if (Rtp && (Source.getNumRtpDatagrams() != NumBursts * Order.size() || Source.getNumRtpLost() != NumBursts * 2 ||
+                Source.getNumRtpLate() != NumBursts * 2))
+        State.SkipWithError("RTP datagrams, sequence gaps or late datagrams miscounted");
+    xSetThroughput(State, NumDatagrams * PacketsPerDatagram, NumDatagrams * PacketsPerDatagram * TS::TS_PacketLength);
+}
+BENCHMARK(BM_UdpLoopback)->Arg(0)->Arg(1);
+#endif
+
+//=============================================================================================================================================================================
+// PES assembly
+//=============================================================================================================================================================================
+//Arg: zero-copy
+static void BM_PesAssemblerAbsorb(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    const uint16_t PID = TS_StreamGenerator::Config().FirstPID;
+    //headers are parsed up front - only the assembler is measured
+    std::vector<const uint8_t *> Packets;
+    std::vector<TS_PacketHeader> Headers;
+    std::vector<TS_AdaptationField> AdaptationFields;
+    TS_PacketHeader Header;
+    TS_AdaptationField AdaptationField;
+    for (const uint8_t *Packet : Stream.Packets) {
+        Header.Parse(Packet);
+        if (Header.getPID() != PID) continue;
+        if (Header.hasAdaptationField()) AdaptationField.Parse(Packet);
+        Packets.push_back(Packet);
+        Headers.push_back(Header);
+        AdaptationFields.push_back(AdaptationField);
+    }
+
+    PES_Assembler Assembler;
+    Assembler.Init(PID, nullptr, State.range(0) != 0);
+    for (auto _ : State) {
+        uint32_t NumStarted = 0;
+        for (size_t i = 0; i < Packets.size(); i++)
+            NumStarted += Assembler.AbsorbPacket(Packets[i], &Headers[i], &AdaptationFields[i]) ==
+                          PES_Assembler::eResult::AssemblingStarted;
+        benchmark::DoNotOptimize(NumStarted);
+    }
+    xSetThroughput(State, Packets.size(), Packets.size() * TS::TS_PacketLength);
+}
+BENCHMARK(BM_PesAssemblerAbsorb)->Arg(0)->Arg(1);
+
+//single stream of large PES packets, fresh assembler per iteration - fails unless the buffer grows geometrically
+//(O(log n) allocations for the largest PES instead of one per packet), Arg: PES payload bytes
+static void BM_PesAssemblerGrowth(benchmark::State &State) {
+    const uint32_t PesSize = (uint32_t) State.range(0);
+    TS_StreamGenerator::Config Config;
+    Config.NumPIDs = 1;
+    Config.MinPesSize = Config.MaxPesSize = PesSize;
+    Config.PcrInterval = 0;
+    Config.NumPackets = 4 * (PesSize / (TS::TS_PacketLength - TS::TS_HeaderLength) + 1);
+    std::vector<uint8_t> Data;
+    TS_StreamGenerator(Config).Generate(Data);
+
+    std::vector<const uint8_t *> Packets;
+    std::vector<TS_PacketHeader> Headers;
+    std::vector<TS_AdaptationField> AdaptationFields;
+    TS_PacketHeader Header;
+    TS_AdaptationField AdaptationField;
+    for (size_t Offset = 0; Offset + TS::TS_PacketLength <= Data.size(); Offset += TS::TS_PacketLength) {
+        Header.Parse(Data.data() + Offset);
+        if (Header.getPID() != Config.FirstPID) continue;
+        if (Header.hasAdaptationField()) AdaptationField.Parse(Data.data() + Offset);
+        Packets.push_back(Data.data() + Offset);
+        Headers.push_back(Header);
+        AdaptationFields.push_back(AdaptationField);
+    }
+
+    //initial capacity, then doubling up to the PES size (header included)
+    uint32_t MaxAllocations = 1;
+    for (uint64_t Capacity = PES_Assembler::InitialBufferCapacity; Capacity < PesSize + 64; Capacity *= 2)
+        MaxAllocations++;
+    for (auto _ : State) {
+        PES_Assembler Assembler;
+        Assembler.Init(Config.FirstPID, nullptr, false);
+        for (size_t i = 0; i < Packets.size(); i++)
+            Assembler.AbsorbPacket(Packets[i], &Headers[i], &AdaptationFields[i]);
+        State.counters["Allocations"] = Assembler.getNumBufferAllocations();
+        if (Assembler.getNumBufferAllocations() > MaxAllocations) {
+            State.SkipWithError("PES buffer allocations not O(log n)");
+            break;
+        }
+    }
+    xSetThroughput(State, Packets.size(), Packets.size() * TS::TS_PacketLength);
+}
+BENCHMARK(BM_PesAssemblerGrowth)->Arg(1 << 20)->Arg(8 << 20);
+
+//=============================================================================================================================================================================
+// end-to-end
+//=============================================================================================================================================================================
+class xCountingVisitor : public TS_Visitor {
+public:
+    uint64_t NumPES = 0;
+    uint64_t NumBytes = 0;
+
+    void onPesComplete(uint16_t, const PES_PacketHeader &, const TS_PayloadView *Views, uint32_t NumViews) {
+        NumPES++;
+        for (uint32_t v = 0; v < NumViews; v++) NumBytes += Views[v].Size;
+    }
+};
+
+//sync + PSI discovery + PES assembly of all streams, Args: NumPIDs, impaired, zero-copy
+static void BM_Demux(benchmark::State &State) {
+    const xStream &Stream = xGetStream((uint32_t) State.range(0), State.range(1) != 0);
+    for (auto _ : State) {
+        TS_MemoryPacketSource Source(Stream.Data.data(), Stream.Data.size());
+        xCountingVisitor Visitor;
+        TS_StreamParser<xCountingVisitor> Parser(Visitor);
+        Parser.setZeroCopy(State.range(2) != 0);
+        Parser.Run(Source);
+        benchmark::DoNotOptimize(Visitor.NumBytes);
+    }
+    xSetThroughput(State, Stream.NumPackets, Stream.Data.size());
+}
+BENCHMARK(BM_Demux)->ArgNames({"PIDs", "Impaired", "ZeroCopy"})
+                   ->Args({1, 0, 0})->Args({4, 0, 0})->Args({16, 0, 0})
+                   ->Args({4, 0, 1})->Args({4, 1, 0});
+
+//discards output - measures selection, PSI regeneration and view building only
+class xNullSink : public TS_OutputSink {
+public:
+    uint64_t NumBytes = 0;
+
+    bool Write(const TS_PayloadView *Views, uint32_t NumViews, bool) override {
+        for (uint32_t v = 0; v < NumViews; v++) NumBytes += Views[v].Size;
+        return true;
+    }
+
+    bool isGood() const override { return true; }
+};
+
+//PAT packets carrying a section without section_syntax_indicator and of zero length (00 30 00) - fails unless the
+//sections are rejected as broken and no program is registered, the remuxer runs the same handler
+static void BM_PsiMalformedPAT(benchmark::State &State) {
+    const uint32_t NumPackets = 4;
+    std::vector<uint8_t> Data(NumPackets * TS::TS_PacketLength, 0xFF);
+    for (uint32_t i = 0; i < NumPackets; i++) {
+        uint8_t *Packet = &Data[i * TS::TS_PacketLength];
+        const uint8_t Header[] = {TS::TS_SyncByte, 0x40, 0x00, (uint8_t) (0x10 | i), 0x00, 0x00, 0x30, 0x00};
+        memcpy(Packet, Header, sizeof(Header));
+    }
+    bool Rejected = true;
+    for (auto _ : State) {
+        TS_MemoryPacketSource Source(Data.data(), Data.size());
+        TS_Demuxer Demuxer;
+        PSI_PATHandler *PAT = Demuxer.AddHandler<PSI_PATHandler>((uint16_t) TS_PacketHeader::ePID::PAT, &Demuxer);
+        TS_PacketSpan Span;
+        while (Source.ReadBatch(Span)) Demuxer.Demux(Span);
+        Rejected &= PAT->getNumBrokenSections() == NumPackets && PAT->getPrograms().empty();
+
+        TS_MemoryPacketSource RemuxSource(Data.data(), Data.size());
+        TS_Remuxer Remuxer(new xNullSink);
+        Remuxer.Run(RemuxSource);
+        benchmark::DoNotOptimize(Remuxer.getNumPacketsOut());
+    }
+    if (!Rejected) State.SkipWithError("malformed PAT section accepted");
+    xSetThroughput(State, NumPackets, Data.size());
+}
+BENCHMARK(BM_PsiMalformedPAT);
+
+//all programs, Arg: remapped PIDs (every forwarded header rewritten)
+static void BM_Remux(benchmark::State &State) {
+    const xStream &Stream = xGetStream(4, false);
+    const TS_StreamGenerator::Config Config;
+    for (auto _ : State) {
+        TS_MemoryPacketSource Source(Stream.Data.data(), Stream.Data.size());
+        xNullSink *Sink = new xNullSink;
+        TS_Remuxer Remuxer(Sink);
+        if (State.range(0))
+            for (uint16_t p = 0; p < 4; p++) Remuxer.RemapPID(Config.FirstPID + p, Config.FirstPID + 0x100 + p);
+        Remuxer.Run(Source);
+        benchmark::DoNotOptimize(Sink->NumBytes);
+    }
+    xSetThroughput(State, Stream.NumPackets, Stream.Data.size());
+}
+BENCHMARK(BM_Remux)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
+
+//=============================================================================================================================================================================
@@ -1,81 +1,449 @@
 #include "tsCommon.h"
 #include "tsTransportStream.h"
-#include <fstream>
+#include "tsPacketSource.h"
+#include "tsUdpPacketSource.h"
+#include "tsDemuxer.h"
+#include "tsPSI.h"
+#include "tsPipeline.h"
+#include "tsChunkedDemuxer.h"
+#include "tsEventLog.h"
+#include "tsIndex.h"
+#include "tsTiming.h"
+#include "tsMonitor.h"
+#include "tsStreamParser.h"
+#include "tsVideoSplitter.h"
+#include "tsAudioSplitter.h"
+#include "tsStats.h"
+#include "tsRemuxer.h"
+#include "tsAsyncReader.h"
+#include <cstring>
+#include <cstdlib>
+#include <csignal>
 
 using namespace std;
 
+//live input runs until interrupted
+static TS_UdpPacketSource *LiveSource = nullptr;
+
+static void xStopLiveSource(int) {
+    if (LiveSource) LiveSource->Stop();
+}
+
+//-A: all inputs parsed by the async reader, runs until all of them end or interrupted
+static TS_AsyncReader *AsyncReader = nullptr;
+
+static void xStopAsyncReader(int) {
+    if (AsyncReader) AsyncReader->Stop();
+}
+
+//elementary streams of input N written to inN_pidPID.ext
+class xInputStreamFactory : public TS_StreamFactory {
+protected:
+    uint32_t m_Input;
+
+public:
+    xInputStreamFactory(uint32_t Input) : m_Input(Input) {};
+
+    TS_PacketHandler *CreateStreamHandler(TS_Demuxer *, uint16_t PID, uint8_t StreamType) override {
+        char FileName[48];
+        snprintf(FileName, sizeof(FileName), "in%u_pid%d.%s", m_Input, PID, PSI::getStreamTypeExtension(StreamType));
+        return new TS_PesHandler(PID, TS_OutputSink::Create(FileName), false);
+    }
+};
+
+//prints one line per PCR window
+class xTimingPrinter : public TS_TimingEngine {
+protected:
+    void xWindowCompleted(const TS_PcrWindow &W) override {
+        printf("PCR PID=%d Packet=%" PRIu64 " Time=%.3lfs Duration=%.3lfs PCRs=%d Bitrate=%.0lf Min=%.0lf Max=%.0lf "
+               "MaxInterval=%.3lfms PCR_ac=%.0lfns PCR_oj=%.0lfns PCR_fo=%.3lfppm RepErr=%d Disc=%d DiscErr=%d\n",
+               W.PID, W.FirstPacket, (double) W.StartPCR / TS::ExtendedClockFrequency_Hz,
+               (double) W.Duration / TS::ExtendedClockFrequency_Hz, W.NumPCRs, W.Bitrate, W.MinBitrate, W.MaxBitrate,
+               W.MaxInterval_ms, W.MaxAccuracy_ns, W.MaxOverallJitter_ns, W.FrequencyOffset_ppm,
+               W.NumRepetitionErrors, W.NumDiscontinuities, W.NumDiscontinuityErrors);
+    }
+};
+
+//prints every TR 101 290 error and one line per window with errors
+class xMonitorPrinter : public TS_Monitor {
+protected:
+    void xReportEvent(const Event &E) override {
+        printf("P%d %s PID=%d Packet=%" PRIu64 " Time=%.3lfs Value=%" PRId64 "\n", getPriority(E.Type),
+               getEventName(E.Type), E.PID, E.PacketIndex,
+               E.Time == NOT_VALID ? 0.0 : (double) E.Time / TS::ExtendedClockFrequency_Hz, E.Value);
+    }
+
+    void xWindowCompleted(const Window &W) override {
+        uint32_t NumErrors = 0;
+        for (uint32_t Count : W.Counts) NumErrors += Count;
+        if (NumErrors == 0) return;
+        printf("Window Time=%.3lfs Packets=%" PRIu64, (double) W.StartTime / TS::ExtendedClockFrequency_Hz,
+               W.NumPackets);
+        for (uint32_t e = 0; e < NumEvents; e++)
+            if (W.Counts[e]) printf(" %s=%d", getEventName((eEvent) e), W.Counts[e]);
+        printf("\n");
+    }
+};
+
+//prints one line per video access unit
+class xAccessUnitPrinter : public TS_AccessUnitSplitter {
+protected:
+    uint16_t m_PID;
+
+public:
+    xAccessUnitPrinter(uint16_t PID, eCodec Codec) : TS_AccessUnitSplitter(Codec), m_PID(PID) {};
+
+protected:
+    void xAccessUnit(const TS_AccessUnit &AU) override {
+        static const char SliceTypes[] = "?PBI";
+        printf("AU PID=%d Number=%" PRIu64 " Size=%d PTS=%" PRId64 " DTS=%" PRId64 " Type=%c Key=%d NALs=%d\n", m_PID,
+               AU.Number, AU.Size, AU.PTS, AU.DTS, SliceTypes[(int32_t) AU.SliceType + 1], AU.Keyframe ? 1 : 0,
+               AU.NumNALs);
+    }
+};
+
+//prints one line per audio frame
+class xAudioFramePrinter : public TS_AudioFrameSplitter {
+protected:
+    uint16_t m_PID;
+
+public:
+    xAudioFramePrinter(uint16_t PID, eCodec Codec) : TS_AudioFrameSplitter(Codec), m_PID(PID) {};
+
+protected:
+    void xAudioFrame(const TS_AudioFrame &Frame) override {
+        printf("Frame PID=%d Number=%" PRIu64 " Size=%d PTS=%" PRId64 " Samples=%d Rate=%d Views=%d\n", m_PID,
+               Frame.Number, Frame.Size, Frame.PTS, Frame.NumSamples, Frame.SampleRate, Frame.NumViews);
+    }
+};
+
+//access unit splitters for H.264/HEVC and audio frame splitters for MPEG audio/ADTS streams found in PMT
+class xAccessUnitVisitor : public TS_Visitor {
+protected:
+    unique_ptr<xAccessUnitPrinter> m_Splitters[TS_Demuxer::NumPIDs];
+    unique_ptr<xAudioFramePrinter> m_AudioSplitters[TS_Demuxer::NumPIDs];
+
+public:
+    void onStream(uint16_t PID, uint8_t StreamType) {
+        switch (StreamType) {
+            case PSI::eStreamType_H264:
+                m_Splitters[PID].reset(new xAccessUnitPrinter(PID, TS_AccessUnitSplitter::eCodec::H264));
+                break;
+            case PSI::eStreamType_HEVC:
+                m_Splitters[PID].reset(new xAccessUnitPrinter(PID, TS_AccessUnitSplitter::eCodec::HEVC));
+                break;
+            case PSI::eStreamType_MPEG1_Audio:
+            case PSI::eStreamType_MPEG2_Audio:
+                m_AudioSplitters[PID].reset(new xAudioFramePrinter(PID, TS_AudioFrameSplitter::eCodec::MPEG));
+                break;
+            case PSI::eStreamType_AAC_ADTS:
+                m_AudioSplitters[PID].reset(new xAudioFramePrinter(PID, TS_AudioFrameSplitter::eCodec::ADTS));
+                break;
+        }
+    }
+
+    void onPesComplete(uint16_t PID, const PES_PacketHeader &PESH, const TS_PayloadView *Views, uint32_t NumViews) {
+        if (m_Splitters[PID]) m_Splitters[PID]->AbsorbPES(PESH, Views, NumViews);
+        else if (m_AudioSplitters[PID]) m_AudioSplitters[PID]->AbsorbPES(PESH, Views, NumViews);
+    }
+
+    void Finish() {
+        for (uint32_t PID = 0; PID < TS_Demuxer::NumPIDs; PID++) {
+            if (m_Splitters[PID]) {
+                m_Splitters[PID]->Finish();
+                printf("PID=%d AccessUnits=%" PRIu64 " Keyframes=%" PRIu64 " NALs=%" PRIu64 "\n", PID,
+                       m_Splitters[PID]->getNumAccessUnits(), m_Splitters[PID]->getNumKeyframes(),
+                       m_Splitters[PID]->getNumNALs());
+            }
+            if (m_AudioSplitters[PID]) {
+                m_AudioSplitters[PID]->Finish();
+                printf("PID=%d AudioFrames=%" PRIu64 " Skipped=%" PRIu64 "B\n", PID,
+                       m_AudioSplitters[PID]->getNumFrames(), m_AudioSplitters[PID]->getNumSkippedBytes());
+            }
+        }
+    }
+};
+
 int main(int argc, char *argv[], char *envp[]) {
     freopen("out.txt", "w", stdout); //Save output to file
-    fstream stream;
-    stream.open("scr/input_files/example_new.ts", ios::in | ios::binary);
-    uint8_t packetBuffer[TS::TS_PacketLength];
+    //usage: Parser [input.ts|-|udp://addr:port]... [-A NumThreads] [-t NumWorkerThreads | -c NumChunks] [-z] [-f text|json|bin] [-o log] [-x index] [-p] [-m] [-a] [-s stats] [-b MaxPesBytes] [-B MaxTotalBytes]
+    //       [-r out.ts [-P ProgramNumber]... [-R FromPID:ToPID]... [-n] [-C Bitrate]]
+    const char *InputFileName = "scr/input_files/example_new.ts";
+    uint32_t NumWorkerThreads = 0;
+    uint32_t NumChunks = 0;
+    bool SinkOutput = false;
+    TS_EventLog::eFormat LogFormat = TS_EventLog::eFormat::Text;
+    const char *LogFileName = nullptr;
+    const char *IndexFileName = nullptr;
+    bool TimingAnalysis = false;
+    bool Monitoring = false;
+    bool AccessUnits = false;
+    const char *StatsFileName = nullptr;
+    uint32_t MaxPesBufferSize = 0;
+    uint64_t MaxTotalBufferSize = 0;
+    const char *RemuxFileName = nullptr;
+    vector<uint16_t> RemuxPrograms;
+    vector<pair<uint16_t, uint16_t>> RemuxRemaps;
+    bool RemuxStripNull = false;
+    uint64_t RemuxBitrate = 0;
+    vector<const char *> InputFileNames;
+    uint32_t NumAsyncThreads = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) NumWorkerThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) NumChunks = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-z") == 0) SinkOutput = true;
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "json") == 0) LogFormat = TS_EventLog::eFormat::NDJSON;
+            else if (strcmp(argv[i], "bin") == 0) LogFormat = TS_EventLog::eFormat::Binary;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) LogFileName = argv[++i];
+        else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc) IndexFileName = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0) TimingAnalysis = true;
+        else if (strcmp(argv[i], "-m") == 0) Monitoring = true;
+        else if (strcmp(argv[i], "-a") == 0) AccessUnits = true;
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) StatsFileName = argv[++i];
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) MaxPesBufferSize = (uint32_t) strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) MaxTotalBufferSize = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) RemuxFileName = argv[++i];
+        else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) RemuxPrograms.push_back((uint16_t) atoi(argv[++i]));
+        else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+            unsigned From = 0, To = 0;
+            if (sscanf(argv[++i], "%u:%u", &From, &To) == 2) RemuxRemaps.emplace_back((uint16_t) From, (uint16_t) To);
+        } else if (strcmp(argv[i], "-n") == 0) RemuxStripNull = true;
+        else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) RemuxBitrate = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "-A") == 0 && i + 1 < argc) NumAsyncThreads = atoi(argv[++i]);
+        else {
+            InputFileName = argv[i];
+            InputFileNames.push_back(argv[i]);
+        }
+    }
+
+    //-s: stage timings and per-PID counters in Prometheus text format, rewritten every second and at exit
+    unique_ptr<TS_StatsDumper> StatsDumper;
+    if (StatsFileName) {
+        if (TS_Stats::setEnabled(true)) StatsDumper.reset(new TS_StatsDumper(StatsFileName));
+        else fprintf(stderr, "Statistics not available - built without TS_ENABLE_STATS\n");
+    }
+
+    //-b/-B: bounded memory - PES buffer cap per PID and for all PIDs, PES over the limit are cut (Overflow)
+    TS_BufferLimits BufferLimits;
+    BufferLimits.MaxPesBufferSize = MaxPesBufferSize;
+    unique_ptr<TS_MemoryBudget> MemoryBudget;
+    if (MaxTotalBufferSize) {
+        MemoryBudget.reset(new TS_MemoryBudget(MaxTotalBufferSize));
+        BufferLimits.Budget = MemoryBudget.get();
+    }
+
+    //whole-file mode - chunks processed in parallel, no per-packet dump
+    if (NumChunks) {
+        TS_ChunkedDemuxer ChunkedDemuxer(NumChunks);
+        ChunkedDemuxer.setBufferLimits(BufferLimits);
+        if (!ChunkedDemuxer.Run(InputFileName)) {
+            cout << "Error loading the file.";
+            return 0;
+        }
+        printf("Packets=%" PRIu64 " Streams=%d\n", ChunkedDemuxer.getNumPackets(),
+               (int) ChunkedDemuxer.getStreams().size());
+        if (MemoryBudget)
+            printf("Memory: Limit=%" PRIu64 "B Peak=%" PRIu64 "B Rejected=%" PRIu64 "\n", MemoryBudget->getLimit(),
+                   MemoryBudget->getPeak(), MemoryBudget->getNumRejected());
+        return 0;
+    }
+
+    //many inputs on a few threads - demuxer per input, no per-packet dump
+    if (NumAsyncThreads) {
+        if (InputFileNames.empty()) InputFileNames.push_back(InputFileName);
+        TS_AsyncReader Reader(NumAsyncThreads);
+        vector<unique_ptr<xInputStreamFactory>> Factories;
+        vector<unique_ptr<TS_Demuxer>> Demuxers;
+        vector<int32_t> Inputs;
+        for (uint32_t i = 0; i < InputFileNames.size(); i++) {
+            Factories.emplace_back(new xInputStreamFactory(i));
+            Demuxers.emplace_back(new TS_Demuxer);
+            Demuxers[i]->setStreamFactory(Factories[i].get());
+            Demuxers[i]->setBufferLimits(BufferLimits);
+            Demuxers[i]->AddHandler<PSI_PATHandler>((uint16_t) TS_PacketHeader::ePID::PAT, Demuxers[i].get());
+            Inputs.push_back(Reader.AddFile(InputFileNames[i], Demuxers[i].get()));
+            if (Inputs[i] == NOT_VALID)
+                fprintf(stderr, "Error loading the file %s\n", InputFileNames[i]);
+        }
+        AsyncReader = &Reader;
+        signal(SIGINT, xStopAsyncReader);
+        Reader.Run();
+        signal(SIGINT, SIG_DFL);
+        AsyncReader = nullptr;
+        for (uint32_t i = 0; i < InputFileNames.size(); i++) {
+            if (Inputs[i] == NOT_VALID) continue;
+            const TS_PacketSource &InputSource = Reader.getSource((uint32_t) Inputs[i]);
+            printf("Input=%u Packets=%" PRIu64 " Dropped=%" PRIu64 " SyncLosses=%u Turns=%" PRIu64 "%s File=%s\n", i,
+                   Demuxers[i]->getNumPackets(), Demuxers[i]->getNumDroppedPackets(), InputSource.getNumSyncLosses(),
+                   Reader.getNumTurns((uint32_t) Inputs[i]), Reader.isFinished((uint32_t) Inputs[i]) ? "" : " Stopped",
+                   InputFileNames[i]);
+        }
+        return 0;
+    }
+    unique_ptr<TS_PacketSource> Source = TS_PacketSource::Open(InputFileName);
+    TS_PacketSpan Span;
     TS_PacketHeader PacketHeader;
     TS_AdaptationField PacketAdaptationField;
-    PES_Assembler PESAssembler136;
-    PESAssembler136.Init(136);
-    PES_Assembler PESAssembler174;
-    PESAssembler174.Init(174);
-    PES_Assembler::eResult Result;
-    int32_t PacketId = 0;
-    if (!stream.good()) {
+    TS_Demuxer Demuxer;
+    //elementary streams are registered automatically from PAT/PMT
+    //-z: writev/io_uring output, zero-copy when the input is memory mapped
+    PSI_SinkStreamFactory SinkFactory(Source->isPersistent());
+    if (SinkOutput) Demuxer.setStreamFactory(&SinkFactory);
+    Demuxer.setBufferLimits(BufferLimits);
+    Demuxer.AddHandler<PSI_PATHandler>((uint16_t) TS_PacketHeader::ePID::PAT, &Demuxer);
+    uint64_t PacketId = 0;
+    if (!Source->isGood()) {
         cout << "Error loading the file.";
         return 0;
     }
+    LiveSource = dynamic_cast<TS_UdpPacketSource *>(Source.get());
+    if (LiveSource) signal(SIGINT, xStopLiveSource);
 
+    //indexing pass - writes sidecar index, no per-packet dump
+    if (IndexFileName) {
+        TS_IndexBuilder IndexBuilder;
+        IndexBuilder.Build(*Source);
+        TS_Index Index;
+        if (!IndexBuilder.Write(IndexFileName) || !Index.Open(IndexFileName)) {
+            cout << "Error writing the index.";
+            return 0;
+        }
+        for (uint32_t s = 0; s < Index.getNumStreams(); s++)
+            printf("PID=%d PES=%" PRIu64 " PCR=%" PRIu64 "\n", Index.getStream(s).PID, Index.getStream(s).NumPes,
+                   Index.getStream(s).NumPcr);
+        return 0;
+    }
 
-    while (!stream.eof()) {
-
-        stream.read((char *) packetBuffer, TS::TS_PacketLength);
-        PacketHeader.Parse(packetBuffer);
+    //PCR timing analysis - one line per window and PCR PID, arrival times are used for live input
+    if (TimingAnalysis) {
+        xTimingPrinter Timing;
+        while (Source->ReadBatch(Span)) {
+            const uint64_t *Timestamps = LiveSource ? LiveSource->getTimestamps() : nullptr;
+            for (uint32_t i = 0; i < Span.NumPackets; i++) {
+                const uint8_t *packetBuffer = Span.getPacket(i);
+                PacketHeader.Parse(packetBuffer);
+                const bool HasAdaptationField = PacketHeader.hasAdaptationField();
+                if (HasAdaptationField) PacketAdaptationField.Parse(packetBuffer);
+                Timing.AbsorbPacket(PacketHeader, HasAdaptationField ? &PacketAdaptationField : nullptr,
+                                    Timestamps ? (int64_t) Timestamps[i] : NOT_VALID);
+            }
+        }
+        Timing.Finish();
+        return 0;
+    }
 
-        printf("%010d ", PacketId);
-        PacketHeader.Print();
+    //TR 101 290 monitoring - errors and error windows only
+    if (Monitoring) {
+        xMonitorPrinter Monitor;
+        while (Source->ReadBatch(Span)) {
+            const uint64_t *Timestamps = LiveSource ? LiveSource->getTimestamps() : nullptr;
+            for (uint32_t i = 0; i < Span.NumPackets; i++) {
+                const uint8_t *packetBuffer = Span.getPacket(i);
+                PacketHeader.Parse(packetBuffer);
+                const bool HasAdaptationField = PacketHeader.hasAdaptationField();
+                if (HasAdaptationField) PacketAdaptationField.Parse(packetBuffer);
+                Monitor.AbsorbPacket(packetBuffer, PacketHeader, HasAdaptationField ? &PacketAdaptationField : nullptr,
+                                     Timestamps ? (int64_t) Timestamps[i] : NOT_VALID);
+            }
+            Monitor.CheckSource(*Source);
+        }
+        Monitor.Finish();
+        for (uint32_t e = 0; e < TS_Monitor::NumEvents; e++)
+            printf("%s=%" PRIu64 "\n", TS_Monitor::getEventName((TS_Monitor::eEvent) e),
+                   Monitor.getCounter((TS_Monitor::eEvent) e));
+        return 0;
+    }
 
+    //video access units and audio frames - one line per unit and a summary per stream
+    if (AccessUnits) {
+        xAccessUnitVisitor Visitor;
+        TS_StreamParser<xAccessUnitVisitor> StreamParser(Visitor);
+        StreamParser.setZeroCopy(Source->isPersistent());
+        StreamParser.setBufferLimits(BufferLimits);
+        StreamParser.Run(*Source);
+        Visitor.Finish();
+        return 0;
+    }
 
-        if (PacketHeader.hasAdaptationField()) {
-            PacketAdaptationField.Parse(packetBuffer);
-            PacketAdaptationField.Print();
-        }
-        if (PacketHeader.getPID() == 136) {
-            Result = PESAssembler136.AbsorbPacket(packetBuffer, &PacketHeader,
-                                                  &PacketAdaptationField);
-        }
-        if (PacketHeader.getPID() == 174)
-            Result = PESAssembler174.AbsorbPacket(packetBuffer, &PacketHeader,
-                                                  &PacketAdaptationField);
-        if((PacketHeader.getPID() == 136) or (PacketHeader.getPID() == 174)){
-            switch (Result) {
-                case PES_Assembler::eResult::StreamPackedLost :
-                    printf("PcktLost ");
-                    break;
-                case PES_Assembler::eResult::AssemblingStarted :
-                    printf("Started ");
-                    if (PacketHeader.getPID() == 136) PESAssembler136.PrintPESH();
-                    if (PacketHeader.getPID() == 174) PESAssembler174.PrintPESH();
-                    break;
-                case PES_Assembler::eResult::AssemblingContinue:
-                    printf("Continue ");
-                    break;
-                case PES_Assembler::eResult::AssemblingFinished:
-                    printf("Finished PES: PcktLen=%d HeadLen=%d DataLen=%d ", PESAssembler136.getBufferSize(),
-                           PESAssembler136.getHeaderLen(),
-                           PESAssembler136.getBufferSize() - PESAssembler136.getHeaderLen());
-                    break;
-                case PES_Assembler::eResult::UnexpectedPID:
-                    break;
-                default:
-                    break;
-            }
+    //remultiplexing - selected programs written as a new transport stream
+    if (RemuxFileName) {
+        TS_Remuxer Remuxer(TS_OutputSink::Create(RemuxFileName, false));
+        for (uint16_t Program : RemuxPrograms) Remuxer.SelectProgram(Program);
+        for (const pair<uint16_t, uint16_t> &Remap : RemuxRemaps)
+            if (!Remuxer.RemapPID(Remap.first, Remap.second))
+                fprintf(stderr, "PID %d cannot be remapped to %d\n", Remap.first, Remap.second);
+        Remuxer.setStripNull(RemuxStripNull);
+        Remuxer.setTargetBitrate(RemuxBitrate);
+        if (!Remuxer.Run(*Source)) {
+            cout << "Error writing the output.";
+            return 0;
         }
-        printf("\n");
+        printf("Remux: In=%" PRIu64 " Out=%" PRIu64 " Rewritten=%" PRIu64 " PSI=%" PRIu64 " Padding=%" PRIu64
+               " Overruns=%" PRIu64 " Collisions=%" PRIu64 "\n", Remuxer.getNumPacketsIn(),
+               Remuxer.getNumPacketsOut(),
+               Remuxer.getNumRewrittenPackets(), Remuxer.getNumPsiPackets(), Remuxer.getNumPaddingPackets(),
+               Remuxer.getNumBitrateOverruns(), Remuxer.getNumPidCollisions());
+        return 0;
+    }
 
+    //multi-threaded mode - no per-packet dump
+    if (NumWorkerThreads) {
+        TS_Pipeline Pipeline(NumWorkerThreads);
+        Pipeline.setBufferLimits(BufferLimits);
+        Pipeline.Run(Source.get());
+        printf("Packets=%" PRIu64 " Dropped=%" PRIu64 "\n", Pipeline.getNumPackets(), Pipeline.getNumDroppedPackets());
+        printf("Stalls: Reader=%" PRIu64 " Decoder=%" PRIu64 "\n", Pipeline.getNumReaderStalls(),
+               Pipeline.getNumDecoderStalls());
+        for (uint32_t w = 0; w < Pipeline.getNumWorkers(); w++)
+            printf("Worker%d: Packets=%" PRIu64 "\n", w, Pipeline.getNumWorkerPackets(w));
+        return 0;
+    }
 
-        PacketId++;
+
+    //per-packet dump
+    TS_OutputSink *LogSink = LogFileName ? TS_OutputSink::Create(LogFileName, false) : new TS_FileSink(stdout);
+    unique_ptr<TS_EventLog> Log(TS_EventLog::Create(LogFormat, LogSink));
+    TS_PacketRecord Record;
+    while (Source->ReadBatch(Span)) {
+        const bool Measured = TS_STATS_ENABLED();
+        for (uint32_t i = 0; i < Span.NumPackets; i++) {
+            const uint8_t *packetBuffer = Span.getPacket(i);
+            PacketHeader.Parse(packetBuffer);
+            if (PacketHeader.hasAdaptationField()) PacketAdaptationField.Parse(packetBuffer);
+            Record.Set(PacketId, PacketHeader, PacketHeader.hasAdaptationField() ? &PacketAdaptationField : nullptr);
+
+            //PES finished by this packet's PUSI - reported for every PES PID
+            TS_PacketHandler *Handler = Demuxer.getHandler(PacketHeader.getPID());
+            if (Handler != nullptr && Handler->getType() == TS_PacketHandler::eType::PES &&
+                PacketHeader.getPayloadUnitStartIndicator())
+                Record.setPreviousPES(static_cast<TS_PesHandler *>(Handler)->getAssembler());
+            Handler = Demuxer.Dispatch(packetBuffer, &PacketHeader, &PacketAdaptationField);
+            if (Measured && Handler != nullptr)
+                TS_STATS_PACKET(PacketHeader.getPID(),
+                                TS_Demuxer::getPayloadSize(&PacketHeader, &PacketAdaptationField));
+            if (Handler != nullptr && Handler->getType() == TS_PacketHandler::eType::PES) {
+                TS_PesHandler *PesHandler = static_cast<TS_PesHandler *>(Handler);
+                Record.setPES(PesHandler->getLastResult(), PesHandler->getAssembler());
+            }
+            Log->Write(Record);
+            PacketId++;
+        }
     }
-    PESAssembler136.write();
-    PESAssembler174.write();
-    fclose(PESAssembler136.file);
-    fclose(PESAssembler174.file);
-    stream.close();
+    Log->Flush();
+    //summary lines would break NDJSON / binary output
+    FILE *Summary = LogFormat == TS_EventLog::eFormat::Text ? stdout : stderr;
+    if (Source->getSkippedBytes() || Source->getNumSyncLosses())
+        fprintf(Summary, "Sync: PacketSize=%d Skipped=%" PRIu64 "B SyncLosses=%d\n", Source->getPacketSize(),
+               Source->getSkippedBytes(), Source->getNumSyncLosses());
+    if (LiveSource)
+        fprintf(Summary, "UDP: Datagrams=%" PRIu64 " SystemCalls=%" PRIu64 " RTP=%" PRIu64 " RtpLost=%" PRIu64
+               " RtpLate=%" PRIu64 "\n", LiveSource->getNumDatagrams(), LiveSource->getNumSystemCalls(),
+               LiveSource->getNumRtpDatagrams(), LiveSource->getNumRtpLost(), LiveSource->getNumRtpLate());
+    Demuxer.Flush();
+    if (MemoryBudget)
+        fprintf(Summary, "Memory: Limit=%" PRIu64 "B Peak=%" PRIu64 "B Rejected=%" PRIu64 "\n",
+                MemoryBudget->getLimit(), MemoryBudget->getPeak(), MemoryBudget->getNumRejected());
     return 0;
 }
\ No newline at end of file
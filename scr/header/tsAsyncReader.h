@@ -0,0 +1,88 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsPacketSource.h"
+#include "tsDemuxer.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/*
+Event driven front end - many independent inputs (files, pipes, sockets, UDP feeds) parsed by a few threads.
+
+Every input is a TS_PacketSource in non-blocking mode and the TS_Demuxer it feeds. Inputs are spread over the loop
+threads round robin and stay on their thread, so a demuxer is only ever used by one thread. A loop thread waits in
+epoll for those of its inputs which have a poll descriptor (sockets, pipes, UDP) and parses whatever arrived; inputs
+without one (regular files, memory - always readable) are served round robin between polls. One turn of an input
+parses at most MaxBatchesPerTurn batches, so a fast file cannot starve a live feed.
+Without epoll (non-Linux) all inputs are served round robin with non-blocking reads.
+
+When an input ends, its demuxer is flushed on its loop thread. Run() returns when all inputs ended or after Stop()
+(inputs still running are flushed as well).
+*/
+
+//=============================================================================================================================================================================
+
+class TS_AsyncReader {
+public:
+    static constexpr uint32_t MaxBatchesPerTurn = 4;
+    static constexpr uint32_t MaxEvents = 64;
+    static constexpr uint32_t StopCheck_ms = 100; //granularity of Stop() while all inputs are waiting
+
+protected:
+    struct Input {
+        std::unique_ptr<TS_PacketSource> Source;
+        TS_Demuxer *Demuxer;
+        int PollDescriptor;
+        bool Finished = false;
+        uint64_t NumTurns = 0;
+    };
+
+    enum class eTurn {
+        Parsed,
+        Pending,
+        Finished,
+    };
+
+    uint32_t m_NumThreads;
+    std::vector<std::unique_ptr<Input>> m_Inputs;
+    std::atomic<bool> m_Stop{false};
+
+public:
+    explicit TS_AsyncReader(uint32_t NumThreads);
+
+    //takes ownership of Source, Demuxer is not owned (used by one loop thread, must outlive Run), call before Run
+    //returns index of the input, NOT_VALID if the source is not good
+    int32_t AddSource(TS_PacketSource *Source, TS_Demuxer *Demuxer);
+
+    //opens FileName with TS_PacketSource::Open (files, "-", udp://)
+    int32_t AddFile(const char *FileName, TS_Demuxer *Demuxer);
+
+    //parses all inputs, returns when all of them ended or Stop() was called
+    void Run();
+
+    //can be called from any thread (and from a signal handler)
+    void Stop() { m_Stop = true; }
+
+    uint32_t getNumThreads() const { return m_NumThreads; }
+
+    uint32_t getNumInputs() const { return (uint32_t) m_Inputs.size(); }
+
+    //statistics of the input (packets, sync), valid after Run
+    const TS_PacketSource &getSource(uint32_t Idx) const { return *m_Inputs[Idx]->Source; }
+
+    //input reached its end (false if Run stopped before)
+    bool isFinished(uint32_t Idx) const { return m_Inputs[Idx]->Finished; }
+
+    //times the input was served (readiness events and round robin turns)
+    uint64_t getNumTurns(uint32_t Idx) const { return m_Inputs[Idx]->NumTurns; }
+
+protected:
+    void xLoop(uint32_t Thread);
+
+    eTurn xTurn(Input &I);
+
+    void xFinish(Input &I);
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsOutputSink.h"
+#include <vector>
+
+/*
+Audio frame splitter for MPEG audio (MPEG-1/2 Layer I/II/III, stream types 0x03/0x04) and AAC ADTS (0x0F) - optional
+stage after PES_Assembler (e.g. fed from TS_Visitor::onPesComplete).
+
+Frame headers are parsed directly in PES payload views, frames are reported as views into the same memory - no copy.
+Only the tail of a PES (frame continuing in the next PES) is copied to a carry buffer, at most one frame per PES.
+Sync is acquired when a header is followed by another valid header FrameSize bytes later, lost bytes are skipped.
+
+Timestamps: PTS of a PES belongs to the first frame starting in that PES, following frames get PTS interpolated from
+the number of samples since the last PES PTS (exact, no accumulated rounding). PES without PTS continue the
+interpolation, sample rate changes restart it.
+
+  PES n     [hdr| frame | frame | fra]      PES n+1  [hdr|me | frame | frame |...
+                 PTS     PTS+d   PTS+2d                    PTS'    PTS'+d
+*/
+
+//=============================================================================================================================================================================
+
+struct TS_AudioFrame {
+    const TS_PayloadView *Views; //frame bytes including header, valid only during xAudioFrame
+    uint32_t NumViews;
+    uint32_t Size;
+    uint64_t Number;
+    int64_t PTS;                 //90 kHz, NOT_VALID until the first PES with PTS
+    uint32_t SampleRate;
+    uint32_t NumSamples;         //per channel
+    uint8_t NumChannels;         //ADTS: channel_configuration (0 - defined in-band)
+
+    //90 kHz
+    int64_t getDuration() const { return (int64_t) NumSamples * TS::BaseClockFrequency_Hz / SampleRate; }
+};
+
+//=============================================================================================================================================================================
+
+class TS_AudioFrameSplitter {
+public:
+    enum class eCodec : int32_t {
+        MPEG, //MPEG-1/2/2.5 audio, Layer I/II/III
+        ADTS, //AAC
+    };
+
+    struct FrameHeader {
+        uint32_t FrameSize;
+        uint32_t SampleRate;
+        uint32_t NumSamples;
+        uint8_t NumChannels;
+    };
+
+    static constexpr uint32_t MaxHeaderLength = 7; //ADTS fixed + variable header, MPEG audio needs 4
+    static constexpr int64_t PTS_Period = (int64_t) 1 << 33;
+
+protected:
+    eCodec m_Codec;
+    uint32_t m_HeaderLength;
+    bool m_Locked = false;
+
+//input of the current PES - carry view + payload views
+    std::vector<TS_PayloadView> m_In;
+    std::vector<uint64_t> m_InOffsets; //start of each view in the PES input
+    uint64_t m_InSize = 0;
+    uint32_t m_Cursor = 0;
+    std::vector<uint8_t> m_Carry;
+    std::vector<uint8_t> m_NextCarry;
+    std::vector<TS_PayloadView> m_FrameViews;
+
+//timestamps
+    int64_t m_BasePTS = NOT_VALID;
+    uint64_t m_NumBaseSamples = 0;     //samples since m_BasePTS
+    uint32_t m_SampleRate = 0;
+
+//counters
+    uint64_t m_NumFrames = 0;
+    uint64_t m_NumSkippedBytes = 0;
+
+public:
+    TS_AudioFrameSplitter(eCodec Codec);
+
+    virtual ~TS_AudioFrameSplitter() {};
+
+    //payload of one complete PES packet (without PES header)
+    void AbsorbPES(const PES_PacketHeader &PESH, const TS_PayloadView *Views, uint32_t NumViews);
+
+    //drops the incomplete frame (end of stream)
+    void Finish();
+
+    eCodec getCodec() const { return m_Codec; }
+
+    uint64_t getNumFrames() const { return m_NumFrames; }
+
+    //bytes skipped while searching for sync
+    uint64_t getNumSkippedBytes() const { return m_NumSkippedBytes; }
+
+    //Header has to hold MaxHeaderLength bytes, returns false if it is not a valid frame header
+    static bool ParseFrameHeader(eCodec Codec, const uint8_t *Header, FrameHeader &Frame);
+
+protected:
+    //copies Size bytes at Offset of the PES input, returns false if they are not there
+    bool xRead(uint64_t Offset, uint32_t Size, uint8_t *Data);
+
+    //offset of the next byte 0xFF at or after Offset, m_InSize if there is none
+    uint64_t xFindSync(uint64_t Offset);
+
+    uint32_t xLocate(uint64_t Offset);
+
+    void xEmitFrame(uint64_t Offset, const FrameHeader &Header, int64_t PTS);
+
+    //called for every frame
+    virtual void xAudioFrame(const TS_AudioFrame &) {};
+};
+
+//=============================================================================================================================================================================
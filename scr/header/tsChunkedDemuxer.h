@@ -0,0 +1,66 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsPacketSource.h"
+#include "tsPSI.h"
+#include <string>
+#include <vector>
+
+/*
+Parallel demultiplexing of a whole (memory mapped) file.
+The file is split into byte ranges, one per thread. A packet belongs to the chunk its first byte lies in, so the
+packet grid seen by neighbouring chunks is the same. Every chunk demuxes its range with private PES handlers:
+ - packets of a PID preceding its first payload_unit_start_indicator in the chunk are ignored (the previous chunk owns
+   them),
+ - after its range ends, a chunk keeps following PIDs with an unfinished PES until their next payload_unit_start.
+Every chunk writes pid<PID>.<ext>.part<N>; the parts are appended to pid<PID>.<ext> in chunk order at the end.
+Streams are discovered from PAT/PMT found in the first PrescanSize bytes of the file.
+*/
+
+//=============================================================================================================================================================================
+
+class TS_ChunkedDemuxer {
+public:
+    static constexpr uint64_t DefaultPrescanSize = 32 * 1024 * 1024;
+
+    struct Stream {
+        uint16_t PID;
+        std::string FileName;
+    };
+
+protected:
+    uint32_t m_NumChunks;
+    uint64_t m_PrescanSize;
+    std::vector<Stream> m_Streams;
+    TS_BufferLimits m_BufferLimits;
+    uint64_t m_NumPackets = 0;
+
+public:
+    TS_ChunkedDemuxer(uint32_t NumChunks, uint64_t PrescanSize = DefaultPrescanSize);
+
+    //registers a stream manually (for streams without PSI), must be called before Run
+    void RegisterStream(uint16_t PID, const char *FileName);
+
+    //limits of the PES buffers of all chunks (call before Run, Limits.Budget is shared by the chunks)
+    void setBufferLimits(const TS_BufferLimits &Limits) { m_BufferLimits = Limits; }
+
+    //processes the whole file, returns false if the file cannot be mapped
+    bool Run(const char *FileName);
+
+    const std::vector<Stream> &getStreams() const { return m_Streams; }
+
+    //packets within chunk ranges (each packet counted once)
+    uint64_t getNumPackets() const { return m_NumPackets; }
+
+protected:
+    void xDiscoverStreams(const uint8_t *Data, uint64_t Size);
+
+    uint64_t xProcessChunk(const uint8_t *Data, uint64_t Size, uint64_t Begin, uint64_t End, uint32_t Chunk);
+
+    void xMerge();
+
+    static std::string xPartFileName(const Stream &S, uint32_t Chunk);
+};
+
+//=============================================================================================================================================================================
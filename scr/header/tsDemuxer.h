@@ -0,0 +1,221 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsPacketSource.h"
+#include <memory>
+#include <vector>
+#include <utility>
+
+/*
+PID demultiplexer.
+Every PID (13 bits -> 8192 entries) has a slot in a flat dispatch table holding the handler responsible for it, so
+routing a packet costs one table lookup regardless of the number of active PIDs. Packets of PIDs without a handler
+are dropped (and counted). Handlers can be registered and removed at any time, also from inside a handler.
+*/
+
+//=============================================================================================================================================================================
+
+class TS_PacketHandler {
+public:
+    enum class eType : int32_t {
+        PES,
+        Section,
+        Counter,
+        Custom,
+    };
+
+protected:
+    eType m_Type;
+
+public:
+    TS_PacketHandler(eType Type) : m_Type(Type) {};
+
+    virtual ~TS_PacketHandler() {};
+
+    //returns handler specific result code
+    virtual int32_t AbsorbPacket(const uint8_t *TransportStreamPacket, const TS_PacketHeader *PacketHeader,
+                                 const TS_AdaptationField *AdaptationField) = 0;
+
+    //called at the end of the stream
+    virtual void Flush() {};
+
+    //bounded memory (see tsMemoryBudget.h), handlers without buffers ignore it
+    virtual void setBufferLimits(const TS_BufferLimits &) {};
+
+    eType getType() const { return m_Type; }
+};
+
+//=============================================================================================================================================================================
+
+class TS_PesHandler : public TS_PacketHandler {
+protected:
+    PES_Assembler m_Assembler;
+    PES_Assembler::eResult m_LastResult = PES_Assembler::eResult::UnexpectedPID;
+    std::unique_ptr<TS_OutputSink> m_Sink;
+
+public:
+    TS_PesHandler(int32_t PID, const char *FileName) : TS_PacketHandler(eType::PES) { m_Assembler.Init(PID, FileName); };
+
+    //takes ownership of Sink, ZeroCopy requires packet memory which outlives the PES (TS_PacketSource::isPersistent)
+    TS_PesHandler(int32_t PID, TS_OutputSink *Sink, bool ZeroCopy) : TS_PacketHandler(eType::PES), m_Sink(Sink) {
+        m_Assembler.Init(PID, Sink, ZeroCopy);
+    };
+
+    int32_t AbsorbPacket(const uint8_t *TransportStreamPacket, const TS_PacketHeader *PacketHeader,
+                         const TS_AdaptationField *AdaptationField) override {
+        m_LastResult = m_Assembler.AbsorbPacket(TransportStreamPacket, PacketHeader, AdaptationField);
+        return (int32_t) m_LastResult;
+    }
+
+    void Flush() override { m_Assembler.Flush(); }
+
+    void setBufferLimits(const TS_BufferLimits &Limits) override { m_Assembler.setBufferLimits(Limits); }
+
+    PES_Assembler::eResult getLastResult() const { return m_LastResult; }
+
+    PES_Assembler &getAssembler() { return m_Assembler; }
+};
+
+//=============================================================================================================================================================================
+
+class TS_CounterHandler : public TS_PacketHandler {
+protected:
+    uint64_t m_NumPackets = 0;
+    uint64_t m_NumPayloadUnitStarts = 0;
+
+public:
+    TS_CounterHandler() : TS_PacketHandler(eType::Counter) {};
+
+    int32_t AbsorbPacket(const uint8_t *, const TS_PacketHeader *PacketHeader, const TS_AdaptationField *) override {
+        m_NumPackets++;
+        m_NumPayloadUnitStarts += PacketHeader->getPayloadUnitStartIndicator();
+        return 0;
+    }
+
+    uint64_t getNumPackets() const { return m_NumPackets; }
+
+    uint64_t getNumPayloadUnitStarts() const { return m_NumPayloadUnitStarts; }
+};
+
+//=============================================================================================================================================================================
+
+class TS_Demuxer;
+
+//creates handlers for elementary streams discovered by PSI (see PSI_PMTHandler)
+class TS_StreamFactory {
+public:
+    virtual ~TS_StreamFactory() {};
+
+    virtual TS_PacketHandler *CreateStreamHandler(TS_Demuxer *Demuxer, uint16_t PID, uint8_t StreamType) = 0;
+};
+
+//=============================================================================================================================================================================
+
+class TS_Demuxer {
+public:
+    static constexpr uint32_t NumPIDs = 8192;
+
+protected:
+    TS_PacketHandler *m_Handlers[NumPIDs] = {};
+    TS_StreamFactory *m_StreamFactory = nullptr;
+    std::vector<std::unique_ptr<TS_PacketHandler>> m_OwnedHandlers;
+    TS_BufferLimits m_BufferLimits;
+    TS_PacketHeader m_PacketHeader;
+    TS_AdaptationField m_AdaptationField;
+    uint64_t m_NumPackets = 0;
+    uint64_t m_NumDroppedPackets = 0;
+    std::vector<TS_PacketHeader> m_SpanHeaders;              //measured span passes only (TS_Stats enabled)
+    std::vector<TS_AdaptationField> m_SpanAdaptationFields;
+
+public:
+    //registers a handler owned by the caller, one handler may serve multiple PIDs
+    void RegisterHandler(uint16_t PID, TS_PacketHandler *Handler) {
+        m_Handlers[PID & (NumPIDs - 1)] = Handler;
+        if (Handler && m_BufferLimits.isLimited()) Handler->setBufferLimits(m_BufferLimits);
+    }
+
+    //applied to registered handlers and to all registered later
+    void setBufferLimits(const TS_BufferLimits &Limits) {
+        m_BufferLimits = Limits;
+        for (TS_PacketHandler *Handler : m_Handlers)
+            if (Handler) Handler->setBufferLimits(Limits);
+    }
+
+    const TS_BufferLimits &getBufferLimits() const { return m_BufferLimits; }
+
+    //creates a handler owned by the demuxer and registers it
+    template<class HandlerType, class... Args>
+    HandlerType *AddHandler(uint16_t PID, Args &&... Arguments) {
+        HandlerType *Handler = new HandlerType(std::forward<Args>(Arguments)...);
+        m_OwnedHandlers.emplace_back(Handler);
+        RegisterHandler(PID, Handler);
+        return Handler;
+    }
+
+    //registers a handler and takes its ownership
+    TS_PacketHandler *AdoptHandler(uint16_t PID, TS_PacketHandler *Handler) {
+        m_OwnedHandlers.emplace_back(Handler);
+        RegisterHandler(PID, Handler);
+        return Handler;
+    }
+
+    //factory used for discovered streams (not owned), nullptr restores default handlers
+    void setStreamFactory(TS_StreamFactory *Factory) { m_StreamFactory = Factory; }
+
+    TS_StreamFactory *getStreamFactory() const { return m_StreamFactory; }
+
+    //packets of this PID will be dropped (owned handlers are kept alive until the demuxer is destroyed)
+    void UnregisterHandler(uint16_t PID) { m_Handlers[PID & (NumPIDs - 1)] = nullptr; }
+
+    TS_PacketHandler *getHandler(uint16_t PID) const { return m_Handlers[PID & (NumPIDs - 1)]; }
+
+    //routes an already parsed packet, returns handler which received it (nullptr if dropped)
+    TS_PacketHandler *Dispatch(const uint8_t *TransportStreamPacket, const TS_PacketHeader *PacketHeader,
+                               const TS_AdaptationField *AdaptationField) {
+        m_NumPackets++;
+        TS_PacketHandler *Handler = m_Handlers[PacketHeader->getPID()];
+        if (Handler == nullptr) {
+            m_NumDroppedPackets++;
+            return nullptr;
+        }
+        Handler->AbsorbPacket(TransportStreamPacket, PacketHeader, AdaptationField);
+        return Handler;
+    }
+
+    //payload bytes of a parsed packet (AdaptationField used only when the packet has one)
+    static uint32_t getPayloadSize(const TS_PacketHeader *PacketHeader, const TS_AdaptationField *AdaptationField) {
+        if (!(PacketHeader->getAdaptationFieldControl() & 1)) return 0;
+        const uint32_t AFBytes = PacketHeader->hasAdaptationField() ? 1 + AdaptationField->getAFLength() : 0;
+        const uint32_t MaxPayload = TS::TS_PacketLength - TS::TS_HeaderLength;
+        return AFBytes < MaxPayload ? MaxPayload - AFBytes : 0;
+    }
+
+    //payload bytes of a packet which was not kept parsed (statistics of per-packet paths)
+    static uint32_t getPayloadSize(const uint8_t *TransportStreamPacket) {
+        const uint8_t AdaptationFieldControl = (TransportStreamPacket[3] >> 4) & 3;
+        if (!(AdaptationFieldControl & 1)) return 0;
+        const uint32_t AFBytes = (AdaptationFieldControl & 2) ? 1 + TransportStreamPacket[4] : 0;
+        const uint32_t MaxPayload = TS::TS_PacketLength - TS::TS_HeaderLength;
+        return AFBytes < MaxPayload ? MaxPayload - AFBytes : 0;
+    }
+
+    //parses and routes a single packet
+    TS_PacketHandler *DemuxPacket(const uint8_t *TransportStreamPacket);
+
+    //parses and routes all packets of a span (in stage passes while TS_Stats is enabled)
+    void Demux(const TS_PacketSpan &Span);
+
+    //flushes all handlers owned by the demuxer
+    void Flush();
+
+    uint64_t getNumPackets() const { return m_NumPackets; }
+
+    uint64_t getNumDroppedPackets() const { return m_NumDroppedPackets; }
+
+protected:
+    //Demux with every stage timed once per span - headers, adaptation fields, then routing
+    void xDemuxMeasured(const TS_PacketSpan &Span);
+};
+
+//=============================================================================================================================================================================
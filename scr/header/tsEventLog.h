@@ -0,0 +1,185 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsOutputSink.h"
+#include <cstring>
+
+/*
+Per-packet event log. Every parsed packet is described by one fixed-size TS_PacketRecord, writers turn records into
+bytes inside a large buffer which is handed to a TS_OutputSink only when full (no per-field calls into stdio, no
+locale). Integers are formatted by hand (digit pair table, to_chars style).
+
+TS_TextEventLog   - classic human readable dump ("0000000000 TS: SB=71 E=0 ...")
+TS_JsonEventLog   - NDJSON, one object per packet
+TS_BinaryEventLog - TS_EventLogFileHeader followed by raw TS_PacketRecord's (host byte order), can be mmapped later
+
++--------------+------------------+------------------+-----+
+| FileHeader   | TS_PacketRecord  | TS_PacketRecord  | ... |
+| 16 B         | 64 B             | 64 B             |     |
++--------------+------------------+------------------+-----+
+*/
+
+//=============================================================================================================================================================================
+
+struct TS_PacketRecord {
+    enum eFlag : uint16_t {
+        eFlag_TransportErrorIndicator = 0x0001,
+        eFlag_PayloadUnitStartIndicator = 0x0002,
+        eFlag_TransportPriority = 0x0004,
+        eFlag_AdaptationField = 0x0008, //AF fields below are valid
+        eFlag_Discontinuity = 0x0010,
+        eFlag_RandomAccess = 0x0020,
+        eFlag_StreamPriority = 0x0040,
+        eFlag_SplicingPoint = 0x0080,
+        eFlag_TransportPrivateData = 0x0100,
+        eFlag_AdaptationFieldExtension = 0x0200,
+        eFlag_PreviousPesFinished = 0x0400, //PesSize/PesHeaderLen describe PES finished by this packet's PUSI
+    };
+
+    uint64_t Index;
+    int64_t PCR;   //NOT_VALID if absent
+    int64_t OPCR;  //NOT_VALID if absent
+    int64_t PTS;   //NOT_VALID if absent, set with PesResult == AssemblingStarted
+    int64_t DTS;   //NOT_VALID if absent
+    uint32_t PesSize;
+    uint32_t PacketStartCodePrefix;
+    uint16_t PID;
+    uint16_t Flags;
+    uint16_t PesPacketLength;
+    uint16_t PesHeaderLen; //PES header with PES_header_data_length, up to 9 + 255
+    uint8_t SyncByte;
+    uint8_t ContinuityCounter;
+    uint8_t AdaptationFieldControl;
+    uint8_t TransportScramblingControl;
+    uint8_t AFLength;
+    uint8_t Stuffing;
+    uint8_t StreamId;
+    int8_t PesResult; //PES_Assembler::eResult or 0 if the packet did not go to a PES assembler
+
+    //resets PES part, fills TS header and AF (nullptr if the packet has none)
+    void Set(uint64_t PacketIndex, const TS_PacketHeader &PacketHeader, const TS_AdaptationField *AdaptationField);
+
+    //to be called before the packet is absorbed - records PES finished by PUSI
+    void setPreviousPES(const PES_Assembler &Assembler);
+
+    //to be called after the packet is absorbed
+    void setPES(PES_Assembler::eResult Result, const PES_Assembler &Assembler);
+
+    bool hasFlag(eFlag Flag) const { return (Flags & Flag) != 0; }
+};
+
+static_assert(sizeof(TS_PacketRecord) == 64, "TS_PacketRecord layout must stay fixed");
+
+struct TS_EventLogFileHeader {
+    static constexpr uint16_t CurrentVersion = 2; //2 - 16-bit PesHeaderLen, 8-bit Stuffing
+
+    char Magic[4];       //"TSEV"
+    uint16_t Version;
+    uint16_t RecordSize;
+    uint64_t Reserved;
+};
+
+static_assert(sizeof(TS_EventLogFileHeader) == 16, "TS_EventLogFileHeader layout must stay fixed");
+
+//=============================================================================================================================================================================
+
+class TS_EventLog {
+public:
+    enum class eFormat : int32_t {
+        Text,
+        NDJSON,
+        Binary,
+    };
+
+    static constexpr uint32_t DefaultBufferSize = 4 * 1024 * 1024;
+    static constexpr uint32_t MaxRecordSize = 1024; //upper bound of a single formatted record
+
+protected:
+    TS_OutputSink *m_Sink; //owned
+    char *m_Buffer;
+    uint32_t m_BufferSize;
+    uint32_t m_Pos = 0;
+    bool m_Good;
+
+public:
+    //takes ownership of the sink
+    TS_EventLog(TS_OutputSink *Sink, uint32_t BufferSize = DefaultBufferSize);
+
+    virtual ~TS_EventLog();
+
+    TS_EventLog(const TS_EventLog &) = delete;
+
+    TS_EventLog &operator=(const TS_EventLog &) = delete;
+
+    virtual void Write(const TS_PacketRecord &Record) = 0;
+
+    //hands buffered bytes to the sink and flushes it
+    bool Flush();
+
+    bool isGood() const { return m_Good; }
+
+    static TS_EventLog *Create(eFormat Format, TS_OutputSink *Sink, uint32_t BufferSize = DefaultBufferSize);
+
+protected:
+    void xFlushBuffer();
+
+    void xReserve(uint32_t Size) {
+        if (m_Pos + Size > m_BufferSize) xFlushBuffer();
+    }
+
+    void xPut(char C) { m_Buffer[m_Pos++] = C; }
+
+    void xPut(const char *Str, uint32_t Length) {
+        memcpy(m_Buffer + m_Pos, Str, Length);
+        m_Pos += Length;
+    }
+
+    template<uint32_t N>
+    void xPut(const char (&Str)[N]) { xPut(Str, N - 1); }
+
+    //decimal, left padded with zeros to MinDigits
+    void xPutUInt(uint64_t Value, uint32_t MinDigits = 1);
+
+    void xPutInt(int64_t Value) {
+        if (Value < 0) {
+            xPut('-');
+            xPutUInt(0 - (uint64_t) Value);
+        } else xPutUInt((uint64_t) Value);
+    }
+
+    //Numerator / Denominator with 6 decimal places (matches printf "%lf")
+    void xPutFixed6(uint64_t Numerator, uint32_t Denominator);
+};
+
+//=============================================================================================================================================================================
+
+class TS_TextEventLog : public TS_EventLog {
+public:
+    using TS_EventLog::TS_EventLog;
+
+    void Write(const TS_PacketRecord &Record) override;
+};
+
+//=============================================================================================================================================================================
+
+class TS_JsonEventLog : public TS_EventLog {
+public:
+    using TS_EventLog::TS_EventLog;
+
+    void Write(const TS_PacketRecord &Record) override;
+};
+
+//=============================================================================================================================================================================
+
+class TS_BinaryEventLog : public TS_EventLog {
+public:
+    TS_BinaryEventLog(TS_OutputSink *Sink, uint32_t BufferSize = DefaultBufferSize);
+
+    void Write(const TS_PacketRecord &Record) override {
+        xReserve(sizeof(Record));
+        xPut((const char *) &Record, sizeof(Record));
+    }
+};
+
+//=============================================================================================================================================================================
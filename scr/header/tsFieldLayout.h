@@ -0,0 +1,293 @@
+#pragma once
+
+#include "tsCommon.h"
+#include <cstring>
+
+/*
+Compile-time layouts of the bit fields of TS packet header, adaptation field and PES header.
+
+A field is described by its first bit (counted from the MSB of the first byte of the structure) and its width;
+offsets, shifts and masks are constants, so decoding a field is a load, a shift and an and. Loads read exactly the
+bytes holding the field (memcpy - no alignment or aliasing assumptions, nothing past the field end).
+
+Fields sharing a word are extracted from one load:
+    const uint64_t Header = TS_HeaderLayout::Word::Load(Packet);
+    const uint16_t PID = (uint16_t) TS_HeaderLayout::PID::Extract<TS_HeaderLayout::Word>(Header);
+
+TS_LitePacketHeader<Fields> decodes only the requested fields of a packet (header and PCR/flags of the adaptation
+field) - for consumers needing 2-3 fields, e.g. TS_PidCcHeader (PID + continuity counter), TS_PcrHeader (PID + PCR).
+*/
+
+//=============================================================================================================================================================================
+// fields
+//=============================================================================================================================================================================
+//big-endian value of NumBytes bytes - odd sizes are composed of 1/2/4 byte loads (a partial memcpy into a wider
+//variable goes through the stack and stalls on store forwarding)
+template<uint32_t NumBytes>
+struct xBigEndian {
+    static_assert(NumBytes >= 1 && NumBytes <= 8, "1 - 8 bytes");
+    static constexpr uint32_t Head = NumBytes >= 4 ? 4 : 2;
+
+    static uint64_t Load(const uint8_t *Data) {
+        return (xBigEndian<Head>::Load(Data) << (8 * (NumBytes - Head))) | xBigEndian<NumBytes - Head>::Load(Data + Head);
+    }
+};
+
+template<>
+struct xBigEndian<1> {
+    static uint64_t Load(const uint8_t *Data) { return Data[0]; }
+};
+
+template<>
+struct xBigEndian<2> {
+    static uint64_t Load(const uint8_t *Data) {
+        uint16_t Value;
+        memcpy(&Value, Data, sizeof(Value));
+        return xSwapBytes16(Value);
+    }
+};
+
+template<>
+struct xBigEndian<4> {
+    static uint64_t Load(const uint8_t *Data) {
+        uint32_t Value;
+        memcpy(&Value, Data, sizeof(Value));
+        return xSwapBytes32(Value);
+    }
+};
+
+template<>
+struct xBigEndian<8> {
+    static uint64_t Load(const uint8_t *Data) {
+        uint64_t Value;
+        memcpy(&Value, Data, sizeof(Value));
+        return xSwapBytes64(Value);
+    }
+};
+
+template<uint32_t NumBytes>
+static inline uint64_t xLoadBigEndian(const uint8_t *Data) { return xBigEndian<NumBytes>::Load(Data); }
+
+//Offset and NumBytes of a word decoded by a single load
+template<uint32_t Offset, uint32_t Size>
+struct TS_BitWord {
+    static constexpr uint32_t ByteOffset = Offset;
+    static constexpr uint32_t NumBytes = Size;
+    static constexpr uint32_t End = Offset + Size;
+
+    static uint64_t Load(const uint8_t *Data) { return xLoadBigEndian<Size>(Data + Offset); }
+};
+
+template<uint32_t FirstBit, uint32_t NumBits>
+struct TS_BitField {
+    static_assert(NumBits >= 1 && FirstBit % 8 + NumBits <= 64, "field has to fit a 64 bit load");
+
+    static constexpr uint32_t ByteOffset = FirstBit / 8;
+    static constexpr uint32_t NumBytes = (FirstBit % 8 + NumBits + 7) / 8;
+    static constexpr uint32_t End = ByteOffset + NumBytes; //bytes needed to decode the field
+    static constexpr uint64_t Mask = ~0ull >> (64 - NumBits);
+
+    static uint64_t Decode(const uint8_t *Data) {
+        return (xLoadBigEndian<NumBytes>(Data + ByteOffset) >> (End * 8 - FirstBit - NumBits)) & Mask;
+    }
+
+    //Size - bytes available, NOT_VALID if the field does not fit
+    static int64_t Decode(const uint8_t *Data, uint32_t Size) {
+        return Size >= End ? (int64_t) Decode(Data) : NOT_VALID;
+    }
+
+    //from the value of a word loaded by Word::Load
+    template<class Word>
+    static uint64_t Extract(uint64_t Value) {
+        static_assert(ByteOffset >= Word::ByteOffset && End <= Word::End, "field outside of the word");
+        return (Value >> (Word::End * 8 - FirstBit - NumBits)) & Mask;
+    }
+};
+
+//=============================================================================================================================================================================
+// layouts
+//=============================================================================================================================================================================
+//TS packet header - offsets from the packet start
+struct TS_HeaderLayout {
+    using Word = TS_BitWord<0, 4>;
+    using SyncByte = TS_BitField<0, 8>;
+    using TransportErrorIndicator = TS_BitField<8, 1>;
+    using PayloadUnitStartIndicator = TS_BitField<9, 1>;
+    using TransportPriority = TS_BitField<10, 1>;
+    using PID = TS_BitField<11, 13>;
+    using TransportScramblingControl = TS_BitField<24, 2>;
+    using AdaptationFieldControl = TS_BitField<26, 2>;
+    using ContinuityCounter = TS_BitField<28, 4>;
+};
+
+//adaptation field - offsets from the packet start
+struct TS_AdaptationFieldLayout {
+    using Word = TS_BitWord<4, 2>;
+    using Length = TS_BitField<32, 8>;
+    using Flags = TS_BitField<40, 8>;
+    using DiscontinuityIndicator = TS_BitField<40, 1>;
+    using RandomAccessIndicator = TS_BitField<41, 1>;
+    using ElementaryStreamPriorityIndicator = TS_BitField<42, 1>;
+    using PCR_Flag = TS_BitField<43, 1>;
+    using OPCR_Flag = TS_BitField<44, 1>;
+    using SplicingPointFlag = TS_BitField<45, 1>;
+    using TransportPrivateDataFlag = TS_BitField<46, 1>;
+    using ExtensionFlag = TS_BitField<47, 1>;
+
+    static constexpr uint32_t PCR_Offset = 6;                  //OPCR follows PCR (when present)
+    static constexpr uint32_t MinLengthWithPCR = 1 + 6;        //adaptation_field_length covering flags + PCR
+};
+
+//PCR / OPCR - offsets from the first byte of the field
+struct TS_ClockReferenceLayout {
+    using Word = TS_BitWord<0, 6>;
+    using Base = TS_BitField<0, 33>;
+    using Extension = TS_BitField<39, 9>;
+
+    static constexpr uint32_t Length = 6;
+
+    //27 MHz value
+    static uint64_t Decode(const uint8_t *Data) {
+        const uint64_t Value = Word::Load(Data);
+        return Base::Extract<Word>(Value) * 300 + Extension::Extract<Word>(Value);
+    }
+};
+
+//PES header - offsets from the PES start
+struct PES_HeaderLayout {
+    using Word = TS_BitWord<0, 6>;
+    using PacketStartCodePrefix = TS_BitField<0, 24>;
+    using StreamId = TS_BitField<24, 8>;
+    using PacketLength = TS_BitField<32, 16>;
+    using OptionalWord = TS_BitWord<6, 3>;
+    using PTS_DTS_Flags = TS_BitField<56, 2>;
+    using HeaderDataLength = TS_BitField<64, 8>;
+
+    static constexpr uint32_t PTS_Offset = 9;
+    static constexpr uint32_t DTS_Offset = 14;
+};
+
+//PTS / DTS (33 bits split by marker bits) - offsets from the first byte of the field
+struct PES_TimestampLayout {
+    using Word = TS_BitWord<0, 5>;
+    using High = TS_BitField<4, 3>;
+    using Middle = TS_BitField<8, 15>;
+    using Low = TS_BitField<24, 15>;
+
+    static constexpr uint32_t Length = 5;
+
+    //90 kHz value
+    static uint64_t Decode(const uint8_t *Data) {
+        const uint64_t Value = Word::Load(Data);
+        return (High::Extract<Word>(Value) << 30) | (Middle::Extract<Word>(Value) << 15) | Low::Extract<Word>(Value);
+    }
+};
+
+//=============================================================================================================================================================================
+// lite parser
+//=============================================================================================================================================================================
+enum eLiteField : uint32_t {
+    eLiteField_PID = 0x01,
+    eLiteField_ContinuityCounter = 0x02,
+    eLiteField_PayloadUnitStart = 0x04,
+    eLiteField_AdaptationFieldControl = 0x08,
+    eLiteField_TransportError = 0x10,
+    eLiteField_Discontinuity = 0x20,
+    eLiteField_RandomAccess = 0x40,
+    eLiteField_PCR = 0x80,
+};
+
+//decodes only Fields (eLiteField mask) of a 188 byte packet, getters of other fields do not compile
+template<uint32_t Fields>
+class TS_LitePacketHeader {
+protected:
+    static constexpr uint32_t AdaptationFieldFields = eLiteField_Discontinuity | eLiteField_RandomAccess |
+                                                      eLiteField_PCR;
+
+    uint16_t m_PID = 0;
+    uint8_t m_ContinuityCounter = 0;
+    uint8_t m_AdaptationFieldControl = 0;
+    bool m_PayloadUnitStart = false;
+    bool m_TransportError = false;
+    bool m_Discontinuity = false;
+    bool m_RandomAccess = false;
+    int64_t m_PCR = NOT_VALID;
+
+public:
+    void Parse(const uint8_t *Packet) {
+        using H = TS_HeaderLayout;
+        using AF = TS_AdaptationFieldLayout;
+        const uint64_t Header = H::Word::Load(Packet);
+        if (Fields & eLiteField_PID) m_PID = (uint16_t) H::PID::Extract<H::Word>(Header);
+        if (Fields & eLiteField_ContinuityCounter)
+            m_ContinuityCounter = (uint8_t) H::ContinuityCounter::Extract<H::Word>(Header);
+        if (Fields & eLiteField_PayloadUnitStart)
+            m_PayloadUnitStart = H::PayloadUnitStartIndicator::Extract<H::Word>(Header) != 0;
+        if (Fields & eLiteField_AdaptationFieldControl)
+            m_AdaptationFieldControl = (uint8_t) H::AdaptationFieldControl::Extract<H::Word>(Header);
+        if (Fields & eLiteField_TransportError)
+            m_TransportError = H::TransportErrorIndicator::Extract<H::Word>(Header) != 0;
+        if (!(Fields & AdaptationFieldFields)) return;
+
+        //adaptation field bytes are read even when there is none (payload, still inside the packet) - flags select
+        //the result instead of branching
+        const uint64_t Word = AF::Word::Load(Packet);
+        const uint32_t Length = (uint32_t) AF::Length::Extract<AF::Word>(Word);
+        const bool HasFlags = (H::AdaptationFieldControl::Extract<H::Word>(Header) & 2) && Length != 0;
+        if (Fields & eLiteField_Discontinuity)
+            m_Discontinuity = HasFlags && AF::DiscontinuityIndicator::Extract<AF::Word>(Word);
+        if (Fields & eLiteField_RandomAccess)
+            m_RandomAccess = HasFlags && AF::RandomAccessIndicator::Extract<AF::Word>(Word);
+        if (Fields & eLiteField_PCR) {
+            const bool HasPCR = HasFlags && Length >= AF::MinLengthWithPCR && AF::PCR_Flag::Extract<AF::Word>(Word);
+            const int64_t PCR = (int64_t) TS_ClockReferenceLayout::Decode(Packet + AF::PCR_Offset);
+            m_PCR = HasPCR ? PCR : NOT_VALID;
+        }
+    }
+
+    uint16_t getPID() const {
+        static_assert(Fields & eLiteField_PID, "PID not decoded");
+        return m_PID;
+    }
+
+    uint8_t getContinuityCounter() const {
+        static_assert(Fields & eLiteField_ContinuityCounter, "continuity_counter not decoded");
+        return m_ContinuityCounter;
+    }
+
+    bool getPayloadUnitStartIndicator() const {
+        static_assert(Fields & eLiteField_PayloadUnitStart, "payload_unit_start_indicator not decoded");
+        return m_PayloadUnitStart;
+    }
+
+    uint8_t getAdaptationFieldControl() const {
+        static_assert(Fields & eLiteField_AdaptationFieldControl, "adaptation_field_control not decoded");
+        return m_AdaptationFieldControl;
+    }
+
+    bool getTransportErrorIndicator() const {
+        static_assert(Fields & eLiteField_TransportError, "transport_error_indicator not decoded");
+        return m_TransportError;
+    }
+
+    bool getDiscontinuityIndicator() const {
+        static_assert(Fields & eLiteField_Discontinuity, "discontinuity_indicator not decoded");
+        return m_Discontinuity;
+    }
+
+    bool getRandomAccessIndicator() const {
+        static_assert(Fields & eLiteField_RandomAccess, "random_access_indicator not decoded");
+        return m_RandomAccess;
+    }
+
+    //27 MHz, NOT_VALID if the packet carries no PCR
+    int64_t getPCR() const {
+        static_assert(Fields & eLiteField_PCR, "PCR not decoded");
+        return m_PCR;
+    }
+};
+
+using TS_PidCcHeader = TS_LitePacketHeader<eLiteField_PID | eLiteField_ContinuityCounter>;
+using TS_PcrHeader = TS_LitePacketHeader<eLiteField_PID | eLiteField_PCR>;
+
+//=============================================================================================================================================================================
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsPacketSource.h"
+#include "tsStreamParser.h"
+#include <memory>
+#include <vector>
+
+/*
+Sidecar index of a TS file: per PID byte offsets of PES starts (with PTS, DTS and random access flag) and of PCRs.
+TS_IndexBuilder collects entries in one pass and writes the file, TS_Index maps it and answers queries.
+
+Entries are grouped in blocks of BlockSize. Every block has a fixed-size anchor holding its first entry in full,
+remaining entries are delta encoded (LEB128 varints, signed deltas zigzag encoded). A query is a binary search over
+anchors followed by decoding at most one block - O(log n). Timestamps are unwrapped (33 bit PTS/DTS, PCR) so they
+grow monotonically over the whole file; queries use the same unwrapped time base.
+
++------------+-----------------------------+---------------------------------------------------------------------+
+| FileHeader | StreamHeader x NumStreams   | per stream: PesAnchors | PesDeltas | PcrAnchors | PcrDeltas (8 B aligned) |
++------------+-----------------------------+---------------------------------------------------------------------+
+*/
+
+//=============================================================================================================================================================================
+
+struct TS_IndexFileHeader {
+    static constexpr uint16_t CurrentVersion = 1;
+
+    char Magic[4];        //"TSIX"
+    uint16_t Version;
+    uint16_t BlockSize;
+    uint32_t NumStreams;
+    uint32_t PacketSize;
+    uint64_t SourceSize;
+    uint64_t Reserved;
+};
+
+struct TS_IndexStreamHeader {
+    uint16_t PID;
+    uint16_t Reserved0;
+    uint32_t Reserved1;
+    uint64_t NumPes;
+    uint64_t NumPcr;
+    uint64_t PesAnchorsPos; //file offsets
+    uint64_t PesDeltasPos;
+    uint64_t PcrAnchorsPos;
+    uint64_t PcrDeltasPos;
+    uint64_t Reserved2;
+};
+
+struct TS_IndexPesAnchor {
+    uint64_t Offset;
+    int64_t PTS;              //NOT_VALID if absent
+    int64_t DTS;              //NOT_VALID if absent
+    int64_t Time;             //search key - DTS, PTS or time of previous entry
+    int64_t LastRandomAccess; //number of the last random access PES before this block or NOT_VALID
+    uint32_t DeltasPos;       //relative to PesDeltasPos
+    uint32_t Flags;
+};
+
+struct TS_IndexPcrAnchor {
+    uint64_t Offset;
+    int64_t PCR;
+    uint32_t DeltasPos;       //relative to PcrDeltasPos
+    uint32_t Reserved;
+};
+
+static_assert(sizeof(TS_IndexFileHeader) == 32, "TS_IndexFileHeader layout must stay fixed");
+static_assert(sizeof(TS_IndexStreamHeader) == 64, "TS_IndexStreamHeader layout must stay fixed");
+static_assert(sizeof(TS_IndexPesAnchor) == 48, "TS_IndexPesAnchor layout must stay fixed");
+static_assert(sizeof(TS_IndexPcrAnchor) == 24, "TS_IndexPcrAnchor layout must stay fixed");
+
+//=============================================================================================================================================================================
+
+struct TS_IndexPesEntry {
+    enum eFlag : uint32_t {
+        eFlag_RandomAccess = 0x01,
+        eFlag_PTS = 0x02,
+        eFlag_DTS = 0x04,
+    };
+
+    uint64_t Number;
+    uint64_t Offset; //byte offset of the packet starting the PES
+    int64_t PTS;     //unwrapped, NOT_VALID if absent
+    int64_t DTS;     //unwrapped, NOT_VALID if absent
+    int64_t Time;    //DTS if present, then PTS, then Time of the previous PES
+    uint32_t Flags;
+
+    bool isRandomAccess() const { return (Flags & eFlag_RandomAccess) != 0; }
+};
+
+struct TS_IndexPcrEntry {
+    uint64_t Number;
+    uint64_t Offset;
+    int64_t PCR;     //unwrapped, 27 MHz
+};
+
+//=============================================================================================================================================================================
+
+class TS_IndexBuilder : public TS_Visitor {
+public:
+    static constexpr uint16_t DefaultBlockSize = 64;
+
+protected:
+    struct xTimestampUnwrapper {
+        int64_t Last = NOT_VALID;
+        int64_t Base = 0;
+
+        int64_t Unwrap(int64_t Value, int64_t Period);
+    };
+
+    struct xStream {
+        uint16_t PID;
+        std::vector<TS_IndexPesEntry> Pes;
+        std::vector<TS_IndexPcrEntry> Pcr;
+        xTimestampUnwrapper PTS;
+        xTimestampUnwrapper DTS;
+        xTimestampUnwrapper PCR;
+        int64_t LastTime = NOT_VALID;
+    };
+
+    std::unique_ptr<xStream> m_Streams[TS_Demuxer::NumPIDs];
+    uint16_t m_BlockSize;
+    uint32_t m_PacketSize = TS::TS_PacketLength;
+    uint64_t m_SourceSize = 0;
+
+//position of the current packet
+    const uint8_t *m_SpanData = nullptr;
+    uint64_t m_SpanOffset = 0;
+    uint64_t m_PacketOffset = 0;
+    bool m_RandomAccess = false;
+
+public:
+    TS_IndexBuilder(uint16_t BlockSize = DefaultBlockSize) : m_BlockSize(BlockSize ? BlockSize : 1) {};
+
+    //indexes the whole source (offsets are exact for memory mapped sources)
+    void Build(TS_PacketSource &Source);
+
+    bool Write(const char *FileName) const;
+
+//TS_Visitor
+    void onPacket(const TS_PacketHeader &PacketHeader, const uint8_t *Packet);
+
+    void onAdaptationField(const TS_PacketHeader &PacketHeader, const TS_AdaptationField &AdaptationField);
+
+    void onPcr(uint16_t PID, uint64_t PCR);
+
+    void onPesStart(uint16_t PID, const PES_PacketHeader &PESH);
+
+protected:
+    xStream &xGetStream(uint16_t PID);
+
+    void xWriteStream(const xStream &Stream, std::vector<uint8_t> &File, TS_IndexStreamHeader &Header) const;
+};
+
+//=============================================================================================================================================================================
+
+class TS_Index {
+protected:
+    TS_MappedFile m_File;
+    const uint8_t *m_Data = nullptr;
+    uint64_t m_Size = 0;
+    const TS_IndexFileHeader *m_Header = nullptr;
+    const TS_IndexStreamHeader *m_Streams = nullptr;
+
+public:
+    bool Open(const char *FileName);
+
+    bool isGood() const { return m_Header != nullptr; }
+
+    uint32_t getNumStreams() const { return m_Header ? m_Header->NumStreams : 0; }
+
+    const TS_IndexStreamHeader &getStream(uint32_t Idx) const { return m_Streams[Idx]; }
+
+    uint64_t getSourceSize() const { return m_Header ? m_Header->SourceSize : 0; }
+
+    uint64_t getNumPes(uint16_t PID) const;
+
+    uint64_t getNumPcr(uint16_t PID) const;
+
+    bool getPes(uint16_t PID, uint64_t Number, TS_IndexPesEntry &Entry) const;
+
+    bool getPcr(uint16_t PID, uint64_t Number, TS_IndexPcrEntry &Entry) const;
+
+    //last PES with Time <= Time (90 kHz, unwrapped)
+    bool FindPes(uint16_t PID, int64_t Time, TS_IndexPesEntry &Entry) const;
+
+    //last random access PES at or before FindPes(Time) - where decoding has to start
+    bool FindRandomAccess(uint16_t PID, int64_t Time, TS_IndexPesEntry &Entry) const;
+
+    //last PCR <= PCR (27 MHz, unwrapped)
+    bool FindPcr(uint16_t PID, int64_t PCR, TS_IndexPcrEntry &Entry) const;
+
+protected:
+    const TS_IndexStreamHeader *xFindStream(uint16_t PID) const;
+
+    //decodes entries of Block up to number Last (at most to the end of the block), stops when Visit(Entry) returns false
+    template<class Func>
+    bool xDecodePesBlock(const TS_IndexStreamHeader &Stream, uint64_t Block, uint64_t Last, Func Visit) const;
+
+    template<class Func>
+    bool xDecodePcrBlock(const TS_IndexStreamHeader &Stream, uint64_t Block, uint64_t Last, Func Visit) const;
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "tsCommon.h"
+#include <atomic>
+
+/*
+Bounded-memory operation - limits of the memory used for PES assembly.
+
+TS_MemoryBudget is a byte budget shared by any number of PES assemblers (also across threads): buffer growth has to
+acquire its size first, a buffer returns it when freed. TS_BufferLimits combines it with a per-PID cap of the PES
+buffer. When either limit is hit the PES is cut (PES_Assembler::eResult::BufferOverflow): the partial PES is written
+out (or reported as truncated to a TS_Visitor) and the rest of it is dropped until the next payload_unit_start.
+
+Input memory does not grow with the stream - TS_Pipeline moves packets in a fixed pool of batches, a slow output
+stalls the reader on the pool (backpressure) instead of queuing more data.
+*/
+
+//=============================================================================================================================================================================
+
+class TS_MemoryBudget {
+protected:
+    std::atomic<uint64_t> m_Used{0};
+    std::atomic<uint64_t> m_Peak{0};
+    std::atomic<uint64_t> m_NumRejected{0};
+    uint64_t m_Limit;
+
+public:
+    explicit TS_MemoryBudget(uint64_t Limit) : m_Limit(Limit) {};
+
+    TS_MemoryBudget(const TS_MemoryBudget &) = delete;
+
+    TS_MemoryBudget &operator=(const TS_MemoryBudget &) = delete;
+
+    //false (nothing acquired) if Size does not fit the budget
+    bool Acquire(uint64_t Size) {
+        uint64_t Used = m_Used.load(std::memory_order_relaxed);
+        do {
+            if (Used + Size > m_Limit) {
+                m_NumRejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!m_Used.compare_exchange_weak(Used, Used + Size, std::memory_order_relaxed));
+        uint64_t Peak = m_Peak.load(std::memory_order_relaxed);
+        while (Used + Size > Peak && !m_Peak.compare_exchange_weak(Peak, Used + Size, std::memory_order_relaxed));
+        return true;
+    }
+
+    void Release(uint64_t Size) { m_Used.fetch_sub(Size, std::memory_order_relaxed); }
+
+    uint64_t getLimit() const { return m_Limit; }
+
+    uint64_t getUsed() const { return m_Used.load(std::memory_order_relaxed); }
+
+    uint64_t getPeak() const { return m_Peak.load(std::memory_order_relaxed); }
+
+    //failed Acquire calls
+    uint64_t getNumRejected() const { return m_NumRejected.load(std::memory_order_relaxed); }
+};
+
+//=============================================================================================================================================================================
+
+struct TS_BufferLimits {
+    uint32_t MaxPesBufferSize = 0;     //bytes per PID (PES header included), 0 - unlimited
+    TS_MemoryBudget *Budget = nullptr; //shared by all PIDs, not owned - has to outlive the assemblers
+
+    bool isLimited() const { return MaxPesBufferSize != 0 || Budget != nullptr; }
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsPacketSource.h"
+#include "tsDemuxer.h"
+#include "tsPSI.h"
+#include <vector>
+
+/*
+ETSI TR 101 290 priority 1 / priority 2 monitor.
+
+  1.1 TS_sync_loss           - sync losses reported by the packet source (CheckSource)
+  1.2 Sync_byte_error        - packet not starting with 0x47
+  1.3 PAT_error              - PAT missing for more than 0.5 s or scrambled
+  1.4 Continuity_count_error - CC jump without discontinuity_indicator, more than one duplicate packet
+  1.5 PMT_error              - PMT of a program missing for more than 0.5 s or scrambled
+  1.6 PID_error              - elementary stream referenced by a PMT missing for more than PidTimeout
+  2.1 Transport_error        - transport_error_indicator set
+  2.2 CRC_error              - PAT/PMT section with wrong CRC
+  2.5 PTS_error              - PTS of an elementary stream not repeated within 0.7 s
+(PCR checks 2.3/2.4 are done by TS_TimingEngine.)
+
+Time base is the arrival time of packets when available (live input), otherwise it is recovered from PCRs of the
+first PCR PID (interpolated by packet count). Checks needing time are inactive until the clock is known.
+State is a fixed array indexed by PID, PAT/PMT are parsed by a private demuxer; the hot path does no lookups.
+Every error is reported through xReportEvent, counts per window through xWindowCompleted.
+*/
+
+//=============================================================================================================================================================================
+
+class TS_Monitor : protected TS_StreamFactory {
+public:
+    enum class eEvent : int32_t {
+        SyncLoss = 0,
+        SyncByteError,
+        PatError,
+        ContinuityCountError,
+        PmtError,
+        PidError,
+        TransportError,
+        CrcError,
+        PtsError,
+    };
+
+    static constexpr uint32_t NumEvents = (uint32_t) eEvent::PtsError + 1;
+    static constexpr int64_t MaxPsiInterval = 500 * (int64_t) TS::ExtendedClockFrequency_kHz;        //0.5 s
+    static constexpr int64_t MaxPtsInterval = 700 * (int64_t) TS::ExtendedClockFrequency_kHz;        //0.7 s
+    static constexpr int64_t DefaultPidTimeout = 5000 * (int64_t) TS::ExtendedClockFrequency_kHz;    //5 s
+    static constexpr int64_t DefaultWindowLength = TS::ExtendedClockFrequency_Hz;                     //1 s
+    static constexpr int64_t CheckInterval = 100 * (int64_t) TS::ExtendedClockFrequency_kHz;         //timeouts
+
+    struct Event {
+        eEvent Type;
+        uint16_t PID;
+        uint64_t PacketIndex;
+        int64_t Time;  //27 MHz monitor time, NOT_VALID if the clock is not known yet
+        int64_t Value; //CC: expected counter, intervals: 27 MHz interval, others 0
+        //PID is 0x1FFF for events not bound to a PID (sync loss, CRC)
+    };
+
+    struct Window {
+        int64_t StartTime; //27 MHz
+        int64_t Duration;
+        uint64_t FirstPacket;
+        uint64_t NumPackets;
+        uint32_t Counts[NumEvents];
+    };
+
+    static const char *getEventName(eEvent Type);
+
+    //1 or 2
+    static int32_t getPriority(eEvent Type) { return Type <= eEvent::PidError ? 1 : 2; }
+
+protected:
+    enum ePidType : uint8_t {
+        ePidType_None = 0,
+        ePidType_PAT,
+        ePidType_PMT,
+        ePidType_Stream, //elementary stream referenced by a PMT
+    };
+
+    static constexpr uint8_t UnknownCC = 0xFF;
+
+    struct xPidState {
+        int64_t LastSeen = NOT_VALID;    //monitor time
+        int64_t LastPts = NOT_VALID;     //monitor time of the last PTS
+        uint32_t NumCCErrors = 0;
+        uint8_t LastCC = UnknownCC;
+        uint8_t Type = ePidType_None;
+        uint8_t NumDuplicates = 0;
+        bool TimeoutReported = false;
+    };
+
+    xPidState m_PIDs[TS_Demuxer::NumPIDs];
+    std::vector<uint16_t> m_Watched; //PAT, PMT and stream PIDs - checked for timeouts
+    TS_Demuxer m_PSIDemuxer;
+    std::vector<const PSI_SectionAssembler *> m_Sections; //PAT and PMT handlers - CRC error counters
+    int64_t m_PidTimeout;
+    int64_t m_WindowLength;
+
+//clock
+    int64_t m_Time = NOT_VALID;
+    int32_t m_ClockPID = NOT_VALID;
+    int64_t m_ClockPCR = NOT_VALID;
+    uint64_t m_ClockPacket = 0;
+    int64_t m_ClockTime = 0;
+    double m_TicksPerPacket = 0;
+    int64_t m_NextCheck = NOT_VALID;
+
+//counters
+    uint64_t m_NumPackets = 0;
+    uint64_t m_Counters[NumEvents] = {};
+    uint32_t m_LastSyncLosses = 0;
+    uint64_t m_LastCRCErrors = 0;
+    Window m_Window;
+
+public:
+    TS_Monitor(int64_t PidTimeout = DefaultPidTimeout, int64_t WindowLength = DefaultWindowLength);
+
+    virtual ~TS_Monitor() {};
+
+    //every packet of the multiplex, AdaptationField - nullptr if the packet has none
+    void AbsorbPacket(const uint8_t *Packet, const TS_PacketHeader &PacketHeader,
+                      const TS_AdaptationField *AdaptationField, int64_t ArrivalTime_ns = NOT_VALID);
+
+    //picks up sync losses, to be called after every batch
+    void CheckSource(const TS_PacketSource &Source);
+
+    //closes the current window
+    void Finish();
+
+    uint64_t getCounter(eEvent Type) const { return m_Counters[(uint32_t) Type]; }
+
+    uint32_t getNumCCErrors(uint16_t PID) const { return m_PIDs[PID & (TS_Demuxer::NumPIDs - 1)].NumCCErrors; }
+
+    uint64_t getNumPackets() const { return m_NumPackets; }
+
+    bool isClockValid() const { return m_Time != NOT_VALID; }
+
+protected:
+    void xUpdateClock(const TS_PacketHeader &PacketHeader, const TS_AdaptationField *AdaptationField,
+                      int64_t ArrivalTime_ns);
+
+    void xCheckContinuity(const TS_PacketHeader &PacketHeader, const TS_AdaptationField *AdaptationField,
+                          xPidState &State);
+
+    void xCheckPts(const uint8_t *Packet, const TS_PacketHeader &PacketHeader,
+                   const TS_AdaptationField *AdaptationField, xPidState &State);
+
+    void xCheckTimeouts();
+
+    void xCheckCRC();
+
+    void xWatch(uint16_t PID, ePidType Type);
+
+    void xEvent(eEvent Type, uint16_t PID, int64_t Value = 0);
+
+    void xStartWindow();
+
+    //called for every detected error
+    virtual void xReportEvent(const Event &) {};
+
+    virtual void xWindowCompleted(const Window &) {};
+
+    TS_PacketHandler *CreateStreamHandler(TS_Demuxer *Demuxer, uint16_t PID, uint8_t StreamType) override;
+
+    friend class xMonitorPATHandler;
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "tsCommon.h"
+#include <cstdio>
+#include <vector>
+
+/*
+Output sinks receive payload as lists of views (scatter-gather), so assembled PES does not have to be contiguous.
+Views passed with Persistent == true stay valid until Flush() (e.g. they point into a memory mapped input file) and
+may be queued to batch system calls; other views must be consumed before Write() returns.
+
+TS_FileSink    - stdio, portable
+TS_WritevSink  - writev() with up to MaxBatchViews views per call (POSIX)
+TS_IoUringSink - batched IORING_OP_WRITEV submissions (Linux, TS_ENABLE_IO_URING builds), falls back to writev()
+*/
+
+//=============================================================================================================================================================================
+
+struct TS_PayloadView {
+    const uint8_t *Data;
+    uint32_t Size;
+};
+
+//=============================================================================================================================================================================
+
+class TS_OutputSink {
+public:
+    virtual ~TS_OutputSink() {};
+
+    virtual bool Write(const TS_PayloadView *Views, uint32_t NumViews, bool Persistent) = 0;
+
+    //writes everything queued, afterwards no view passed to Write is referenced anymore
+    virtual bool Flush() { return true; };
+
+    virtual bool isGood() const = 0;
+
+    //opens the best sink available for a file (io_uring if enabled, then writev, then stdio)
+    static TS_OutputSink *Create(const char *FileName, bool Append = true);
+};
+
+//=============================================================================================================================================================================
+
+class TS_FileSink : public TS_OutputSink {
+protected:
+    FILE *m_File = nullptr;
+    bool m_OwnsFile = true;
+
+public:
+    TS_FileSink(const char *FileName, bool Append = true) { m_File = fopen(FileName, Append ? "ab" : "wb"); };
+
+    //does not take ownership of the stream (e.g. stdout)
+    TS_FileSink(FILE *File) : m_File(File), m_OwnsFile(false) {};
+
+    ~TS_FileSink() override {
+        if (m_File && m_OwnsFile) fclose(m_File);
+    };
+
+    bool Write(const TS_PayloadView *Views, uint32_t NumViews, bool) override {
+        for (uint32_t i = 0; i < NumViews; i++)
+            if (fwrite(Views[i].Data, 1, Views[i].Size, m_File) != Views[i].Size) return false;
+        return true;
+    };
+
+    bool Flush() override { return fflush(m_File) == 0; };
+
+    bool isGood() const override { return m_File != nullptr; };
+};
+
+//=============================================================================================================================================================================
+
+class TS_WritevSink : public TS_OutputSink {
+public:
+    static constexpr uint32_t MaxBatchViews = 1024; //IOV_MAX on Linux
+
+protected:
+    int m_FileDescriptor = NOT_VALID;
+    std::vector<TS_PayloadView> m_Pending;
+    uint64_t m_NumSystemCalls = 0;
+
+public:
+    TS_WritevSink(const char *FileName, bool Append = true);
+
+    ~TS_WritevSink() override;
+
+    bool Write(const TS_PayloadView *Views, uint32_t NumViews, bool Persistent) override;
+
+    bool Flush() override;
+
+    bool isGood() const override { return m_FileDescriptor >= 0; };
+
+    uint64_t getNumSystemCalls() const { return m_NumSystemCalls; }
+
+protected:
+    //writes views completely (handles partial writes)
+    bool xWritev(const TS_PayloadView *Views, uint32_t NumViews);
+};
+
+//=============================================================================================================================================================================
+
+class TS_IoUringSink : public TS_WritevSink {
+public:
+    static constexpr uint32_t QueueDepth = 64;
+
+protected:
+    struct Ring;
+    Ring *m_Ring = nullptr;
+    uint64_t m_FileOffset = 0;
+
+public:
+    TS_IoUringSink(const char *FileName, bool Append = true);
+
+    ~TS_IoUringSink() override;
+
+    bool Write(const TS_PayloadView *Views, uint32_t NumViews, bool Persistent) override;
+
+    bool Flush() override;
+
+    //false if io_uring is not compiled in or not permitted - the sink then behaves like TS_WritevSink
+    bool isRingActive() const { return m_Ring != nullptr; }
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsDemuxer.h"
+#include <vector>
+
+/*
+PSI section:
+`        3                   2                   1                   0  `
+`      1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0  `
+`     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ `
+`   0 |    table_id   |S|0| R |    section_length     |  table_id_ext | `
+`     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ `
+`   4 | table_id_ext  | R | version |C| section_number|  last_section | `
+`     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ `
+`   8 |                 table data ... CRC_32 (32 bits)               | `
+`     +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+ `
+
+Section syntax indicator     (S  ) :  1 bit
+Current next indicator       (C  ) :  1 bit
+section_length counts bytes following the section_length field (including CRC_32).
+The first payload byte of a packet with payload_unit_start_indicator set is the pointer_field - the number of bytes
+finishing the previous section before the next section starts.
+*/
+
+//=============================================================================================================================================================================
+
+class PSI {
+public:
+    static constexpr uint32_t SectionHeaderLength = 3;
+    static constexpr uint32_t LongSectionHeaderLength = 8;
+    static constexpr uint32_t CRC32Length = 4;
+    static constexpr uint32_t MaxSectionLength = 4096;
+    static constexpr uint8_t StuffingByte = 0xFF;
+
+    enum eTableId : uint8_t {
+        eTableId_PAT = 0x00,
+        eTableId_CAT = 0x01,
+        eTableId_PMT = 0x02,
+    };
+
+    enum eStreamType : uint8_t {
+        eStreamType_MPEG1_Audio = 0x03,
+        eStreamType_MPEG2_Audio = 0x04,
+        eStreamType_MPEG2_Video = 0x02,
+        eStreamType_AAC_ADTS = 0x0F,
+        eStreamType_H264 = 0x1B,
+        eStreamType_HEVC = 0x24,
+    };
+
+    //MPEG-2 CRC32 (polynomial 0x04C11DB7, no reflection, initial value 0xFFFFFFFF), slice-by-8
+    static uint32_t CRC32(const uint8_t *Data, uint32_t Size, uint32_t CRC = 0xFFFFFFFF);
+
+    //file extension used for elementary streams of given type
+    static const char *getStreamTypeExtension(uint8_t StreamType);
+};
+
+//=============================================================================================================================================================================
+
+class PSI_SectionAssembler : public TS_PacketHandler {
+protected:
+    struct SectionVersion {
+        uint8_t TableId;
+        uint16_t TableIdExtension;
+        uint8_t SectionNumber;
+        uint8_t VersionNumber;
+    };
+
+    uint8_t m_Section[PSI::MaxSectionLength];
+    uint32_t m_DataInSection = 0;
+    uint32_t m_SectionLength = 0; //total length including 3-byte header, 0 until known
+    bool m_InSection = false;
+    bool m_SkipSection = false;   //section with already known version - bytes are discarded
+    int8_t m_LastContinuityCounter = NOT_VALID;
+    std::vector<SectionVersion> m_Versions;
+
+//statistics
+    uint64_t m_NumSections = 0;
+    uint64_t m_NumSkippedSections = 0;
+    uint64_t m_NumCRCErrors = 0;
+    uint64_t m_NumBrokenSections = 0;
+
+public:
+    PSI_SectionAssembler() : TS_PacketHandler(eType::Section) {};
+
+    //returns number of sections delivered to xProcessSection
+    int32_t AbsorbPacket(const uint8_t *TransportStreamPacket, const TS_PacketHeader *PacketHeader,
+                         const TS_AdaptationField *AdaptationField) override;
+
+    uint64_t getNumSections() const { return m_NumSections; }
+
+    uint64_t getNumSkippedSections() const { return m_NumSkippedSections; }
+
+    uint64_t getNumCRCErrors() const { return m_NumCRCErrors; }
+
+    uint64_t getNumBrokenSections() const { return m_NumBrokenSections; }
+
+protected:
+    //called for every new (or changed) section with valid CRC
+    virtual void xProcessSection(const uint8_t *Section, uint32_t Length) = 0;
+
+    //appends section bytes, returns number of completed sections
+    int32_t xAppend(const uint8_t *Data, uint32_t Size, bool AllowNewSection);
+
+    int32_t xCompleteSection();
+
+    bool xIsKnownVersion() const;
+
+    void xStoreVersion();
+};
+
+//=============================================================================================================================================================================
+
+struct PSI_Program {
+    uint16_t ProgramNumber;
+    uint16_t PID; //PMT PID (network PID for program 0)
+};
+
+struct PSI_ElementaryStream {
+    uint8_t StreamType;
+    uint16_t PID;
+};
+
+//=============================================================================================================================================================================
+
+//parses PAT and registers PMT handlers for every announced program
+class PSI_PATHandler : public PSI_SectionAssembler {
+protected:
+    TS_Demuxer *m_Demuxer;
+    uint16_t m_TransportStreamId = 0;
+    std::vector<PSI_Program> m_Programs;
+
+public:
+    PSI_PATHandler(TS_Demuxer *Demuxer) : m_Demuxer(Demuxer) {};
+
+    uint16_t getTransportStreamId() const { return m_TransportStreamId; }
+
+    const std::vector<PSI_Program> &getPrograms() const { return m_Programs; }
+
+protected:
+    void xProcessSection(const uint8_t *Section, uint32_t Length) override;
+
+    //called for programs whose PMT PID has no handler yet, registers a PSI_PMTHandler by default
+    virtual void xRegisterProgram(const PSI_Program &Program);
+};
+
+//=============================================================================================================================================================================
+
+//parses PMT and registers PES handlers for every elementary stream not handled yet
+class PSI_PMTHandler : public PSI_SectionAssembler {
+protected:
+    TS_Demuxer *m_Demuxer;
+    uint16_t m_ProgramNumber = 0;
+    uint16_t m_PCR_PID = (uint16_t) TS_PacketHeader::ePID::NuLL;
+    std::vector<PSI_ElementaryStream> m_Streams;
+
+public:
+    PSI_PMTHandler(TS_Demuxer *Demuxer) : m_Demuxer(Demuxer) {};
+
+    uint16_t getProgramNumber() const { return m_ProgramNumber; }
+
+    uint16_t getPCR_PID() const { return m_PCR_PID; }
+
+    const std::vector<PSI_ElementaryStream> &getStreams() const { return m_Streams; }
+
+protected:
+    void xProcessSection(const uint8_t *Section, uint32_t Length) override;
+
+    //called for streams whose PID has no handler yet, uses the demuxer's stream factory if set, otherwise registers
+    //a TS_PesHandler writing pid<PID>.<ext>
+    virtual void xRegisterStream(const PSI_ElementaryStream &Stream);
+};
+
+//=============================================================================================================================================================================
+
+//creates PES handlers writing pid<PID>.<ext> through TS_OutputSink (writev/io_uring), optionally zero-copy
+class PSI_SinkStreamFactory : public TS_StreamFactory {
+protected:
+    bool m_ZeroCopy;
+
+public:
+    PSI_SinkStreamFactory(bool ZeroCopy) : m_ZeroCopy(ZeroCopy) {};
+
+    TS_PacketHandler *CreateStreamHandler(TS_Demuxer *Demuxer, uint16_t PID, uint8_t StreamType) override;
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include <vector>
+
+/*
+Batch TS packet header decoder.
+Decodes headers of many packets at once into structure-of-arrays form (one array per header field), which keeps
+per-packet filtering and continuity checks in tight, vectorizable loops. On x86 the AVX2 kernel gathers and
+decodes 8 headers per iteration, other platforms use the scalar kernel (xSwapBytes32 based).
+*/
+
+//=============================================================================================================================================================================
+
+class TS_PacketHeaderBatch {
+public:
+    enum class eKernel : int32_t {
+        Scalar,
+        AVX2,
+    };
+
+protected:
+    uint32_t m_NumPackets = 0;
+    eKernel m_Kernel;
+
+public:
+    std::vector<uint8_t> SyncByte;
+    std::vector<uint8_t> TransportErrorIndicator;
+    std::vector<uint8_t> PayloadUnitStartIndicator;
+    std::vector<uint8_t> TransportPriority;
+    std::vector<uint16_t> PID;
+    std::vector<uint8_t> TransportScramblingControl;
+    std::vector<uint8_t> AdaptationFieldControl;
+    std::vector<uint8_t> ContinuityCounter;
+
+public:
+    TS_PacketHeaderBatch(uint32_t Capacity = 1024);
+
+    //decodes NumPackets headers located at Data + i * Stride
+    void Decode(const uint8_t *Data, uint32_t NumPackets, uint32_t Stride = TS::TS_PacketLength);
+
+    //writes indexes of packets carrying given PID to Indexes (must hold getNumPackets() entries), returns their count
+    uint32_t SelectPID(uint16_t SelectedPID, uint32_t *Indexes) const;
+
+    uint32_t getNumPackets() const { return m_NumPackets; }
+
+    eKernel getKernel() const { return m_Kernel; }
+
+    //forces a kernel (e.g. for comparisons), returns false if it is not supported by this CPU/build
+    bool setKernel(eKernel Kernel);
+
+    bool hasAdaptationField(uint32_t Idx) const { return (AdaptationFieldControl[Idx] & 2) != 0; }
+
+    bool hasPayload(uint32_t Idx) const { return (AdaptationFieldControl[Idx] & 1) != 0; }
+
+    static bool isKernelSupported(eKernel Kernel);
+
+protected:
+    void xReserve(uint32_t Capacity);
+
+    void xDecodeScalar(const uint8_t *Data, uint32_t Begin, uint32_t End, uint32_t Stride);
+
+    uint32_t xDecodeAVX2(const uint8_t *Data, uint32_t NumPackets, uint32_t Stride);
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsSyncScanner.h"
+#include <memory>
+
+/*
+Packet sources hand out batches (spans) of contiguous, complete TS packets.
+The memory behind a span stays valid until the next call to ReadBatch().
+Sources synchronize to the stream on their own: packet size (188/192/204) is detected, bytes which do not belong
+to a packet are skipped (and counted) and after a sync loss the source searches for a new lock.
+Span.Data always points at the sync byte of the first packet, packets follow at Span.Stride.
+
+TS_MemoryPacketSource - spans point into a caller provided memory block
+TS_MmapPacketSource  - maps the whole file, spans point directly into the mapping (regular files)
+TS_BlockPacketSource - reads large blocks into an internal buffer (pipes, stdin, special files)
+TS_UdpPacketSource   - live UDP/RTP input (tsUdpPacketSource.h)
+
+Non-blocking mode (setNonBlocking, used by TS_AsyncReader): ReadBatch returns 0 also when no data arrived yet -
+isPending() tells it from the end of the stream, getPollDescriptor() is the descriptor to wait on. Memory, mmap and
+regular file sources never wait and have no such descriptor.
+TS_BlockPacketSource sets O_NONBLOCK on its descriptor, which may be shared with other processes (stdin of a shell) -
+the original flags are restored by setNonBlocking(false) and by the destructor.
+*/
+
+//=============================================================================================================================================================================
+
+struct TS_PacketSpan {
+    const uint8_t *Data = nullptr;
+    uint32_t NumPackets = 0;
+    uint64_t FirstPacketIndex = 0;
+    uint32_t Stride = TS::TS_PacketLength;
+
+    const uint8_t *getPacket(uint32_t Idx) const { return Data + (size_t) Idx * Stride; }
+};
+
+//=============================================================================================================================================================================
+
+class TS_PacketSource {
+public:
+    static constexpr uint32_t DefaultBatchSize = 1024; //packets
+
+    virtual ~TS_PacketSource() {};
+
+    //returns number of packets in Span, 0 at end of stream or on error
+    virtual uint32_t ReadBatch(TS_PacketSpan &Span) = 0;
+
+    bool isGood() const { return m_Good; }
+
+    //true if memory of all spans stays valid for the lifetime of the source (allows zero-copy consumers)
+    virtual bool isPersistent() const { return false; }
+
+    virtual void setNonBlocking(bool NonBlocking) { m_NonBlocking = NonBlocking; }
+
+    //last ReadBatch returned 0 because no data was available (non-blocking mode only), not at the end of stream
+    bool isPending() const { return m_Pending; }
+
+    //descriptor signalling readable data (epoll/poll), NOT_VALID if data is always available
+    virtual int getPollDescriptor() const { return NOT_VALID; }
+
+    uint64_t getNumPacketsRead() const { return m_NumPackets; }
+
+    //bytes at the end of the stream which did not form a complete packet
+    uint32_t getTrailingBytes() const { return m_TrailingBytes; }
+
+    //bytes dropped while searching for sync
+    uint64_t getSkippedBytes() const { return m_SkippedBytes; }
+
+    uint32_t getNumSyncLosses() const { return m_NumSyncLosses; }
+
+    //detected packet size (188, 192 or 204), valid once the first span was returned
+    uint32_t getPacketSize() const { return m_PacketSize; }
+
+    bool isLocked() const { return m_Locked; }
+
+    //picks mmap for regular files and block reads for everything else ("-" means stdin, "udp://addr:port" live input)
+    static std::unique_ptr<TS_PacketSource> Open(const char *FileName, uint32_t BatchSize = DefaultBatchSize);
+
+protected:
+    uint32_t m_BatchSize = DefaultBatchSize;
+    uint64_t m_NumPackets = 0;
+    uint32_t m_TrailingBytes = 0;
+    bool m_Good = false;
+    bool m_NonBlocking = false;
+    bool m_Pending = false;
+
+//sync
+    TS_SyncScanner m_Scanner;
+    bool m_Locked = false;
+    uint32_t m_PacketSize = TS::TS_PacketLength;
+    uint64_t m_SkippedBytes = 0;
+    uint32_t m_NumSyncLosses = 0;
+
+    //fills Span with aligned packets found at the beginning of Data, returns number of bytes consumed (skipped + packets)
+    uint64_t xExtractSpan(const uint8_t *Data, uint64_t Size, bool EndOfStream, TS_PacketSpan &Span);
+};
+
+//=============================================================================================================================================================================
+
+class TS_MemoryPacketSource : public TS_PacketSource {
+protected:
+    const uint8_t *m_Data = nullptr;
+    uint64_t m_Size = 0;
+    uint64_t m_Offset = 0;
+
+public:
+    //memory must stay valid for the lifetime of the source
+    TS_MemoryPacketSource(const uint8_t *Data, uint64_t Size, uint32_t BatchSize = DefaultBatchSize);
+
+    uint32_t ReadBatch(TS_PacketSpan &Span) override;
+
+    bool isPersistent() const override { return true; }
+
+    const uint8_t *getData() const { return m_Data; }
+
+    uint64_t getSize() const { return m_Size; }
+
+protected:
+    TS_MemoryPacketSource() {};
+};
+
+//=============================================================================================================================================================================
+
+//read-only mapping of a whole regular file, plain bytes without packet semantics (TS_MmapPacketSource, TS_Index)
+class TS_MappedFile {
+protected:
+    const uint8_t *m_Data = nullptr;
+    uint64_t m_Size = 0;
+
+public:
+    TS_MappedFile() {};
+
+    ~TS_MappedFile() { Close(); }
+
+    TS_MappedFile(const TS_MappedFile &) = delete;
+
+    TS_MappedFile &operator=(const TS_MappedFile &) = delete;
+
+    //false if the file cannot be mapped (also empty files and platforms without mmap), Sequential - access hint
+    bool Open(const char *FileName, bool Sequential = false);
+
+    void Close();
+
+    bool isOpen() const { return m_Data != nullptr; }
+
+    const uint8_t *getData() const { return m_Data; }
+
+    uint64_t getSize() const { return m_Size; }
+};
+
+//=============================================================================================================================================================================
+
+class TS_MmapPacketSource : public TS_MemoryPacketSource {
+protected:
+    TS_MappedFile m_File;
+
+public:
+    TS_MmapPacketSource(const char *FileName, uint32_t BatchSize = DefaultBatchSize);
+};
+
+//=============================================================================================================================================================================
+
+class TS_BlockPacketSource : public TS_PacketSource {
+protected:
+    int m_FileDescriptor = NOT_VALID;
+    bool m_OwnsDescriptor = false;
+    int m_OriginalFlags = NOT_VALID; //fcntl flags before the first setNonBlocking
+    bool m_EndOfStream = false;
+    uint8_t *m_Buffer = nullptr;
+    uint32_t m_BufferSize = 0;
+    uint32_t m_DataInBuffer = 0;  //includes partial packet carried over from previous read
+    uint32_t m_ConsumedBytes = 0;
+
+public:
+    TS_BlockPacketSource(const char *FileName, uint32_t BatchSize = DefaultBatchSize);
+
+    //does not take ownership of the descriptor
+    TS_BlockPacketSource(int FileDescriptor, uint32_t BatchSize = DefaultBatchSize);
+
+    ~TS_BlockPacketSource() override;
+
+    uint32_t ReadBatch(TS_PacketSpan &Span) override;
+
+    //sets O_NONBLOCK on the descriptor (no effect on regular files), false or the destructor restore its flags
+    void setNonBlocking(bool NonBlocking) override;
+
+    //the descriptor, NOT_VALID for regular files (always readable)
+    int getPollDescriptor() const override;
+
+protected:
+    void xInit(uint32_t BatchSize);
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsPacketSource.h"
+#include "tsDemuxer.h"
+#include "tsSpscRing.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/*
+Multi-threaded demultiplexing pipeline:
+
+  reader thread --> decode thread --+--> worker 0 (TS_Demuxer + PES handlers of its PIDs)
+                                    +--> worker 1
+                                    +--> ...
+
+Stages are connected with SPSC rings passing TS_PacketBatch pointers; every ring has a companion ring returning
+empty batches to the producer, so no memory is allocated after start-up. The decode thread parses PSI, assigns each
+discovered elementary PID to one worker (round robin) and hands its packets over in that worker's batch. A PID is
+always handled by the same worker and rings are FIFO, so the packet order of every stream is preserved.
+Packets are copied only when the source memory is reused (TS_PacketSource::isPersistent() false): the reader copies
+spans to its batches and the decode thread copies packets to worker batches. With a persistent source (memory,
+mmap) input batches point into the span and worker batches hold packet pointers - no packet is copied.
+An idle stage spins briefly on its ring and then sleeps (TS_SpscRing::Pop).
+
+The batch pools are the only input memory - a worker slower than the input (e.g. blocked on its output) empties
+its pool, the decode thread waits for it and the reader waits for the decode thread (backpressure; waits are counted
+as stalls). PES buffers of the workers are bounded by setBufferLimits.
+*/
+
+//=============================================================================================================================================================================
+
+struct TS_PacketBatch {
+    const uint8_t *Data = nullptr;     //NumPackets packets at Stride - Memory or the source's span
+    uint32_t Stride = TS::TS_PacketLength;
+    const uint8_t **Packets = nullptr; //packet pointers instead of Data (worker batches of persistent sources)
+    uint8_t *Memory = nullptr;         //own storage, room for a full batch of TS::TS_PacketLength packets
+    uint32_t NumPackets = 0;
+    bool EndOfStream = false;
+
+    const uint8_t *getPacket(uint32_t Idx) const { return Packets ? Packets[Idx] : Data + (size_t) Idx * Stride; }
+};
+
+//=============================================================================================================================================================================
+
+class TS_Pipeline {
+public:
+    static constexpr uint32_t DefaultQueueDepth = 16;
+
+protected:
+    struct Stage {
+        std::unique_ptr<TS_SpscRing<TS_PacketBatch *>> Full;
+        std::unique_ptr<TS_SpscRing<TS_PacketBatch *>> Free;
+        std::vector<TS_PacketBatch> Batches;
+        std::unique_ptr<uint8_t[]> Memory;
+        std::unique_ptr<const uint8_t *[]> Packets;
+    };
+
+    struct StreamInfo {
+        char FileName[32];
+    };
+
+    uint32_t m_NumWorkers;
+    uint32_t m_BatchSize;
+    uint32_t m_QueueDepth;
+    bool m_ZeroCopy = false; //source is persistent - packets are referenced, not copied
+    Stage m_InputStage;
+    std::vector<Stage> m_WorkerStages;
+    std::vector<std::unique_ptr<TS_Demuxer>> m_WorkerDemuxers;
+
+    //PID -> worker index, written by the decode thread before the first packet of the PID is queued
+    int16_t m_WorkerOfPID[TS_Demuxer::NumPIDs];
+    StreamInfo m_Streams[TS_Demuxer::NumPIDs];
+    uint32_t m_NextWorker = 0;
+
+    std::atomic<uint64_t> m_NumPacketsRead{0};
+    uint64_t m_NumDroppedPackets = 0;
+    uint64_t m_NumReaderStalls = 0;
+    uint64_t m_NumDecoderStalls = 0;
+
+public:
+    TS_Pipeline(uint32_t NumWorkers, uint32_t BatchSize = TS_PacketSource::DefaultBatchSize,
+                uint32_t QueueDepth = DefaultQueueDepth);
+
+    //processes the whole source, returns when all workers finished (output flushed)
+    void Run(TS_PacketSource *Source);
+
+    //assigns a PID to a worker which writes its PES payload to FileName (called by PSI discovery, may be used for
+    //streams without PSI before Run)
+    void RegisterStream(uint16_t PID, const char *FileName);
+
+    uint32_t getNumWorkers() const { return m_NumWorkers; }
+
+    uint64_t getNumPackets() const { return m_NumPacketsRead.load(); }
+
+    uint64_t getNumDroppedPackets() const { return m_NumDroppedPackets; }
+
+    //limits of the PES buffers of all workers (call before Run, Limits.Budget is shared by the workers)
+    void setBufferLimits(const TS_BufferLimits &Limits);
+
+    //times the reader found no free batch (decode thread behind, valid after Run)
+    uint64_t getNumReaderStalls() const { return m_NumReaderStalls; }
+
+    //times the decode thread found no free batch of a worker (worker behind, valid after Run)
+    uint64_t getNumDecoderStalls() const { return m_NumDecoderStalls; }
+
+    //packets processed by given worker (valid after Run)
+    uint64_t getNumWorkerPackets(uint32_t Worker) const { return m_WorkerDemuxers[Worker]->getNumPackets(); }
+
+protected:
+    void xInitStage(Stage &S);
+
+    void xSetZeroCopy(bool ZeroCopy);
+
+    void xReader(TS_PacketSource *Source);
+
+    void xDecoder();
+
+    void xWorker(uint32_t Worker);
+
+    static TS_PacketBatch *xPop(TS_SpscRing<TS_PacketBatch *> &Ring);
+
+    //xPop counting a wait for an empty ring
+    static TS_PacketBatch *xPop(TS_SpscRing<TS_PacketBatch *> &Ring, uint64_t &NumStalls);
+
+    static void xPush(TS_SpscRing<TS_PacketBatch *> &Ring, TS_PacketBatch *Batch);
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsFieldLayout.h"
+#include "tsPacketSource.h"
+#include "tsDemuxer.h"
+#include "tsOutputSink.h"
+#include "tsPSI.h"
+#include <memory>
+#include <vector>
+
+/*
+Transport stream remultiplexer - writes a selected set of programs / PIDs of the input as a new transport stream.
+
+Selection: programs (all of them if none is selected) with their elementary streams and PCR PID, plus PIDs
+forwarded as they are (SelectPID); ExcludePID removes a stream from the output and from its PMT. Everything else
+(other programs, SI, input null packets if stripped) is dropped.
+PSI: PAT and PMTs of the selected programs are regenerated (selected programs and streams only, remapped PIDs, new
+CRC) and sent in place of the input ones (at the packet completing an input section), so the repetition rate of the
+input is kept.
+PID remapping and continuity: the continuity_counter of an output PID is its own counter advanced by the steps of
+the input (duplicates stay duplicates, losses stay visible), generated PSI continues the counter of its PID.
+Every output PID carries one input PID. When remapping makes two PIDs meet (e.g. 256->257 while 257 is forwarded),
+tables win, then PIDs keeping their number, then remapped PIDs in ascending order; the losing PID is dropped, left
+out of PAT/PMT (a lost PCR PID becomes 0x1FFF) and counted (getNumPidCollisions) - streams are never merged.
+Packets whose PID and CC do not change are forwarded untouched; others get a rewritten 4 byte header.
+Output: packets are referenced in the input span, not copied - the output of a span is one gather write (views
+of consecutive packets merged) before the next span is read. Only rewritten headers, PSI and padding come from
+the remuxer's own memory.
+CBR: with a target bitrate null packets are inserted before every PCR of the first selected program so the PCR
+packet lands at the byte position the bitrate requires (input null packets are stripped). Input above the target
+bitrate cannot be padded - such PCR intervals are counted as overruns.
+*/
+
+//=============================================================================================================================================================================
+
+class TS_Remuxer {
+public:
+    static constexpr uint32_t NumPIDs = TS_Demuxer::NumPIDs;
+    static constexpr uint32_t ScratchSize = 64 * 1024;  //rewritten headers and PSI packets of a write
+    static constexpr uint32_t NullBlockPackets = 64;    //null packets per output view
+    static constexpr int64_t MaxPcrGap = TS::ExtendedClockFrequency_Hz; //1 s, longer PCR gaps restart CBR pacing
+
+protected:
+    enum class eAction : uint8_t {
+        Drop,
+        Forward,
+        PAT,
+        PMT,
+    };
+
+    struct Program {
+        uint16_t ProgramNumber;
+        uint16_t PMT_PID;
+        uint16_t PCR_PID = (uint16_t) TS_PacketHeader::ePID::NuLL;
+        std::vector<uint16_t> PIDs;    //selected elementary streams
+        std::vector<uint8_t> Section;  //input PMT section, empty until the PMT was received
+        std::vector<uint8_t> PMT;      //regenerated section
+        bool Collided = false;         //output PMT PID taken by another table - program left out
+    };
+
+    using xHeader = TS_LitePacketHeader<eLiteField_PID | eLiteField_ContinuityCounter |
+                                        eLiteField_AdaptationFieldControl | eLiteField_Discontinuity |
+                                        eLiteField_PCR>;
+
+    std::unique_ptr<TS_OutputSink> m_Sink;
+    bool m_Good = true;
+
+//configuration
+    std::vector<uint16_t> m_SelectedPrograms;
+    bool m_SelectedPIDs[NumPIDs] = {};
+    bool m_ExcludedPIDs[NumPIDs] = {};
+    uint16_t m_OutputPID[NumPIDs];
+    bool m_StripNull = false;
+    uint64_t m_TargetBitrate = 0;
+
+//PSI
+    TS_Demuxer m_PSIDemuxer;
+    uint16_t m_TransportStreamId = 0;
+    std::vector<Program> m_Programs;
+    std::vector<uint8_t> m_PAT;
+    uint8_t m_PatVersion = 0;
+    eAction m_Actions[NumPIDs];
+    bool m_Collided[NumPIDs]; //dropped at least once because its output PID was taken (counted once)
+
+//continuity
+    int8_t m_LastInputCC[NumPIDs];
+    int8_t m_LastOutputCC[NumPIDs];
+
+//CBR
+    uint16_t m_PcrPID = (uint16_t) TS_PacketHeader::ePID::NuLL;
+    int64_t m_LastPCR = NOT_VALID;
+    uint64_t m_LastPcrPacket = 0;
+    uint64_t m_PaddingRemainder = 0;
+
+//output
+    std::vector<TS_PayloadView> m_Views;
+    std::unique_ptr<uint8_t[]> m_Scratch;
+    uint32_t m_ScratchUsed = 0;
+
+//statistics
+    uint64_t m_NumPacketsIn = 0;
+    uint64_t m_NumPacketsOut = 0;
+    uint64_t m_NumRewrittenPackets = 0;
+    uint64_t m_NumPsiPackets = 0;
+    uint64_t m_NumPaddingPackets = 0;
+    uint64_t m_NumBitrateOverruns = 0;
+    uint64_t m_NumPidCollisions = 0;
+
+public:
+    //takes ownership of Sink
+    TS_Remuxer(TS_OutputSink *Sink);
+
+    //configuration - before the first packet
+    void SelectProgram(uint16_t ProgramNumber) { m_SelectedPrograms.push_back(ProgramNumber); }
+
+    //forwarded regardless of PSI (e.g. SI tables)
+    void SelectPID(uint16_t PID) { m_SelectedPIDs[PID & (NumPIDs - 1)] = true; }
+
+    void ExcludePID(uint16_t PID) { m_ExcludedPIDs[PID & (NumPIDs - 1)] = true; }
+
+    //false for PIDs which cannot be remapped (PAT, null packets, out of range)
+    bool RemapPID(uint16_t From, uint16_t To);
+
+    void setStripNull(bool StripNull) { m_StripNull = StripNull; }
+
+    //bits per second, 0 - no padding
+    void setTargetBitrate(uint64_t Bitrate) { m_TargetBitrate = Bitrate; }
+
+    //remuxes all packets of a span, output is written before returning (span memory is not referenced afterwards)
+    void Remux(const TS_PacketSpan &Span);
+
+    //remuxes the whole source and flushes the output
+    bool Run(TS_PacketSource &Source);
+
+    bool Flush();
+
+    //false after a failed write
+    bool isGood() const { return m_Good && m_Sink && m_Sink->isGood(); }
+
+    uint64_t getNumPacketsIn() const { return m_NumPacketsIn; }
+
+    uint64_t getNumPacketsOut() const { return m_NumPacketsOut; }
+
+    //forwarded packets with rewritten PID or continuity_counter
+    uint64_t getNumRewrittenPackets() const { return m_NumRewrittenPackets; }
+
+    uint64_t getNumPsiPackets() const { return m_NumPsiPackets; }
+
+    uint64_t getNumPaddingPackets() const { return m_NumPaddingPackets; }
+
+    //PCR intervals with more input than the target bitrate allows
+    uint64_t getNumBitrateOverruns() const { return m_NumBitrateOverruns; }
+
+    //input PIDs dropped because their output PID (after remapping) was already taken by another PID
+    uint64_t getNumPidCollisions() const { return m_NumPidCollisions; }
+
+    //called by PSI discovery
+    void UpdatePAT(const PSI_PATHandler &Handler);
+
+    void UpdatePMT(const uint8_t *Section, uint32_t Length);
+
+protected:
+    void xRemuxPacket(const uint8_t *Packet);
+
+    //recomputes actions of all PIDs and the PAT after a PSI change
+    void xRebuild();
+
+    bool xIsSelected(uint16_t ProgramNumber) const;
+
+    //takes the output PID of PID in Owner (indexed by output PID), false (and counted) if another PID holds it
+    bool xClaim(std::vector<uint16_t> &Owner, uint16_t PID);
+
+    //output PMT of P from its input section - streams which lost their output PID are left out
+    void xBuildPMT(Program &P, const std::vector<uint16_t> &Owner);
+
+    //continuity_counter of the next output packet of OutputPID, Step - increment of the input counter
+    uint8_t xNextCC(uint16_t OutputPID, uint8_t Step, uint8_t InputCC);
+
+    void xPad(int64_t PCR, bool Discontinuity);
+
+    void xEmit(const uint8_t *Data, uint32_t Size);
+
+    void xEmitSection(const std::vector<uint8_t> &Section, uint16_t OutputPID);
+
+    uint8_t *xScratch(uint32_t Size);
+
+    void xWrite();
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "tsCommon.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+/*
+Bounded lock-free single-producer/single-consumer ring.
+Capacity is rounded up to a power of two. Head (consumer) and tail (producer) indexes live on separate cache lines;
+each side reads the other's index only when its cached copy says the ring is full/empty.
+Push/Pop block on a full/empty ring: they poll for SpinCount tries and then sleep on a condition variable. The other
+side takes the mutex only when a waiter announced itself, so the uncontended path stays lock-free.
+*/
+
+//=============================================================================================================================================================================
+
+template<class T>
+class TS_SpscRing {
+public:
+    static constexpr uint32_t CacheLineSize = 64;
+    static constexpr uint32_t SpinCount = 256;
+
+protected:
+    std::vector<T> m_Slots;
+    uint64_t m_Mask;
+
+    //padding keeps producer and consumer state on separate cache lines (also without C++17 aligned new)
+    uint8_t m_Padding0[CacheLineSize];
+    std::atomic<uint64_t> m_Head{0}; //next slot to pop
+    uint64_t m_CachedTail = 0;       //consumer's view of m_Tail
+    uint8_t m_Padding1[CacheLineSize];
+    std::atomic<uint64_t> m_Tail{0}; //next slot to push
+    uint64_t m_CachedHead = 0;       //producer's view of m_Head
+    uint8_t m_Padding2[CacheLineSize];
+
+    //blocking side - at most one of producer/consumer waits (the ring cannot be full and empty at once)
+    std::atomic<bool> m_Waiting{false};
+    std::mutex m_Mutex;
+    std::condition_variable m_Wakeup;
+
+public:
+    TS_SpscRing(uint32_t Capacity) {
+        uint64_t Size = 1;
+        while (Size < Capacity) Size <<= 1;
+        m_Slots.resize(Size);
+        m_Mask = Size - 1;
+    }
+
+    TS_SpscRing(const TS_SpscRing &) = delete;
+
+    TS_SpscRing &operator=(const TS_SpscRing &) = delete;
+
+    //producer side
+    bool TryPush(const T &Item) {
+        const uint64_t Tail = m_Tail.load(std::memory_order_relaxed);
+        if (Tail - m_CachedHead > m_Mask) {
+            m_CachedHead = m_Head.load(std::memory_order_acquire);
+            if (Tail - m_CachedHead > m_Mask) return false;
+        }
+        m_Slots[Tail & m_Mask] = Item;
+        m_Tail.store(Tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //consumer side
+    bool TryPop(T &Item) {
+        const uint64_t Head = m_Head.load(std::memory_order_relaxed);
+        if (Head == m_CachedTail) {
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+            if (Head == m_CachedTail) return false;
+        }
+        Item = m_Slots[Head & m_Mask];
+        m_Head.store(Head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //producer side, waits while the ring is full
+    void Push(const T &Item) {
+        for (uint32_t s = 0; s < SpinCount; s++)
+            if (TryPush(Item)) return xWake();
+        xWait([&] { return TryPush(Item); });
+        xWake();
+    }
+
+    //consumer side, waits while the ring is empty
+    T Pop() {
+        T Item;
+        for (uint32_t s = 0; s < SpinCount; s++)
+            if (TryPop(Item)) {
+                xWake();
+                return Item;
+            }
+        xWait([&] { return TryPop(Item); });
+        xWake();
+        return Item;
+    }
+
+    //approximate number of queued items (for statistics)
+    uint32_t getSize() const {
+        return (uint32_t) (m_Tail.load(std::memory_order_relaxed) - m_Head.load(std::memory_order_relaxed));
+    }
+
+    uint32_t getCapacity() const { return (uint32_t) (m_Mask + 1); }
+
+protected:
+    //announce the waiter before the last try - the fences pair with xWake, so either the other side sees the
+    //announcement or the last try sees its index update
+    template<class Try>
+    void xWait(Try TryOnce) {
+        std::unique_lock<std::mutex> Lock(m_Mutex);
+        m_Waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!TryOnce()) m_Wakeup.wait(Lock);
+        m_Waiting.store(false, std::memory_order_relaxed);
+    }
+
+    void xWake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_Waiting.load(std::memory_order_relaxed)) return;
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        m_Wakeup.notify_one();
+    }
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsStatsHooks.h"
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+Export of the hot-path statistics (counters and hooks in tsStatsHooks.h).
+TS_StatsDumper periodically rewrites a Prometheus text file from a background thread.
+*/
+
+//=============================================================================================================================================================================
+
+//writes TS_Stats::WritePrometheus(FileName) every Interval_ms from a background thread, and once more when stopped
+class TS_StatsDumper {
+protected:
+    std::string m_FileName;
+    uint32_t m_Interval_ms;
+    std::thread m_Thread;
+    std::mutex m_Mutex;
+    std::condition_variable m_Wakeup;
+    bool m_Stop = false;
+
+public:
+    TS_StatsDumper(const char *FileName, uint32_t Interval_ms = 1000);
+
+    ~TS_StatsDumper() { Stop(); }
+
+    void Stop();
+
+protected:
+    void xRun();
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "tsCommon.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+#ifndef TS_ENABLE_STATS
+#define TS_ENABLE_STATS 0
+#endif
+
+/*
+Hot-path instrumentation - stage cycle counters (rdtsc) and per-PID counters.
+This header holds the counters and hook macros only (included by the parsing headers), the periodic dump lives in
+tsStats.h.
+
+Compile time: TS_ENABLE_STATS (CMake option of the same name, off by default). Without it every hook macro expands to
+nothing and TS_STATS_ENABLED() to false.
+Run time: TS_Stats::setEnabled(true). Hooks are placed per span or batch, never per packet - per-packet code
+(TS_PacketHeader::Parse, TS_AdaptationField::Parse, PES_Assembler::AbsorbPacket, TS_Demuxer::DemuxPacket) has no
+hooks and no enabled check. While disabled a span costs one relaxed load and a predictable branch.
+With stats enabled TS_Demuxer::Demux and TS_StreamParser::Parse process a span in passes (all headers, all
+adaptation fields, then routing), so every stage is timed once per span. Results and handler calls are the same as
+in the single pass.
+
+Every thread updates its own counter block (registered on first use, folded into the retired totals and freed at
+thread exit), so the hot path has no shared writes and no locks. getSnapshot() merges all blocks on demand; counters are single-writer relaxed
+atomics, so reading them from another thread is safe (snapshot is not an atomic cut across counters).
+
+Stages (inclusive, may nest - PesAssembly contains Output of finished PES, Read of block sources contains no Sync):
+  Read                 - read()/recvmmsg() of packet sources
+  Sync                 - sync byte search and span extraction
+  HeaderParse          - header pass of TS_Demuxer::Demux / TS_StreamParser::Parse, TS_PacketHeaderBatch::Decode
+  AdaptationFieldParse - adaptation field pass of TS_Demuxer::Demux / TS_StreamParser::Parse
+  PesAssembly          - routing pass (PSI, PES assembly, visitor calls), TS_Pipeline worker batches (including
+                         their header parsing)
+  Output               - PES and event log output (sinks, files)
+Packets parsed one by one (per-packet dump, TS_ChunkedDemuxer chunks, remuxer, monitor, timing) are not timed.
+Per PID: packets and payload bytes routed to a handler by TS_Demuxer::Demux, TS_Pipeline, TS_ChunkedDemuxer and the
+per-packet dump, parsed by TS_StreamParser::Parse (PSI pre-pass of TS_ChunkedDemuxer counts PSI packets twice), PES
+started by PES_Assembler.
+Global: PES buffer allocations, pipeline queue depth (sampled at every push of a full batch).
+*/
+
+//=============================================================================================================================================================================
+
+class TS_Stats {
+public:
+    enum class eStage : int32_t {
+        Read,
+        Sync,
+        HeaderParse,
+        AdaptationFieldParse,
+        PesAssembly,
+        Output,
+    };
+
+    static constexpr uint32_t NumStages = (uint32_t) eStage::Output + 1;
+    static constexpr uint32_t NumPIDs = 8192;
+
+    //written by one thread only - plain load/store, no locked instructions
+    class Counter {
+    protected:
+        std::atomic<uint64_t> m_Value{0};
+
+    public:
+        void Add(uint64_t Value) {
+            m_Value.store(m_Value.load(std::memory_order_relaxed) + Value, std::memory_order_relaxed);
+        }
+
+        void Max(uint64_t Value) {
+            if (Value > m_Value.load(std::memory_order_relaxed)) m_Value.store(Value, std::memory_order_relaxed);
+        }
+
+        uint64_t get() const { return m_Value.load(std::memory_order_relaxed); }
+    };
+
+    struct ThreadCounters {
+        Counter StageCycles[NumStages];
+        Counter StageCalls[NumStages];
+        Counter PidPackets[NumPIDs];
+        Counter PidBytes[NumPIDs];
+        Counter PidPES[NumPIDs];
+        Counter NumAllocations;
+        Counter QueueDepthSum;
+        Counter NumQueueDepthSamples;
+        Counter MaxQueueDepth;
+    };
+
+    struct PidSnapshot {
+        uint16_t PID;
+        uint64_t Packets;
+        uint64_t Bytes; //payload
+        uint64_t PES;
+    };
+
+    struct Snapshot {
+        uint64_t StageCycles[NumStages];
+        uint64_t StageCalls[NumStages];
+        double StageSeconds[NumStages];
+        std::vector<PidSnapshot> PIDs; //PIDs with any activity, ascending
+        uint64_t NumAllocations;
+        uint64_t MaxQueueDepth;
+        double AvgQueueDepth;
+        uint32_t NumThreads;           //running and finished threads which reported statistics
+        double CyclesPerSecond;        //measured since the first setEnabled(true)
+        double Uptime;                 //seconds since the first setEnabled(true)
+    };
+
+protected:
+    struct ThreadOwner; //retires the counter block of its thread at thread exit
+
+    static std::atomic<bool> s_Enabled;
+    static thread_local ThreadCounters *t_Counters;
+    static thread_local ThreadOwner t_Owner;
+
+public:
+    static constexpr bool isCompiled() { return TS_ENABLE_STATS != 0; }
+
+    static bool isEnabled() { return TS_ENABLE_STATS && s_Enabled.load(std::memory_order_relaxed); }
+
+    //returns false (and stays disabled) in builds without TS_ENABLE_STATS
+    static bool setEnabled(bool Enabled);
+
+    //counter block of the calling thread
+    static ThreadCounters &Local() {
+        if (t_Counters == nullptr) t_Counters = xRegisterThread();
+        return *t_Counters;
+    }
+
+    static uint64_t ReadCycles() {
+#if defined(_MSC_VER) || (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+        return __rdtsc();
+#else
+        return xReadClock_ns();
+#endif
+    }
+
+    //merges counters of all threads
+    static void getSnapshot(Snapshot &S);
+
+    static const char *getStageName(eStage Stage);
+
+    //Prometheus text exposition format
+    static std::string FormatPrometheus(const Snapshot &S);
+
+    //snapshot written to FileName.tmp and renamed (readers never see a partial file)
+    static bool WritePrometheus(const char *FileName);
+
+protected:
+    static ThreadCounters *xRegisterThread();
+
+    static uint64_t xReadClock_ns();
+};
+
+//=============================================================================================================================================================================
+
+class TS_StageTimer {
+protected:
+    uint64_t m_Start;
+    TS_Stats::eStage m_Stage;
+
+public:
+    explicit TS_StageTimer(TS_Stats::eStage Stage)
+            : m_Start(TS_Stats::isEnabled() ? TS_Stats::ReadCycles() : 0), m_Stage(Stage) {};
+
+    ~TS_StageTimer() {
+        if (m_Start == 0) return;
+        TS_Stats::ThreadCounters &Counters = TS_Stats::Local();
+        Counters.StageCycles[(uint32_t) m_Stage].Add(TS_Stats::ReadCycles() - m_Start);
+        Counters.StageCalls[(uint32_t) m_Stage].Add(1);
+    }
+
+    TS_StageTimer(const TS_StageTimer &) = delete;
+
+    TS_StageTimer &operator=(const TS_StageTimer &) = delete;
+};
+
+//=============================================================================================================================================================================
+// hooks
+//=============================================================================================================================================================================
+#if TS_ENABLE_STATS
+#define TS_STATS_CONCAT_(A, B) A##B
+#define TS_STATS_CONCAT(A, B) TS_STATS_CONCAT_(A, B)
+//hoisted out of packet loops - constant false without TS_ENABLE_STATS
+#define TS_STATS_ENABLED() TS_Stats::isEnabled()
+//times the rest of the enclosing scope
+#define TS_STATS_TIMER(Stage) TS_StageTimer TS_STATS_CONCAT(xStageTimer, __LINE__)(TS_Stats::eStage::Stage)
+//only where TS_STATS_ENABLED() was checked (no check of its own)
+#define TS_STATS_PACKET(PID, Bytes) do { \
+        TS_Stats::ThreadCounters &xStatsCounters = TS_Stats::Local(); \
+        xStatsCounters.PidPackets[(PID) & (TS_Stats::NumPIDs - 1)].Add(1); \
+        xStatsCounters.PidBytes[(PID) & (TS_Stats::NumPIDs - 1)].Add(Bytes); } while (0)
+#define TS_STATS_PES(PID) do { if (TS_Stats::isEnabled()) \
+        TS_Stats::Local().PidPES[(PID) & (TS_Stats::NumPIDs - 1)].Add(1); } while (0)
+#define TS_STATS_ALLOCATION() do { if (TS_Stats::isEnabled()) TS_Stats::Local().NumAllocations.Add(1); } while (0)
+#define TS_STATS_QUEUE_DEPTH(Depth) do { if (TS_Stats::isEnabled()) { \
+        TS_Stats::ThreadCounters &xStatsCounters = TS_Stats::Local(); \
+        xStatsCounters.QueueDepthSum.Add(Depth); \
+        xStatsCounters.NumQueueDepthSamples.Add(1); \
+        xStatsCounters.MaxQueueDepth.Max(Depth); } } while (0)
+#else
+#define TS_STATS_ENABLED() false
+#define TS_STATS_TIMER(Stage) do {} while (0)
+#define TS_STATS_PACKET(PID, Bytes) do {} while (0)
+#define TS_STATS_PES(PID) do {} while (0)
+#define TS_STATS_ALLOCATION() do {} while (0)
+#define TS_STATS_QUEUE_DEPTH(Depth) do {} while (0)
+#endif
+
+//=============================================================================================================================================================================
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include <vector>
+
+/*
+Deterministic synthetic transport stream generator (benchmarks, reproducing parser issues without sample files).
+The same configuration and seed always produce the same bytes - on every platform (own xorshift PRNG, no <random>
+distributions).
+
+Stream layout: PAT (program 1) and PMT on PmtPID repeated every PsiInterval packets, NumPIDs elementary streams
+starting at FirstPID (first one H.264 video carrying PCR, others MPEG audio). Packets of the elementary streams are
+interleaved randomly, each stream sends PES packets of MinPesSize..MaxPesSize payload bytes with PTS.
+Optional impairments: adaptation fields on ordinary packets, dropped packets (continuity errors) and junk bytes
+between packets (sync loss / misalignment).
+*/
+
+//=============================================================================================================================================================================
+
+class TS_StreamGenerator {
+public:
+    struct Config {
+        uint64_t Seed = 1;
+        uint64_t NumPackets = 100000;          //packets generated (including dropped ones)
+        uint32_t NumPIDs = 4;                  //elementary streams
+        uint16_t FirstPID = 0x100;
+        uint16_t PmtPID = 0x1000;
+        uint32_t MinPesSize = 2000;            //PES payload bytes
+        uint32_t MaxPesSize = 20000;
+        uint32_t AdaptationFieldPermille = 0;  //share of payload packets with (flags only) adaptation field
+        uint32_t PcrInterval = 40;             //packets of the PCR PID between PCRs, 0 - no PCR
+        uint32_t LossPermille = 0;             //dropped packets
+        uint32_t MisalignmentInterval = 0;     //junk bytes inserted every N packets, 0 - none
+        uint32_t PsiInterval = 1000;           //PAT/PMT repetition (packets)
+        uint32_t PacketSize = TS::TS_PacketLength; //188, 192 (M2TS) or 204 (RS parity, zeroed)
+        uint32_t Bitrate = 20000000;           //bit/s, used for PCR/PTS values
+    };
+
+protected:
+    struct xStream {
+        uint16_t PID;
+        uint8_t StreamId;
+        uint8_t CC = 0;
+        std::vector<uint8_t> PES;            //current PES packet (header + payload)
+        uint32_t Pos = 0;
+        uint32_t NumSincePCR = 0;
+        uint64_t NumPES = 0;
+    };
+
+    Config m_Config;
+    uint64_t m_Random;
+    std::vector<xStream> m_Streams;
+    std::vector<uint8_t> m_PAT;
+    std::vector<uint8_t> m_PMT;
+    uint8_t m_PatCC = 0;
+    uint8_t m_PmtCC = 0;
+
+//counters
+    uint64_t m_NumPackets = 0;       //written
+    uint64_t m_NumDropped = 0;
+    uint64_t m_NumJunkBytes = 0;
+    uint64_t m_NumPES = 0;
+    uint64_t m_NumPCRs = 0;
+
+public:
+    TS_StreamGenerator(const Config &C);
+
+    //appends the whole stream to Stream
+    void Generate(std::vector<uint8_t> &Stream);
+
+    const Config &getConfig() const { return m_Config; }
+
+    uint64_t getNumPackets() const { return m_NumPackets; }
+
+    uint64_t getNumDropped() const { return m_NumDropped; }
+
+    uint64_t getNumJunkBytes() const { return m_NumJunkBytes; }
+
+    uint64_t getNumPES() const { return m_NumPES; }
+
+    uint64_t getNumPCRs() const { return m_NumPCRs; }
+
+protected:
+    uint64_t xRandom();
+
+    //<Min, Max>
+    uint32_t xRandom(uint32_t Min, uint32_t Max) { return Min + (uint32_t) (xRandom() % ((uint64_t) Max - Min + 1)); }
+
+    void xBuildPSI();
+
+    void xStartPES(xStream &Stream, uint64_t PacketIndex);
+
+    //one packet of Stream, PCR - NOT_VALID if none
+    void xPacket(uint8_t *Packet, xStream &Stream, int64_t PCR);
+
+    void xSectionPacket(uint8_t *Packet, uint16_t PID, const std::vector<uint8_t> &Section, uint8_t &CC);
+
+    void xWrite(std::vector<uint8_t> &Stream, const uint8_t *Packet, uint64_t PacketIndex);
+};
+
+//=============================================================================================================================================================================
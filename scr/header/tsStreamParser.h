@@ -0,0 +1,232 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsPacketSource.h"
+#include "tsDemuxer.h"
+#include "tsPSI.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+/*
+Embeddable streaming parser - no printing, no files.
+TS_StreamParser<Visitor> parses packet spans and reports everything through the visitor:
+
+  onStream          - elementary stream announced in PMT (PID, stream_type), once per PID
+  onPacket          - every packet (parsed header + raw packet)
+  onAdaptationField - every packet carrying an adaptation field
+  onPcr             - every PCR (27 MHz units)
+  onPesStart        - start of PES (parsed PES header)
+  onPesComplete     - complete PES (payload without PES header as views, valid only during the call)
+  onPesTruncated    - precedes onPesComplete of a PES cut by the buffer limits (setBufferLimits)
+
+Visitors derive from TS_Visitor and hide the methods they are interested in; calls are resolved at compile time so
+unused events cost nothing. TS_CallbackVisitor is a type-erased variant based on std::function.
+PES assembly is enabled per PID with EnablePES() or automatically for streams announced in PAT/PMT.
+*/
+
+//=============================================================================================================================================================================
+
+class TS_Visitor {
+public:
+    void onStream(uint16_t, uint8_t) {}
+
+    void onPacket(const TS_PacketHeader &, const uint8_t *) {}
+
+    void onAdaptationField(const TS_PacketHeader &, const TS_AdaptationField &) {}
+
+    void onPcr(uint16_t, uint64_t) {}
+
+    void onPesStart(uint16_t, const PES_PacketHeader &) {}
+
+    void onPesComplete(uint16_t, const PES_PacketHeader &, const TS_PayloadView *, uint32_t) {}
+
+    void onPesTruncated(uint16_t, const PES_PacketHeader &) {}
+};
+
+//=============================================================================================================================================================================
+
+class TS_CallbackVisitor : public TS_Visitor {
+public:
+    std::function<void(uint16_t, uint8_t)> OnStream;
+    std::function<void(const TS_PacketHeader &, const uint8_t *)> OnPacket;
+    std::function<void(const TS_PacketHeader &, const TS_AdaptationField &)> OnAdaptationField;
+    std::function<void(uint16_t, uint64_t)> OnPcr;
+    std::function<void(uint16_t, const PES_PacketHeader &)> OnPesStart;
+    std::function<void(uint16_t, const PES_PacketHeader &, const TS_PayloadView *, uint32_t)> OnPesComplete;
+    std::function<void(uint16_t, const PES_PacketHeader &)> OnPesTruncated;
+
+    void onStream(uint16_t PID, uint8_t StreamType) {
+        if (OnStream) OnStream(PID, StreamType);
+    }
+
+    void onPacket(const TS_PacketHeader &Header, const uint8_t *Packet) {
+        if (OnPacket) OnPacket(Header, Packet);
+    }
+
+    void onAdaptationField(const TS_PacketHeader &Header, const TS_AdaptationField &AdaptationField) {
+        if (OnAdaptationField) OnAdaptationField(Header, AdaptationField);
+    }
+
+    void onPcr(uint16_t PID, uint64_t PCR) {
+        if (OnPcr) OnPcr(PID, PCR);
+    }
+
+    void onPesStart(uint16_t PID, const PES_PacketHeader &Header) {
+        if (OnPesStart) OnPesStart(PID, Header);
+    }
+
+    void onPesComplete(uint16_t PID, const PES_PacketHeader &Header, const TS_PayloadView *Views, uint32_t NumViews) {
+        if (OnPesComplete) OnPesComplete(PID, Header, Views, NumViews);
+    }
+
+    void onPesTruncated(uint16_t PID, const PES_PacketHeader &Header) {
+        if (OnPesTruncated) OnPesTruncated(PID, Header);
+    }
+};
+
+//=============================================================================================================================================================================
+
+template<class Visitor>
+class TS_StreamParser : protected TS_StreamFactory {
+protected:
+    Visitor &m_Visitor;
+    TS_PacketHeader m_PacketHeader;
+    TS_AdaptationField m_AdaptationField;
+    std::unique_ptr<PES_Assembler> m_Assemblers[TS_Demuxer::NumPIDs];
+    std::vector<TS_PayloadView> m_Views;
+    std::vector<TS_PacketHeader> m_SpanHeaders;              //measured span passes only (TS_Stats enabled)
+    std::vector<TS_AdaptationField> m_SpanAdaptationFields;
+    TS_Demuxer m_PSIDemuxer; //PAT/PMT only, discovered streams end up in EnablePES
+    bool m_ZeroCopy = false;
+    TS_BufferLimits m_BufferLimits;
+    uint64_t m_NumPackets = 0;
+
+public:
+    //AutoDiscovery - enable PES assembly for all elementary streams found in PAT/PMT
+    TS_StreamParser(Visitor &V, bool AutoDiscovery = true) : m_Visitor(V) {
+        if (!AutoDiscovery) return;
+        m_PSIDemuxer.setStreamFactory(this);
+        m_PSIDemuxer.AddHandler<PSI_PATHandler>((uint16_t) TS_PacketHeader::ePID::PAT, &m_PSIDemuxer);
+    }
+
+    //payload views point into packet memory - only for persistent sources (TS_PacketSource::isPersistent)
+    void setZeroCopy(bool ZeroCopy) { m_ZeroCopy = ZeroCopy; }
+
+    void EnablePES(uint16_t PID) {
+        PID &= TS_Demuxer::NumPIDs - 1;
+        if (m_Assemblers[PID]) return;
+        m_Assemblers[PID].reset(new PES_Assembler);
+        m_Assemblers[PID]->Init(PID, nullptr, m_ZeroCopy);
+        m_Assemblers[PID]->setBufferLimits(m_BufferLimits);
+    }
+
+    //bounded memory - PES over the limits is reported truncated (onPesTruncated + onPesComplete) and dropped
+    void setBufferLimits(const TS_BufferLimits &Limits) {
+        m_BufferLimits = Limits;
+        for (std::unique_ptr<PES_Assembler> &Assembler : m_Assemblers)
+            if (Assembler) Assembler->setBufferLimits(Limits);
+    }
+
+    void DisablePES(uint16_t PID) { m_Assemblers[PID & (TS_Demuxer::NumPIDs - 1)].reset(); }
+
+    void Parse(const TS_PacketSpan &Span) {
+        if (TS_STATS_ENABLED()) {
+            xParseMeasured(Span);
+            return;
+        }
+        for (uint32_t i = 0; i < Span.NumPackets; i++) ParsePacket(Span.getPacket(i));
+    }
+
+    void ParsePacket(const uint8_t *Packet) {
+        m_PacketHeader.Parse(Packet);
+        if (m_PacketHeader.hasAdaptationField()) m_AdaptationField.Parse(Packet);
+        xRoutePacket(Packet, m_PacketHeader, m_AdaptationField);
+    }
+
+    //reports PES still being assembled (end of stream)
+    void Finish() {
+        for (std::unique_ptr<PES_Assembler> &Assembler : m_Assemblers) {
+            if (Assembler && Assembler->isStarted()) {
+                xCompletePES(*Assembler);
+                Assembler->Flush();
+            }
+        }
+    }
+
+    //parses the whole source and calls Finish()
+    void Run(TS_PacketSource &Source) {
+        TS_PacketSpan Span;
+        while (Source.ReadBatch(Span)) Parse(Span);
+        Finish();
+    }
+
+    uint64_t getNumPackets() const { return m_NumPackets; }
+
+protected:
+    void xRoutePacket(const uint8_t *Packet, const TS_PacketHeader &PacketHeader,
+                      const TS_AdaptationField &AdaptationField) {
+        m_NumPackets++;
+        const uint16_t PID = PacketHeader.getPID();
+        m_Visitor.onPacket(PacketHeader, Packet);
+        if (PacketHeader.hasAdaptationField()) {
+            m_Visitor.onAdaptationField(PacketHeader, AdaptationField);
+            if (AdaptationField.getPCR()) m_Visitor.onPcr(PID, (uint64_t) AdaptationField.getPCR_data());
+        }
+        //handler called directly - the packet is parsed already
+        if (TS_PacketHandler *Handler = m_PSIDemuxer.getHandler(PID))
+            Handler->AbsorbPacket(Packet, &PacketHeader, &AdaptationField);
+
+        PES_Assembler *Assembler = m_Assemblers[PID].get();
+        if (Assembler == nullptr) return;
+        if (PacketHeader.getPayloadUnitStartIndicator() && Assembler->isStarted()) xCompletePES(*Assembler);
+        const PES_Assembler::eResult Result = Assembler->AbsorbPacket(Packet, &PacketHeader, &AdaptationField);
+        if (Result == PES_Assembler::eResult::AssemblingStarted) m_Visitor.onPesStart(PID, Assembler->getPESH());
+        else if (Result == PES_Assembler::eResult::BufferOverflow && Assembler->isStarted()) {
+            xCompletePES(*Assembler);
+            Assembler->DropPES();
+        }
+    }
+
+    //Parse with every stage timed once per span - headers, adaptation fields, then routing and PES assembly
+    void xParseMeasured(const TS_PacketSpan &Span) {
+        if (m_SpanHeaders.size() < Span.NumPackets) {
+            m_SpanHeaders.resize(Span.NumPackets);
+            m_SpanAdaptationFields.resize(Span.NumPackets);
+        }
+        {
+            TS_STATS_TIMER(HeaderParse);
+            for (uint32_t i = 0; i < Span.NumPackets; i++) m_SpanHeaders[i].Parse(Span.getPacket(i));
+        }
+        {
+            TS_STATS_TIMER(AdaptationFieldParse);
+            for (uint32_t i = 0; i < Span.NumPackets; i++)
+                if (m_SpanHeaders[i].hasAdaptationField()) m_SpanAdaptationFields[i].Parse(Span.getPacket(i));
+        }
+        TS_STATS_TIMER(PesAssembly);
+        for (uint32_t i = 0; i < Span.NumPackets; i++) {
+            xRoutePacket(Span.getPacket(i), m_SpanHeaders[i], m_SpanAdaptationFields[i]);
+            TS_STATS_PACKET(m_SpanHeaders[i].getPID(),
+                            TS_Demuxer::getPayloadSize(&m_SpanHeaders[i], &m_SpanAdaptationFields[i]));
+        }
+    }
+
+    void xCompletePES(PES_Assembler &Assembler) {
+        if (Assembler.isTruncated()) m_Visitor.onPesTruncated((uint16_t) Assembler.m_PID, Assembler.getPESH());
+        Assembler.getPayloadViews(m_Views);
+        m_Visitor.onPesComplete((uint16_t) Assembler.m_PID, Assembler.getPESH(), m_Views.data(), (uint32_t) m_Views.size());
+    }
+
+    //called for every PMT repetition
+    TS_PacketHandler *CreateStreamHandler(TS_Demuxer *, uint16_t PID, uint8_t StreamType) override {
+        if (m_Assemblers[PID & (TS_Demuxer::NumPIDs - 1)]) return nullptr;
+        EnablePES(PID);
+        m_Visitor.onStream(PID, StreamType);
+        return nullptr;
+    }
+};
+
+typedef TS_StreamParser<TS_CallbackVisitor> TS_CallbackParser;
+
+//=============================================================================================================================================================================
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+
+/*
+Sync byte scanner.
+Looks for a run of sync bytes (0x47) repeating at one of the supported packet strides:
+188 - plain TS, 192 - M2TS (4-byte timestamp prefix), 204 - TS followed by 16 Reed-Solomon bytes.
+Candidate sync bytes are located with SSE2 (16 bytes per compare) and confirmed by checking LockCount
+consecutive strides, so a random 0x47 inside a payload does not cause a false lock.
+*/
+
+//=============================================================================================================================================================================
+
+class TS_SyncScanner {
+public:
+    static constexpr uint32_t DefaultLockCount = 5;
+    static constexpr uint32_t NumPacketSizes = 3;
+    static constexpr uint32_t PacketSizes[NumPacketSizes] = {TS::TS_PacketLength, TS::M2TS_PacketLength,
+                                                             TS::RS_PacketLength};
+
+    enum class eResult : int32_t {
+        Locked,       //sync found at returned offset
+        NeedMoreData, //a candidate at returned offset needs more data to be confirmed
+        NotFound,     //no sync in the whole buffer
+    };
+
+protected:
+    uint32_t m_LockCount = DefaultLockCount;
+
+public:
+    TS_SyncScanner(uint32_t LockCount = DefaultLockCount) : m_LockCount(LockCount) {};
+
+    //searches Data for LockCount consecutive sync bytes; at end of stream shorter runs reaching the end are accepted
+    eResult FindLock(const uint8_t *Data, uint64_t Size, bool EndOfStream, uint64_t &Offset, uint32_t &PacketSize) const;
+
+    //number of consecutive complete packets (max MaxPackets) starting with a sync byte at given stride
+    static uint32_t CountAligned(const uint8_t *Data, uint64_t Size, uint32_t PacketSize, uint32_t MaxPackets) {
+        uint32_t NumPackets = 0;
+        uint64_t Pos = 0;
+        while (NumPackets < MaxPackets && Pos + TS::TS_PacketLength <= Size && Data[Pos] == TS::TS_SyncByte) {
+            NumPackets++;
+            Pos += PacketSize;
+        }
+        return NumPackets;
+    }
+
+    //offset of the first sync byte in [Begin, End), End if none
+    static uint64_t FindSyncByte(const uint8_t *Data, uint64_t Begin, uint64_t End);
+
+    uint32_t getLockCount() const { return m_LockCount; }
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsDemuxer.h"
+#include <memory>
+
+/*
+PCR timing analysis (clock recovery view of a multiplex), O(1) state per PCR PID, no allocation per packet.
+
+Byte position of every PCR is known from the packet index, so consecutive PCRs give the transport rate. A running
+linear fit of PCR over byte position gives the constant-rate model, the residual is PCR accuracy (TR 101 290 PCR_ac,
+limit +-500 ns). When packets carry arrival times (live input) a second fit of arrival time over PCR gives PCR_oj
+(overall jitter) and PCR_fo (frequency offset). Fits are restarted at every discontinuity.
+
+Results are reported per window (WindowLength of PCR time): average/min/max bitrate, worst PCR_ac and PCR_oj,
+longest PCR interval, repetition errors (> 40 ms) and discontinuities (signalled by discontinuity_indicator and
+unsignalled jumps > 100 ms - PCR_discontinuity_indicator_error).
+*/
+
+//=============================================================================================================================================================================
+
+struct TS_PcrWindow {
+    uint16_t PID;
+    uint64_t FirstPacket;          //packet index (whole multiplex) of the first PCR in the window
+    uint64_t NumPackets;           //packets of the multiplex covered by the window
+    int64_t StartPCR;              //27 MHz
+    int64_t Duration;              //27 MHz
+    uint32_t NumPCRs;
+    uint32_t NumRepetitionErrors;
+    uint32_t NumDiscontinuities;   //signalled
+    uint32_t NumDiscontinuityErrors; //unsignalled
+    double Bitrate;                //bit/s, average over the window
+    double MinBitrate;             //bit/s, between consecutive PCRs
+    double MaxBitrate;
+    double MaxInterval_ms;
+    double MaxAccuracy_ns;         //max |PCR_ac|
+    double MaxOverallJitter_ns;    //max |PCR_oj|, 0 without arrival times
+    double FrequencyOffset_ppm;    //PCR_fo at the end of the window, 0 without arrival times
+};
+
+//=============================================================================================================================================================================
+
+class TS_PcrAnalyzer {
+public:
+    static constexpr int64_t PCR_Period = ((int64_t) 1 << 33) * TS::BaseToExtendedClockMultiplier;
+    static constexpr int64_t MaxRepetitionInterval = 40 * (int64_t) TS::ExtendedClockFrequency_kHz; //40 ms
+    static constexpr int64_t MaxDiscontinuity = 100 * (int64_t) TS::ExtendedClockFrequency_kHz;     //100 ms
+    static constexpr int64_t DefaultWindowLength = TS::ExtendedClockFrequency_Hz;                   //1 s
+
+protected:
+    //numerically stable running least squares (Welford)
+    struct xLinearFit {
+        uint64_t N = 0;
+        double MeanX = 0, MeanY = 0, Cxx = 0, Cxy = 0;
+
+        void Reset() { *this = xLinearFit(); }
+
+        void Add(double X, double Y) {
+            N++;
+            const double DX = X - MeanX;
+            MeanX += DX / N;
+            MeanY += (Y - MeanY) / N;
+            Cxx += DX * (X - MeanX);
+            Cxy += DX * (Y - MeanY);
+        }
+
+        bool isValid() const { return N >= 2 && Cxx > 0; }
+
+        double getSlope() const { return Cxy / Cxx; }
+
+        double getResidual(double X, double Y) const { return Y - (MeanY + getSlope() * (X - MeanX)); }
+    };
+
+    uint16_t m_PID;
+    uint32_t m_PacketSize;
+    int64_t m_WindowLength;
+
+//last PCR
+    int64_t m_LastPCR = NOT_VALID;
+    uint64_t m_LastPacket = 0;
+
+//segment between discontinuities - positions relative to the first PCR of the segment
+    int64_t m_SegmentPCR = 0;           //PCR at the segment start
+    int64_t m_SegmentElapsed = 0;       //27 MHz since segment start
+    uint64_t m_SegmentPacket = 0;
+    int64_t m_SegmentArrival = NOT_VALID;
+    xLinearFit m_RateFit;               //PCR ticks over bytes
+    xLinearFit m_ClockFit;              //arrival ns over PCR ns
+
+//current window
+    TS_PcrWindow m_Current;
+    int64_t m_WindowStartElapsed = 0;
+    TS_PcrWindow m_Window;              //last completed
+
+//totals
+    uint64_t m_NumPCRs = 0;
+    uint64_t m_NumRepetitionErrors = 0;
+    uint64_t m_NumDiscontinuities = 0;
+    uint64_t m_NumDiscontinuityErrors = 0;
+
+public:
+    TS_PcrAnalyzer(uint16_t PID, int64_t WindowLength = DefaultWindowLength,
+                   uint32_t PacketSize = TS::TS_PacketLength);
+
+    //PacketIndex counts all packets of the multiplex, ArrivalTime_ns - NOT_VALID if unknown
+    //returns true if a window was completed (see getWindow)
+    bool AbsorbPCR(uint64_t PacketIndex, int64_t PCR, bool Discontinuity, int64_t ArrivalTime_ns = NOT_VALID);
+
+    //closes the current window (end of stream), returns false if it was empty
+    bool Finish();
+
+    const TS_PcrWindow &getWindow() const { return m_Window; }
+
+    uint16_t getPID() const { return m_PID; }
+
+    //long-term transport rate of the current segment (bit/s), 0 until known
+    double getBitrate() const;
+
+    uint64_t getNumPCRs() const { return m_NumPCRs; }
+
+    uint64_t getNumRepetitionErrors() const { return m_NumRepetitionErrors; }
+
+    uint64_t getNumDiscontinuities() const { return m_NumDiscontinuities; }
+
+    uint64_t getNumDiscontinuityErrors() const { return m_NumDiscontinuityErrors; }
+
+protected:
+    void xStartSegment(uint64_t PacketIndex, int64_t PCR, int64_t ArrivalTime_ns);
+
+    void xStartWindow(uint64_t PacketIndex, int64_t PCR);
+
+    //EndPacket - packet index of the last PCR belonging to the window
+    bool xCloseWindow(uint64_t EndPacket);
+};
+
+//=============================================================================================================================================================================
+
+class TS_TimingEngine {
+protected:
+    std::unique_ptr<TS_PcrAnalyzer> m_Analyzers[TS_Demuxer::NumPIDs];
+    int64_t m_WindowLength;
+    uint32_t m_PacketSize;
+    uint64_t m_NumPackets = 0;
+
+public:
+    TS_TimingEngine(int64_t WindowLength = TS_PcrAnalyzer::DefaultWindowLength,
+                    uint32_t PacketSize = TS::TS_PacketLength)
+            : m_WindowLength(WindowLength), m_PacketSize(PacketSize) {};
+
+    virtual ~TS_TimingEngine() {};
+
+    //every packet of the multiplex has to pass here (packet count is the byte clock)
+    void AbsorbPacket(const TS_PacketHeader &PacketHeader, const TS_AdaptationField *AdaptationField,
+                      int64_t ArrivalTime_ns = NOT_VALID) {
+        if (AdaptationField && AdaptationField->getPCR()) {
+            TS_PcrAnalyzer &Analyzer = xGetAnalyzer(PacketHeader.getPID());
+            if (Analyzer.AbsorbPCR(m_NumPackets, AdaptationField->getPCR_data(), AdaptationField->getDC(),
+                                   ArrivalTime_ns))
+                xWindowCompleted(Analyzer.getWindow());
+        }
+        m_NumPackets++;
+    }
+
+    //reports windows still open
+    void Finish();
+
+    //nullptr if no PCR was seen on PID
+    const TS_PcrAnalyzer *getAnalyzer(uint16_t PID) const { return m_Analyzers[PID & (TS_Demuxer::NumPIDs - 1)].get(); }
+
+    uint64_t getNumPackets() const { return m_NumPackets; }
+
+protected:
+    TS_PcrAnalyzer &xGetAnalyzer(uint16_t PID);
+
+    virtual void xWindowCompleted(const TS_PcrWindow &) {};
+};
+
+//=============================================================================================================================================================================
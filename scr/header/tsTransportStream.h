@@ -1,7 +1,12 @@
 #pragma once
 
 #include "tsCommon.h"
+#include "tsOutputSink.h"
+#include "tsFieldLayout.h"
+#include "tsMemoryBudget.h"
+#include "tsStatsHooks.h"
 #include <string>
+#include <vector>
 #include <iostream>
 #include <fstream>
 
@@ -42,6 +47,9 @@ Continuity counter           (CC ) :  4 bits
 class TS {
 public:
     static constexpr uint32_t TS_PacketLength = 188;
+    static constexpr uint32_t M2TS_PacketLength = 192; //4-byte timestamp + TS packet
+    static constexpr uint32_t RS_PacketLength = 204; //TS packet + 16 bytes of Reed-Solomon parity
+    static constexpr uint8_t TS_SyncByte = 0x47;
     static constexpr uint32_t TS_HeaderLength = 4;
     static constexpr uint32_t PES_HeaderLength = 6;
     static constexpr uint32_t BaseClockFrequency_Hz = 90000; //Hz
@@ -66,28 +74,29 @@ public:
     };
 
 protected:
-    uint8_t sync_byte;
-    bool transport_error_indicator;
-    bool payload_unit_start_indicator;
-    bool transport_priority;
-    uint16_t PID;
-    uint8_t transport_scrambling_control;
-    uint8_t adaptation_field_control;
-    uint8_t continuity_counter;
+    uint8_t sync_byte = 0;
+    bool transport_error_indicator = false;
+    bool payload_unit_start_indicator = false;
+    bool transport_priority = false;
+    uint16_t PID = 0;
+    uint8_t transport_scrambling_control = 0;
+    uint8_t adaptation_field_control = 0;
+    uint8_t continuity_counter = 0;
 
 public:
 //Packt Header Parser
     void Parse(const uint8_t *Input) {
-        uint32_t header = _byteswap_ulong(*((uint32_t *) Input));
-
-        sync_byte = (header & 0xFF000000) >> 24;    //8bits
-        transport_error_indicator = (header & 0x00800000) >> 23;  //1bit
-        payload_unit_start_indicator = (header & 0x00400000) >> 22; //1bit
-        transport_priority = (header & 0x00200000) >> 21; //1bit
-        PID = (header & 0x001FFF00) >> 8;    //13 bits
-        transport_scrambling_control = (header & 0x000000C0) >> 6;    //2 bits
-        adaptation_field_control = (header & 0x00000030) >> 4;    //2 bits
-        continuity_counter = (header & 0x00000000F);        //4 bits
+        using L = TS_HeaderLayout;
+        const uint64_t header = L::Word::Load(Input);
+
+        sync_byte = (uint8_t) L::SyncByte::Extract<L::Word>(header);    //8bits
+        transport_error_indicator = L::TransportErrorIndicator::Extract<L::Word>(header);  //1bit
+        payload_unit_start_indicator = L::PayloadUnitStartIndicator::Extract<L::Word>(header); //1bit
+        transport_priority = L::TransportPriority::Extract<L::Word>(header); //1bit
+        PID = (uint16_t) L::PID::Extract<L::Word>(header);    //13 bits
+        transport_scrambling_control = (uint8_t) L::TransportScramblingControl::Extract<L::Word>(header);    //2 bits
+        adaptation_field_control = (uint8_t) L::AdaptationFieldControl::Extract<L::Word>(header);    //2 bits
+        continuity_counter = (uint8_t) L::ContinuityCounter::Extract<L::Word>(header);        //4 bits
     }
 
 //Pinter
@@ -141,48 +150,45 @@ public:
 
 class TS_AdaptationField {
 protected:
-    uint8_t AFLength;
-    bool discontinuity_indicator;
-    bool random_access_indicator;
-    bool stream_priority_indicator;
-    bool PCR;
-    bool OPCR;
-    bool SP;
-    bool TPD;
-    bool AFExt;
-    long long int PCR_data;
-    long long int OPCR_data;
-    double Time;
-    int Stuffing;
+    uint8_t AFLength = 0;
+    bool discontinuity_indicator = false;
+    bool random_access_indicator = false;
+    bool stream_priority_indicator = false;
+    bool PCR = false;
+    bool OPCR = false;
+    bool SP = false;
+    bool TPD = false;
+    bool AFExt = false;
+    long long int PCR_data = 0;
+    long long int OPCR_data = 0;
+    int Stuffing = 0;
 
 public:
 //Adaptation Field Parser
     void Parse(const uint8_t *Input) {
-        AFLength = Input[4];
-        Stuffing = AFLength - 1;
-        discontinuity_indicator = (Input[5] & 0x80) >> 7;
-        random_access_indicator = (Input[5] & 0x40) >> 6;
-        stream_priority_indicator = (Input[5] & 0x20) >> 5;
-        PCR = (Input[5] & 0x10) >> 4;
-        OPCR = (Input[5] & 0x08) >> 3;
-        SP = (Input[5] & 0x04) >> 2;
-        TPD = (Input[5] & 0x02) >> 1;
-        AFExt = (Input[5] & 0x01);
-        if (getPCR()) {
-            uint64_t tmp = xSwapBytes64(*((uint64_t *) &Input[6]));
-            uint64_t basic = (tmp & 0xFFFFFFFF80000000) >> 31;
-            uint64_t extension = (tmp & 0x1FF0000) >> 16;
-            PCR_data = basic * 300 + extension;
-            Time = PCR_data / static_cast<long double>(TS::ExtendedClockFrequency_Hz);
-            Stuffing -= 6;
-        }
-        if (getOPCR()) {
-            uint64_t tmp = xSwapBytes64(*((uint64_t *) &Input[6 + getPCR() * 6]));
-            OPCR_data = (tmp & 0xFFFFFFFFFFFF0000) >> 16;
-            Stuffing -= 6;
-        }
-
-
+        using L = TS_AdaptationFieldLayout;
+        const uint64_t Word = L::Word::Load(Input);
+        AFLength = (uint8_t) L::Length::Extract<L::Word>(Word);
+        //empty adaptation field (single stuffing byte) has no flags byte
+        const uint64_t Flags = AFLength ? Word : 0;
+        discontinuity_indicator = L::DiscontinuityIndicator::Extract<L::Word>(Flags);
+        random_access_indicator = L::RandomAccessIndicator::Extract<L::Word>(Flags);
+        stream_priority_indicator = L::ElementaryStreamPriorityIndicator::Extract<L::Word>(Flags);
+        //a flag is only honoured when adaptation_field_length covers its clock reference
+        PCR = L::PCR_Flag::Extract<L::Word>(Flags) && AFLength >= L::MinLengthWithPCR;
+        OPCR = L::OPCR_Flag::Extract<L::Word>(Flags) &&
+               AFLength >= L::MinLengthWithPCR + PCR * TS_ClockReferenceLayout::Length;
+        SP = L::SplicingPointFlag::Extract<L::Word>(Flags);
+        TPD = L::TransportPrivateDataFlag::Extract<L::Word>(Flags);
+        AFExt = L::ExtensionFlag::Extract<L::Word>(Flags);
+        //both clock references lie inside the packet - decoded unconditionally, flags select (previous values kept)
+        const long long int PCR_value = (long long int) TS_ClockReferenceLayout::Decode(Input + L::PCR_Offset);
+        const long long int OPCR_value = (long long int) TS_ClockReferenceLayout::Decode(
+                Input + L::PCR_Offset + PCR * TS_ClockReferenceLayout::Length);
+        PCR_data = PCR ? PCR_value : PCR_data;
+        OPCR_data = OPCR ? OPCR_value : OPCR_data;
+        //never negative - the flags above only survive when AFLength covers their clock references
+        Stuffing = (AFLength ? AFLength - 1 : 0) - (int) (PCR + OPCR) * (int) TS_ClockReferenceLayout::Length;
     }
 
 //Get value
@@ -204,11 +210,13 @@ public:
 
     bool getAFExt() const { return AFExt; }
 
-    int getPCR_data() const { return PCR_data; }
+    long long int getPCR_data() const { return PCR_data; }
 
-    int getOPCR_data() const { return OPCR_data; }
+    long long int getOPCR_data() const { return OPCR_data; }
 
-    double getTime() const { return static_cast<double>(Time); }
+    double getTime() const {
+        return static_cast<double>(PCR_data / static_cast<long double>(TS::ExtendedClockFrequency_Hz));
+    }
 
     int getStuffing() const { return Stuffing; }
 
@@ -262,73 +270,65 @@ public:
     };
 protected:
 //PES packet header
-    uint32_t m_PacketStartCodePrefix;
-    uint8_t m_StreamId;
-    uint16_t m_PacketLength;
-    uint8_t m_HeaderLenght;
-    uint8_t m_Header_Data_Lenght;
+    uint32_t m_PacketStartCodePrefix = 0;
+    uint8_t m_StreamId = 0;
+    uint16_t m_PacketLength = 0;
+    uint16_t m_HeaderLenght = 0; //up to 9 + 255
+    uint8_t m_Header_Data_Lenght = 0;
     bool PTS_Flag = false;
     bool DTS_Flag = false;
-    uint64_t PTS;
-    uint64_t DTS;
+    uint64_t PTS = 0;
+    uint64_t DTS = 0;
 public:
     void Reset();
 
-    int32_t Parse(const uint8_t *Packet) {
-        uint64_t tmp = xSwapBytes64(*((uint64_t *) &Packet[0]));
-        m_PacketStartCodePrefix = (tmp & 0xFFFFFF0000000000) >> 40;
-        m_StreamId = (tmp & 0x000000FF00000000) >> 32;
-        m_PacketLength = (tmp & 0x00000000FFFF0000) >> 16;
-        m_HeaderLenght = 6;
-        if (m_StreamId != eStreamId::eStreamId_program_stream_map,
-                m_StreamId != eStreamId::eStreamId_padding_stream,
-                m_StreamId != eStreamId::eStreamId_private_stream_2,
-                m_StreamId != eStreamId::eStreamId_ECM,
-                m_StreamId != eStreamId::eStreamId_EMM,
-                m_StreamId != eStreamId::eStreamId_program_stream_directory,
-                m_StreamId != eStreamId::eStreamId_DSMCC_stream,
-                m_StreamId != eStreamId::eStreamId_ITUT_H222_1_type_E) {
-            m_Header_Data_Lenght = Packet[6 + 2];
-            m_HeaderLenght += 3 + m_Header_Data_Lenght;
-            uint8_t PTSDTSFlag = (Packet[6 + 1] & 0xC0) >> 6;
-            switch (PTSDTSFlag) {
-                case 0: {
-                    PTS = 0;
-                    DTS = 0;
-                }
-                    break;
-                case 1:
-                    break;
-                case 2: {
-                    uint64_t tmp1 = xSwapBytes64(*((uint64_t *) &Packet[+6 + 3]));
-                    tmp1 = tmp1 >> 24;
-                    uint64_t tmp2 = (tmp1 & 0xE00000000) >> 3;
-                    int64_t tmp3 = (tmp1 & 0xFFFE0000) >> 2;
-                    int64_t tmp4 = (tmp1 & 0xFFFE) >> 1;
-                    PTS = (tmp2 | tmp3 | tmp4);
-                    PTS_Flag = true;
-                }
-                    break;
-                case 3: {
-                    uint64_t tmp1 = xSwapBytes64(*((uint64_t *) &Packet[6 + 3]));
-                    tmp1 = tmp1 >> 24;
-                    uint64_t tmp2 = (tmp1 & 0xE00000000) >> 3;
-                    int64_t tmp3 = (tmp1 & 0xFFFE0000) >> 2;
-                    int64_t tmp4 = (tmp1 & 0xFFFE) >> 1;
-                    PTS = (tmp2 | tmp3 | tmp4);
-                    PTS_Flag = true;
-
-                    tmp1 = xSwapBytes64(*((uint64_t *) &Packet[6 + 3 + 5]));
-                    tmp1 = tmp1 >> 24;
-                    tmp2 = (tmp1 & 0xE00000000) >> 3;
-                    tmp3 = (tmp1 & 0xFFFE0000) >> 2;
-                    tmp4 = (tmp1 & 0xFFFE) >> 1;
-                    DTS = (tmp2 | tmp3 | tmp4);
-                    DTS_Flag = true;
-                }
-                    break;
-            }
+    //stream_id values without the optional PES header (PTS_DTS_flags, PES_header_data_length, ...)
+    static bool hasOptionalHeader(uint8_t StreamId) {
+        return StreamId != eStreamId::eStreamId_program_stream_map &&
+               StreamId != eStreamId::eStreamId_padding_stream &&
+               StreamId != eStreamId::eStreamId_private_stream_2 &&
+               StreamId != eStreamId::eStreamId_ECM &&
+               StreamId != eStreamId::eStreamId_EMM &&
+               StreamId != eStreamId::eStreamId_program_stream_directory &&
+               StreamId != eStreamId::eStreamId_DSMCC_stream &&
+               StreamId != eStreamId::eStreamId_ITUT_H222_1_type_E;
+    }
+
+    //Size - bytes available at Data, NOT_VALID if the header is cut (fields which do not fit are left 0)
+    int32_t Parse(const uint8_t *Data, uint32_t Size) {
+        using L = PES_HeaderLayout;
+        m_HeaderLenght = TS::PES_HeaderLength;
+        m_Header_Data_Lenght = 0;
+        PTS_Flag = false;
+        DTS_Flag = false;
+        PTS = 0;
+        DTS = 0;
+        if (Size < L::Word::End) {
+            m_PacketStartCodePrefix = 0;
+            m_StreamId = 0;
+            m_PacketLength = 0;
+            return NOT_VALID;
         }
+        const uint64_t Word = L::Word::Load(Data);
+        m_PacketStartCodePrefix = (uint32_t) L::PacketStartCodePrefix::Extract<L::Word>(Word);
+        m_StreamId = (uint8_t) L::StreamId::Extract<L::Word>(Word);
+        m_PacketLength = (uint16_t) L::PacketLength::Extract<L::Word>(Word);
+        if (!hasOptionalHeader(m_StreamId)) return 0;
+
+        if (Size < L::OptionalWord::End) return NOT_VALID;
+        const uint64_t Optional = L::OptionalWord::Load(Data);
+        m_Header_Data_Lenght = (uint8_t) L::HeaderDataLength::Extract<L::OptionalWord>(Optional);
+        m_HeaderLenght += 3 + m_Header_Data_Lenght;
+        //'10' - PTS, '11' - PTS and DTS, '01' is forbidden
+        const uint32_t PTSDTSFlag = (uint32_t) L::PTS_DTS_Flags::Extract<L::OptionalWord>(Optional);
+        if (!(PTSDTSFlag & 2)) return 0;
+        if (Size < L::PTS_Offset + PES_TimestampLayout::Length) return NOT_VALID;
+        PTS = PES_TimestampLayout::Decode(Data + L::PTS_Offset);
+        PTS_Flag = true;
+        if (PTSDTSFlag != 3) return 0;
+        if (Size < L::DTS_Offset + PES_TimestampLayout::Length) return NOT_VALID;
+        DTS = PES_TimestampLayout::Decode(Data + L::DTS_Offset);
+        DTS_Flag = true;
         return 0;
     };
 
@@ -352,7 +352,15 @@ public:
 
     uint16_t getPacketLength() const { return m_PacketLength; }
 
-    uint8_t getHeaderLen() const { return m_HeaderLenght; }
+    uint16_t getHeaderLen() const { return m_HeaderLenght; }
+
+    bool hasPTS() const { return PTS_Flag; }
+
+    bool hasDTS() const { return DTS_Flag; }
+
+    uint64_t getPTS() const { return PTS; }
+
+    uint64_t getDTS() const { return DTS; }
 };
 
 class PES_Assembler {
@@ -363,17 +371,34 @@ public:
         AssemblingStarted,
         AssemblingContinue,
         AssemblingFinished,
+        BufferOverflow, //PES cut by TS_BufferLimits - written out (own output) or left for getPayloadViews()
     };
-    FILE *file;
+    FILE *file = nullptr;
 protected:
 //setup
-//buffer
-    uint8_t *m_Buffer = new uint8_t[0];
-    uint8_t *m_BufferTmp = new uint8_t[0];
+//buffer - grown geometrically and reused across PES packets (reset only rewinds it)
+    uint8_t *m_Buffer = nullptr;
     uint32_t m_DataInBuffor = 0;
-    uint8_t m_HeaderLen;
-    uint32_t m_PacketLen;
+    uint16_t m_HeaderLen = 0;
+    uint32_t m_PacketLen = 0;
     uint32_t m_BufferSize = 0;
+    uint32_t m_BufferCapacity = 0;
+    uint32_t m_NumBufferAllocations = 0;
+
+//limits - payload beyond them is dropped until the next PES, the PES is marked truncated
+    uint32_t m_BufferLimit = 0;
+    TS_MemoryBudget *m_Budget = nullptr;
+    uint32_t m_AppendLimit = UINT32_MAX; //m_BufferLimit (or unlimited), 0 once the PES is truncated
+    bool m_Truncated = false;
+    uint32_t m_NumOverflows = 0;
+    uint64_t m_NumDroppedBytes = 0;
+
+//zero-copy - payload kept as views into packet memory (which has to outlive the PES)
+    bool m_ZeroCopy = false;
+    std::vector<TS_PayloadView> m_Views;
+    uint32_t m_ViewCapacity = 0; //views acquired from m_Budget
+    TS_OutputSink *m_Sink = nullptr;
+    std::vector<TS_PayloadView> m_SinkViews;
 
 //operation
     int8_t m_LastContinuityCounter = 0;
@@ -381,14 +406,57 @@ protected:
     PES_PacketHeader m_PESH;
 public:
     int32_t m_PID;
+    static constexpr uint32_t InitialBufferCapacity = 64 * 1024;
+    static constexpr uint32_t InitialViewCapacity = 64; //zero-copy views (one per packet)
+
     PES_Assembler() {};
 
-    ~PES_Assembler() {};
+    ~PES_Assembler() { xBufferRelease(); };
+
+    PES_Assembler(const PES_Assembler &) = delete;
+
+    PES_Assembler &operator=(const PES_Assembler &) = delete;
+
+    //no output - payload is only accessible through getPayloadViews()
+    void Init(int32_t PID) { m_PID = PID; };
+
+    void Init(int32_t PID, const char *FileName) {
+        m_PID = PID;
+        file = fopen(FileName, "ab");
+    };
 
-    void Init(int32_t PID) {
+    //output goes to Sink instead of file (sink is not owned)
+    void Init(int32_t PID, TS_OutputSink *Sink, bool ZeroCopy = false) {
         m_PID = PID;
-        if (m_PID == 136) file = fopen("pid136.mp2", "ab");
-        else if (m_PID == 174) file = fopen("pid174.264", "ab");
+        m_Sink = Sink;
+        m_ZeroCopy = ZeroCopy;
+    };
+
+    //per-PID cap and shared budget (see tsMemoryBudget.h), a PES being assembled is dropped when the budget changes
+    void setBufferLimits(const TS_BufferLimits &Limits) {
+        if (Limits.Budget != m_Budget) {
+            DropPES();
+            xBufferRelease();
+        }
+        m_BufferLimit = Limits.MaxPesBufferSize;
+        m_Budget = Limits.Budget;
+        if (!m_Truncated) m_AppendLimit = m_BufferLimit ? m_BufferLimit : UINT32_MAX;
+    }
+
+    //abandons the PES being assembled (e.g. after BufferOverflow), buffer memory goes back to the budget
+    void DropPES() {
+        m_Started = false;
+        xBufferReset();
+        if (m_Budget) xBufferRelease();
+    }
+
+    //writes the PES being assembled and closes the output file
+    void Flush() {
+        if (m_Started) write();
+        m_Started = false;
+        if (file) fclose(file);
+        file = nullptr;
+        if (m_Sink) m_Sink->Flush();
     };
 
     eResult AbsorbPacket(const uint8_t *TransportStreamPacket, const TS_PacketHeader *PacketHeader,
@@ -397,35 +465,61 @@ public:
             if (PacketHeader->getPayloadUnitStartIndicator()) {
                 if (m_Started) {
                     m_Started = false;
-                    if (m_PID == 174)
-                        printf(" PES: Previous was Finished of PES, PcktLen=%d HeadLen=%d DataLen=%d ", getBufferSize(),
-                               getHeaderLen(), getBufferSize() - getHeaderLen());
                     write();
                 }
 
                 if (!m_Started) {
                     m_Started = true;
+                    m_LastContinuityCounter = PacketHeader->getContinuityCounter();
+                    m_Truncated = false;
+                    m_AppendLimit = m_BufferLimit ? m_BufferLimit : UINT32_MAX;
                     xBufferReset();
                     if (PacketHeader->getAdaptationFieldControl() == 1)
                         xBufferAppend(TransportStreamPacket, TS::TS_HeaderLength);
                     if (PacketHeader->getAdaptationFieldControl() == 3 and AdaptationField->getAFLength() < 183)
                         xBufferAppend(TransportStreamPacket, TS::TS_HeaderLength +
                                                              1 + AdaptationField->getAFLength());
-                    m_PESH.Parse(m_Buffer);
+                    //not even the first packet fits - nothing to output, the whole PES is dropped
+                    if (m_Truncated) {
+                        m_NumOverflows++;
+                        DropPES();
+                        return eResult::BufferOverflow;
+                    }
+                    const uint8_t *PES = m_ZeroCopy ? (m_Views.empty() ? nullptr : m_Views[0].Data) : m_Buffer;
+                    const uint32_t PESSize = m_ZeroCopy ? (m_Views.empty() ? 0 : m_Views[0].Size) : m_DataInBuffor;
+                    if (PES) m_PESH.Parse(PES, PESSize);
                     m_HeaderLen = m_PESH.getHeaderLen();
                     m_PacketLen = m_PESH.getPacketLength();
+                    TS_STATS_PES(m_PID);
                     return eResult::AssemblingStarted;
                 }
             } else {
+                //no PES being assembled (before the first PUSI, after a loss or an overflow) - payload is dropped
+                if (!m_Started) return eResult::AssemblingContinue;
+                if (PacketHeader->getAdaptationFieldControl() & 1) {
+                    const uint8_t CC = PacketHeader->getContinuityCounter();
+                    //duplicate packet - payload was already taken
+                    if (CC == m_LastContinuityCounter) return eResult::AssemblingContinue;
+                    const bool Discontinuity = PacketHeader->hasAdaptationField() && AdaptationField->getDC();
+                    if (CC != ((m_LastContinuityCounter + 1) & 0xF) && !Discontinuity) {
+                        //PES with a hole is useless - dropped, next PUSI starts over
+                        m_Started = false;
+                        xBufferReset();
+                        return eResult::StreamPackedLost;
+                    }
+                    m_LastContinuityCounter = CC;
+                }
+                const bool Truncated = m_Truncated;
                 if (PacketHeader->getAdaptationFieldControl() == 1)
                     xBufferAppend(TransportStreamPacket, TS::TS_HeaderLength);
                 if (PacketHeader->getAdaptationFieldControl() == 3 and AdaptationField->getAFLength() < 183) {
                     xBufferAppend(TransportStreamPacket, TS::TS_HeaderLength +
                                                          1 + AdaptationField->getAFLength());
                 }
-                if ((m_PID == 136) and ((m_PacketLen + 6 - m_HeaderLen) == (getBufferSize() - getHeaderLen())))
+                if (m_Truncated != Truncated) return xOverflow();
+                //PES_packet_length known (0 - unbounded video PES) - PES ends with its last byte
+                if (m_PacketLen != 0 && getBufferSize() >= m_PacketLen + TS::PES_HeaderLength)
                     return eResult::AssemblingFinished;
-                m_LastContinuityCounter++;
                 return eResult::AssemblingContinue;
             }
         } else return eResult::UnexpectedPID;
@@ -434,29 +528,142 @@ public:
 
     void PrintPESH() const { m_PESH.Print(); }
 
-    int8_t getHeaderLen() const { return m_HeaderLen; }
+    const PES_PacketHeader &getPESH() const { return m_PESH; }
+
+    uint16_t getHeaderLen() const { return m_HeaderLen; }
 
     uint32_t getBufferSize() const { return m_BufferSize; }
 
-    void write() { fwrite(m_Buffer + m_HeaderLen, m_DataInBuffor - m_HeaderLen, 1, file); }
+    uint32_t getBufferCapacity() const { return m_BufferCapacity; }
+
+    bool isStarted() const { return m_Started; }
+
+    //number of heap allocations done by the buffer since construction (stays constant in steady state)
+    uint32_t getNumBufferAllocations() const { return m_NumBufferAllocations; }
+
+    //current PES lost payload to the buffer limits
+    bool isTruncated() const { return m_Truncated; }
+
+    uint32_t getNumOverflows() const { return m_NumOverflows; }
+
+    //payload bytes dropped by the buffer limits
+    uint64_t getNumDroppedBytes() const { return m_NumDroppedBytes; }
+
+    //payload of the current PES (without PES header) as views, valid until the next packet is absorbed
+    uint32_t getPayloadViews(std::vector<TS_PayloadView> &Views) const {
+        Views.clear();
+        if (m_DataInBuffor <= m_HeaderLen) return 0;
+        if (!m_ZeroCopy) {
+            Views.push_back({m_Buffer + m_HeaderLen, m_DataInBuffor - m_HeaderLen});
+            return 1;
+        }
+        uint32_t Skip = m_HeaderLen;
+        for (const TS_PayloadView &View : m_Views) {
+            if (Skip >= View.Size) {
+                Skip -= View.Size;
+                continue;
+            }
+            Views.push_back({View.Data + Skip, View.Size - Skip});
+            Skip = 0;
+        }
+        return (uint32_t) Views.size();
+    }
+
+    void write() {
+        TS_STATS_TIMER(Output);
+        if (m_Sink) {
+            getPayloadViews(m_SinkViews);
+            m_Sink->Write(m_SinkViews.data(), (uint32_t) m_SinkViews.size(), m_ZeroCopy);
+            return;
+        }
+        if (file && m_DataInBuffor > m_HeaderLen) fwrite(m_Buffer + m_HeaderLen, m_DataInBuffor - m_HeaderLen, 1, file);
+    }
 
 protected:
     void xBufferReset() {
         m_BufferSize = 0;
         m_DataInBuffor = 0;
+        m_Views.clear();
+    };
+
+    //false if the budget does not allow the growth
+    bool xBufferReserve(uint32_t Capacity) {
+        if (Capacity <= m_BufferCapacity) return true;
+        uint32_t NewCapacity = m_BufferCapacity ? m_BufferCapacity : InitialBufferCapacity;
+        while (NewCapacity < Capacity) NewCapacity *= 2;
+        if (m_BufferLimit && NewCapacity > m_BufferLimit)
+            NewCapacity = Capacity > m_BufferLimit ? Capacity : m_BufferLimit;
+        //budget nearly used up - exact growth instead of doubling
+        if (m_Budget && !m_Budget->Acquire(NewCapacity - m_BufferCapacity)) {
+            if (NewCapacity == Capacity || !m_Budget->Acquire(Capacity - m_BufferCapacity)) return false;
+            NewCapacity = Capacity;
+        }
+        uint8_t *NewBuffer = new uint8_t[NewCapacity];
+        if (m_Buffer) copy(m_Buffer, m_Buffer + m_DataInBuffor, NewBuffer);
         delete[] m_Buffer;
-        m_Buffer = new uint8_t[0];
+        m_Buffer = NewBuffer;
+        m_BufferCapacity = NewCapacity;
+        m_NumBufferAllocations++;
+        TS_STATS_ALLOCATION();
+        return true;
     };
 
-    void xBufferAppend(const uint8_t *Data, int32_t Size) {
+    //zero-copy: view storage is charged to the budget like the buffer (small, but grows with the PES)
+    bool xViewsReserve(uint32_t Capacity) {
+        if (Capacity <= m_ViewCapacity) return true;
+        uint32_t NewCapacity = m_ViewCapacity ? m_ViewCapacity * 2 : InitialViewCapacity;
+        while (NewCapacity < Capacity) NewCapacity *= 2;
+        if (m_Budget && !m_Budget->Acquire((uint64_t) (NewCapacity - m_ViewCapacity) * sizeof(TS_PayloadView))) {
+            if (NewCapacity == Capacity ||
+                !m_Budget->Acquire((uint64_t) (Capacity - m_ViewCapacity) * sizeof(TS_PayloadView))) return false;
+            NewCapacity = Capacity;
+        }
+        m_Views.reserve(NewCapacity);
+        m_ViewCapacity = NewCapacity;
+        return true;
+    }
 
-        m_BufferSize += TS::TS_PacketLength - Size;
-        m_BufferTmp = new uint8_t[m_BufferSize];
-        copy(m_Buffer, m_Buffer + m_DataInBuffor, m_BufferTmp);
+    void xBufferRelease() {
         delete[] m_Buffer;
-        m_Buffer = m_BufferTmp;
+        if (m_Budget) m_Budget->Release(m_BufferCapacity + (uint64_t) m_ViewCapacity * sizeof(TS_PayloadView));
+        m_Buffer = nullptr;
+        m_BufferCapacity = 0;
+        m_DataInBuffor = 0;
+        std::vector<TS_PayloadView>().swap(m_Views);
+        m_ViewCapacity = 0;
+    }
+
+    void xTruncate(uint32_t Len) {
+        m_Truncated = true;
+        m_AppendLimit = 0;
+        m_NumDroppedBytes += Len;
+    }
+
+    eResult xOverflow() {
+        m_NumOverflows++;
+        //own output - partial PES goes out now and its memory is returned
+        if (file || m_Sink) {
+            write();
+            DropPES();
+        }
+        return eResult::BufferOverflow;
+    }
+
+    void xBufferAppend(const uint8_t *Data, int32_t Size) {
+        const uint32_t Len = TS::TS_PacketLength - Size;
+        //single compare covers the per-PID cap and an already truncated PES
+        if (m_BufferSize + Len > m_AppendLimit) return xTruncate(Len);
+        if (m_ZeroCopy) {
+            if (!xViewsReserve((uint32_t) m_Views.size() + 1)) return xTruncate(Len);
+            m_Views.push_back({Data + Size, Len});
+            m_DataInBuffor += Len;
+            m_BufferSize += Len;
+            return;
+        }
+        if (!xBufferReserve(m_DataInBuffor + Len)) return xTruncate(Len);
         copy(Data + Size, Data + TS::TS_PacketLength, m_Buffer + m_DataInBuffor);
-        m_DataInBuffor += TS::TS_PacketLength - Size;
+        m_DataInBuffor += Len;
+        m_BufferSize += Len;
     };
 };
 //=============================================================================================================================================================================
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsPacketSource.h"
+#include <atomic>
+#include <vector>
+
+/*
+Live UDP / RTP packet source (IPv4 unicast or multicast).
+Datagrams carry either raw TS (usually 7 packets) or RTP with TS payload (detected per datagram: RTP version 2 and
+no sync byte in front). On Linux many datagrams are received per system call with recvmmsg(). Every datagram gets a
+receive timestamp (kernel SO_TIMESTAMPNS if available), getTimestamps() holds one per packet of the last span.
+*/
+
+//=============================================================================================================================================================================
+
+class TS_UdpPacketSource : public TS_PacketSource {
+public:
+    static constexpr uint32_t DatagramSize = 2048;
+    static constexpr uint32_t DefaultSocketBufferSize = 16 * 1024 * 1024;
+    static constexpr uint32_t TimeoutCheck_ms = 100; //granularity of Stop() and idle timeout checks
+
+protected:
+    int m_Socket = NOT_VALID;
+    uint32_t m_NumDatagrams;
+    std::vector<uint8_t> m_Datagrams;    //m_NumDatagrams x DatagramSize
+    std::vector<uint64_t> m_DatagramTimes;
+    std::vector<uint32_t> m_DatagramSizes;
+    std::vector<uint8_t> m_Buffer;       //packets of the current span
+    std::vector<uint64_t> m_Timestamps;  //per packet of the current span
+    std::atomic<bool> m_Stop{false};
+    uint32_t m_IdleTimeout_ms = 0;
+
+//statistics
+    uint64_t m_NumDatagramsReceived = 0;
+    uint64_t m_NumSystemCalls = 0;
+    uint64_t m_NumRtpDatagrams = 0;
+    uint64_t m_NumRtpLost = 0;
+    uint64_t m_NumRtpLate = 0;
+    int32_t m_LastRtpSequence = NOT_VALID;
+
+public:
+    //Address - local unicast address or multicast group to join, Interface - local interface address for multicast
+    TS_UdpPacketSource(const char *Address, uint16_t Port, const char *Interface = nullptr,
+                       uint32_t BatchSize = DefaultBatchSize, uint32_t SocketBufferSize = DefaultSocketBufferSize);
+
+    ~TS_UdpPacketSource() override;
+
+    //blocks until at least one datagram arrived, returns 0 after Stop() or idle timeout (non-blocking mode: returns 0
+    //with isPending() when nothing was received, idle timeout is not applied)
+    uint32_t ReadBatch(TS_PacketSpan &Span) override;
+
+    int getPollDescriptor() const override { return m_Socket; }
+
+    //can be called from any thread
+    void Stop() { m_Stop = true; }
+
+    //ReadBatch returns 0 when nothing was received for given time (0 - wait forever)
+    void setIdleTimeout(uint32_t Timeout_ms) { m_IdleTimeout_ms = Timeout_ms; }
+
+    //receive times (ns, CLOCK_REALTIME) of packets of the last span
+    const uint64_t *getTimestamps() const { return m_Timestamps.data(); }
+
+    uint64_t getNumDatagrams() const { return m_NumDatagramsReceived; }
+
+    uint64_t getNumSystemCalls() const { return m_NumSystemCalls; }
+
+    uint64_t getNumRtpDatagrams() const { return m_NumRtpDatagrams; }
+
+    //sequence numbers skipped by forward jumps - a reordered datagram is counted here and again in getNumRtpLate()
+    uint64_t getNumRtpLost() const { return m_NumRtpLost; }
+
+    //datagrams with a sequence number at or behind the last one (reordered or duplicate)
+    uint64_t getNumRtpLate() const { return m_NumRtpLate; }
+
+    //local port the socket is bound to (useful with Port 0)
+    uint16_t getLocalPort() const;
+
+protected:
+    //receives up to m_NumDatagrams datagrams, returns their count (0 on timeout, -1 on error)
+    int32_t xReceive();
+
+    void xProcessDatagram(const uint8_t *Data, uint32_t Size, uint64_t Timestamp, uint32_t &NumPackets);
+};
+
+//=============================================================================================================================================================================
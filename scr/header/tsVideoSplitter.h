@@ -0,0 +1,203 @@
+#pragma once
+
+#include "tsCommon.h"
+#include "tsTransportStream.h"
+#include "tsOutputSink.h"
+#include <deque>
+#include <vector>
+
+/*
+Access unit splitter for H.264 / HEVC elementary streams - optional stage after PES_Assembler (e.g. fed from
+TS_Visitor::onPesComplete).
+
+Payload of consecutive PES packets is appended to one buffer and scanned for Annex B start codes (00 00 01).
+TS_StartCodeScanner compares 16 (SSE2) or 32 (AVX2, selected at run time) positions per iteration, the scalar
+kernel is used for tails and other platforms. Every complete NAL unit is classified (type, slice type, first slice
+of picture) and access unit boundaries are detected as in H.264 7.4.1.2.3 / HEVC 7.4.2.4.4: AUD, parameter sets,
+prefix SEI or the first slice of a new picture following a picture. Start codes and NAL units may span PES packets.
+
+Access units are reported through xAccessUnit with their Annex B bytes (contiguous, valid only during the call),
+keyframe flag (IDR / IRAP), slice type and timestamps of the PES packet in which the access unit starts.
+
+  +-----+-----+-----+-------+-------+-----+-------+-------+-----
+  | AUD | SPS | PPS | IDR 0 | IDR 1 | AUD | P 0   | P 1   | AUD ...
+  +-----+-----+-----+-------+-------+-----+-------+-------+-----
+  |<--------- access unit (keyframe) ------>|<- access unit ->|
+*/
+
+//=============================================================================================================================================================================
+
+class TS_StartCodeScanner {
+public:
+    enum class eKernel : int32_t {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+protected:
+    eKernel m_Kernel;
+
+public:
+    TS_StartCodeScanner();
+
+    //position of the first 00 00 01 starting in <Begin, End), End if there is none (all three bytes have to be in range)
+    uint64_t Find(const uint8_t *Data, uint64_t Begin, uint64_t End) const;
+
+    eKernel getKernel() const { return m_Kernel; }
+
+    //forces a kernel (e.g. for comparisons), returns false if it is not supported by this CPU/build
+    bool setKernel(eKernel Kernel);
+
+    static bool isKernelSupported(eKernel Kernel);
+
+protected:
+    static uint64_t xFindScalar(const uint8_t *Data, uint64_t Begin, uint64_t End);
+
+    static uint64_t xFindSSE2(const uint8_t *Data, uint64_t Begin, uint64_t End);
+
+    static uint64_t xFindAVX2(const uint8_t *Data, uint64_t Begin, uint64_t End);
+};
+
+//=============================================================================================================================================================================
+
+struct TS_AccessUnit {
+    enum class eSliceType : int8_t {
+        Unknown = NOT_VALID,
+        P = 0,
+        B = 1,
+        I = 2,
+    };
+
+    const uint8_t *Data;   //Annex B bytes including start codes, valid only during xAccessUnit
+    uint32_t Size;
+    uint32_t NumNALs;
+    uint64_t Number;
+    uint64_t NalTypes;     //bit per NAL unit type present
+    int64_t PTS;           //90 kHz, NOT_VALID if the access unit does not start in a PES packet carrying PTS
+    int64_t DTS;           //equal to PTS if not signalled
+    eSliceType SliceType;  //H.264 - B if any slice is B, else P if any slice is P, HEVC - first slice segment
+    bool Keyframe;         //IDR (H.264), IRAP (HEVC)
+
+    bool hasNAL(uint8_t Type) const { return (NalTypes >> (Type & 63)) & 1; }
+};
+
+//=============================================================================================================================================================================
+
+class TS_AccessUnitSplitter {
+public:
+    enum class eCodec : int32_t {
+        H264,
+        HEVC,
+    };
+
+    //H.264 nal_unit_type
+    enum eNalH264 : uint8_t {
+        eNalH264_Slice = 1,
+        eNalH264_IDR = 5,
+        eNalH264_SEI = 6,
+        eNalH264_SPS = 7,
+        eNalH264_PPS = 8,
+        eNalH264_AUD = 9,
+    };
+
+    //HEVC nal_unit_type
+    enum eNalHEVC : uint8_t {
+        eNalHEVC_BLA_W_LP = 16,
+        eNalHEVC_IDR_W_RADL = 19,
+        eNalHEVC_IDR_N_LP = 20,
+        eNalHEVC_CRA = 21,
+        eNalHEVC_IRAP_Last = 23,
+        eNalHEVC_VPS = 32,
+        eNalHEVC_SPS = 33,
+        eNalHEVC_PPS = 34,
+        eNalHEVC_AUD = 35,
+        eNalHEVC_PrefixSEI = 39,
+    };
+
+    struct NalInfo {
+        uint8_t Type;
+        bool VCL;
+        bool FirstSlice;   //first_mb_in_slice == 0 / first_slice_segment_in_pic_flag
+        TS_AccessUnit::eSliceType SliceType;
+    };
+
+protected:
+    //timestamps of a PES packet and position of its first payload byte in m_Buffer
+    struct xTimestamp {
+        uint64_t Pos;
+        int64_t PTS;
+        int64_t DTS;
+    };
+
+    static constexpr uint32_t NumHEVCPPS = 64;
+
+    eCodec m_Codec;
+    TS_StartCodeScanner m_Scanner;
+    std::vector<uint8_t> m_Buffer;
+    uint64_t m_Size = 0;
+    uint64_t m_ScanPos = 0;
+    int64_t m_NalStart = NOT_VALID; //start code of the NAL unit being received
+    std::deque<xTimestamp> m_Timestamps;
+
+//access unit being collected
+    int64_t m_AUStart = NOT_VALID;
+    TS_AccessUnit m_AU;
+    bool m_HasVCL = false;
+
+//HEVC num_extra_slice_header_bits per PPS id (needed to reach slice_type)
+    uint8_t m_ExtraSliceHeaderBits[NumHEVCPPS] = {};
+
+//counters
+    uint64_t m_NumAccessUnits = 0;
+    uint64_t m_NumKeyframes = 0;
+    uint64_t m_NumNALs = 0;
+
+public:
+    TS_AccessUnitSplitter(eCodec Codec);
+
+    virtual ~TS_AccessUnitSplitter() {};
+
+    //payload of one complete PES packet (without PES header)
+    void AbsorbPES(const PES_PacketHeader &PESH, const TS_PayloadView *Views, uint32_t NumViews);
+
+    //reports the last access unit (end of stream)
+    void Finish();
+
+    eCodec getCodec() const { return m_Codec; }
+
+    const TS_StartCodeScanner &getScanner() const { return m_Scanner; }
+
+    TS_StartCodeScanner &getScanner() { return m_Scanner; }
+
+    uint64_t getNumAccessUnits() const { return m_NumAccessUnits; }
+
+    uint64_t getNumKeyframes() const { return m_NumKeyframes; }
+
+    uint64_t getNumNALs() const { return m_NumNALs; }
+
+    //classifies NAL unit (Data points to the NAL header, after start code)
+    bool ClassifyNAL(const uint8_t *Data, uint64_t Size, NalInfo &Info);
+
+    static bool isKeyframe(eCodec Codec, uint8_t NalType);
+
+protected:
+    void xScan(bool EndOfStream);
+
+    //NAL unit <Start, End), Start points to its start code
+    void xAbsorbNAL(uint64_t Start, uint64_t End);
+
+    bool xStartsAccessUnit(const NalInfo &Info) const;
+
+    void xStartAccessUnit(uint64_t Start);
+
+    void xEmitAccessUnit(uint64_t End);
+
+    //drops bytes of already reported access units
+    void xCompact();
+
+    //called for every access unit
+    virtual void xAccessUnit(const TS_AccessUnit &) {};
+};
+
+//=============================================================================================================================================================================
@@ -0,0 +1,126 @@
+#include "tsAsyncReader.h"
+#include <chrono>
+#include <thread>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/epoll.h>
+#define TS_HAS_EPOLL 1
+#else
+#define TS_HAS_EPOLL 0
+#endif
+
+//=============================================================================================================================================================================
+// TS_AsyncReader
+//=============================================================================================================================================================================
+TS_AsyncReader::TS_AsyncReader(uint32_t NumThreads) {
+    m_NumThreads = NumThreads ? NumThreads : 1;
+}
+
+int32_t TS_AsyncReader::AddSource(TS_PacketSource *Source, TS_Demuxer *Demuxer) {
+    std::unique_ptr<Input> I(new Input);
+    I->Source.reset(Source);
+    I->Demuxer = Demuxer;
+    if (Source == nullptr || !Source->isGood()) return NOT_VALID;
+    Source->setNonBlocking(true);
+    I->PollDescriptor = Source->getPollDescriptor();
+    m_Inputs.push_back(std::move(I));
+    return (int32_t) m_Inputs.size() - 1;
+}
+
+int32_t TS_AsyncReader::AddFile(const char *FileName, TS_Demuxer *Demuxer) {
+    return AddSource(TS_PacketSource::Open(FileName).release(), Demuxer);
+}
+
+void TS_AsyncReader::Run() {
+    m_Stop = false;
+    const uint32_t NumThreads = m_NumThreads < m_Inputs.size() ? m_NumThreads : (uint32_t) m_Inputs.size();
+    std::vector<std::thread> Threads;
+    for (uint32_t t = 0; t < NumThreads; t++) Threads.emplace_back(&TS_AsyncReader::xLoop, this, t);
+    for (std::thread &Thread : Threads) Thread.join();
+}
+
+void TS_AsyncReader::xLoop(uint32_t Thread) {
+    const uint32_t NumThreads = m_NumThreads < m_Inputs.size() ? m_NumThreads : (uint32_t) m_Inputs.size();
+    std::vector<Input *> Polled;
+    std::vector<Input *> Ready; //served every round
+#if TS_HAS_EPOLL
+    const int Epoll = epoll_create1(0);
+#endif
+    for (uint32_t i = Thread; i < m_Inputs.size(); i += NumThreads) {
+        Input *I = m_Inputs[i].get();
+#if TS_HAS_EPOLL
+        if (I->PollDescriptor >= 0 && Epoll >= 0) {
+            struct epoll_event Event = {};
+            Event.events = EPOLLIN;
+            Event.data.ptr = I;
+            if (epoll_ctl(Epoll, EPOLL_CTL_ADD, I->PollDescriptor, &Event) == 0) {
+                Polled.push_back(I);
+                continue;
+            }
+        }
+#endif
+        Ready.push_back(I);
+    }
+
+    size_t NumPolled = Polled.size();
+    while ((NumPolled || !Ready.empty()) && !m_Stop) {
+        bool Parsed = false;
+#if TS_HAS_EPOLL
+        if (NumPolled) {
+            //no waiting while there are always-readable inputs
+            struct epoll_event Events[MaxEvents];
+            const int NumEvents = epoll_wait(Epoll, Events, MaxEvents, Ready.empty() ? (int) StopCheck_ms : 0);
+            for (int e = 0; e < NumEvents; e++) {
+                Input &I = *(Input *) Events[e].data.ptr;
+                //level triggered - data left after this turn is reported again
+                const eTurn Turn = xTurn(I);
+                Parsed |= Turn == eTurn::Parsed;
+                if (Turn != eTurn::Finished) continue;
+                epoll_ctl(Epoll, EPOLL_CTL_DEL, I.PollDescriptor, nullptr);
+                NumPolled--;
+            }
+        }
+#endif
+        for (size_t r = 0; r < Ready.size();) {
+            const eTurn Turn = xTurn(*Ready[r]);
+            Parsed |= Turn == eTurn::Parsed;
+            if (Turn == eTurn::Finished) Ready.erase(Ready.begin() + r);
+            else r++;
+        }
+        //waiting inputs which cannot be polled - avoid spinning
+        if (!Parsed && !Ready.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+#if TS_HAS_EPOLL
+    if (Epoll >= 0) close(Epoll);
+#endif
+
+    //stopped - PES in progress are written out as at the end of the input
+    for (Input *I : Polled)
+        if (!I->Finished) I->Demuxer->Flush();
+    for (Input *I : Ready) I->Demuxer->Flush();
+}
+
+TS_AsyncReader::eTurn TS_AsyncReader::xTurn(Input &I) {
+    I.NumTurns++;
+    TS_PacketSpan Span;
+    for (uint32_t b = 0; b < MaxBatchesPerTurn; b++) {
+        if (I.Source->ReadBatch(Span)) {
+            I.Demuxer->Demux(Span);
+            continue;
+        }
+        if (I.Source->isPending()) return b ? eTurn::Parsed : eTurn::Pending;
+        xFinish(I);
+        return eTurn::Finished;
+    }
+    return eTurn::Parsed;
+}
+
+void TS_AsyncReader::xFinish(Input &I) {
+    I.Demuxer->Flush();
+    //descriptors may be shared (stdin) - blocking mode is restored as soon as the input is done
+    I.Source->setNonBlocking(false);
+    I.Finished = true;
+}
+
+//=============================================================================================================================================================================
@@ -0,0 +1,205 @@
+#include "tsAudioSplitter.h"
+#include <cstring>
+#include <algorithm>
+
+//=============================================================================================================================================================================
+// frame header tables
+//=============================================================================================================================================================================
+//kbit/s, [MPEG-1 / MPEG-2 and 2.5][Layer I, II, III][bitrate_index]
+static const uint16_t MpegBitrates[2][3][16] = {
+        {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},
+         {0, 32, 48, 56, 64,  80,  96,  112, 128, 160, 192, 224, 256, 320, 384, 0},
+         {0, 32, 40, 48, 56,  64,  80,  96,  112, 128, 160, 192, 224, 256, 320, 0}},
+        {{0, 32, 48, 56, 64,  80,  96,  112, 128, 144, 160, 176, 192, 224, 256, 0},
+         {0, 8,  16, 24, 32,  40,  48,  56,  64,  80,  96,  112, 128, 144, 160, 0},
+         {0, 8,  16, 24, 32,  40,  48,  56,  64,  80,  96,  112, 128, 144, 160, 0}},
+};
+
+static const uint32_t MpegSampleRates[3] = {44100, 48000, 32000};
+
+static const uint32_t AdtsSampleRates[16] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000,
+                                             11025, 8000, 7350, 0, 0, 0};
+
+//=============================================================================================================================================================================
+// TS_AudioFrameSplitter
+//=============================================================================================================================================================================
+TS_AudioFrameSplitter::TS_AudioFrameSplitter(eCodec Codec) : m_Codec(Codec) {
+    m_HeaderLength = Codec == eCodec::ADTS ? 7 : 4;
+}
+
+bool TS_AudioFrameSplitter::ParseFrameHeader(eCodec Codec, const uint8_t *Header, FrameHeader &Frame) {
+    if (Codec == eCodec::ADTS) {
+        //syncword 0xFFF, layer 0
+        if (Header[0] != 0xFF || (Header[1] & 0xF6) != 0xF0) return false;
+        Frame.SampleRate = AdtsSampleRates[(Header[2] >> 2) & 0xF];
+        Frame.NumChannels = ((Header[2] & 0x1) << 2) | (Header[3] >> 6);
+        Frame.FrameSize = ((uint32_t) (Header[3] & 0x3) << 11) | ((uint32_t) Header[4] << 3) | (Header[5] >> 5);
+        Frame.NumSamples = 1024 * ((Header[6] & 0x3) + 1); //number_of_raw_data_blocks_in_frame + 1
+        const uint32_t HeaderLength = (Header[1] & 0x1) ? 7 : 9;
+        return Frame.SampleRate != 0 && Frame.FrameSize > HeaderLength;
+    }
+
+    //frame sync (11 bits)
+    if (Header[0] != 0xFF || (Header[1] & 0xE0) != 0xE0) return false;
+    const uint32_t Version = (Header[1] >> 3) & 0x3; //0 - MPEG-2.5, 2 - MPEG-2, 3 - MPEG-1
+    const uint32_t Layer = 4 - ((Header[1] >> 1) & 0x3);
+    const uint32_t BitrateIndex = Header[2] >> 4;
+    const uint32_t SampleRateIndex = (Header[2] >> 2) & 0x3;
+    const uint32_t Padding = (Header[2] >> 1) & 0x1;
+    //reserved values, free format is not supported
+    if (Version == 1 || Layer == 4 || BitrateIndex == 0 || BitrateIndex == 15 || SampleRateIndex == 3) return false;
+    const bool MPEG1 = Version == 3;
+    const uint32_t Bitrate = MpegBitrates[MPEG1 ? 0 : 1][Layer - 1][BitrateIndex] * 1000;
+    Frame.SampleRate = MpegSampleRates[SampleRateIndex] >> (MPEG1 ? 0 : Version == 2 ? 1 : 2);
+    Frame.NumChannels = (Header[3] >> 6) == 3 ? 1 : 2;
+    switch (Layer) {
+        case 1:
+            Frame.NumSamples = 384;
+            Frame.FrameSize = (12 * Bitrate / Frame.SampleRate + Padding) * 4;
+            break;
+        case 2:
+            Frame.NumSamples = 1152;
+            Frame.FrameSize = 144 * Bitrate / Frame.SampleRate + Padding;
+            break;
+        default:
+            Frame.NumSamples = MPEG1 ? 1152 : 576;
+            Frame.FrameSize = (MPEG1 ? 144 : 72) * Bitrate / Frame.SampleRate + Padding;
+            break;
+    }
+    return true;
+}
+
+void TS_AudioFrameSplitter::AbsorbPES(const PES_PacketHeader &PESH, const TS_PayloadView *Views, uint32_t NumViews) {
+    m_In.clear();
+    m_InOffsets.clear();
+    m_InSize = 0;
+    m_Cursor = 0;
+    if (!m_Carry.empty()) {
+        m_In.push_back({m_Carry.data(), (uint32_t) m_Carry.size()});
+        m_InOffsets.push_back(0);
+        m_InSize = m_Carry.size();
+    }
+    const uint64_t CarrySize = m_InSize;
+    for (uint32_t v = 0; v < NumViews; v++) {
+        if (Views[v].Size == 0) continue;
+        m_In.push_back(Views[v]);
+        m_InOffsets.push_back(m_InSize);
+        m_InSize += Views[v].Size;
+    }
+
+    bool PendingPTS = PESH.hasPTS();
+    uint8_t Header[MaxHeaderLength];
+    FrameHeader Frame, Next;
+    uint64_t Offset = 0;
+    while (Offset + m_HeaderLength <= m_InSize) {
+        const uint64_t Sync = xFindSync(Offset);
+        m_NumSkippedBytes += Sync - Offset;
+        Offset = Sync;
+        if (!xRead(Offset, MaxHeaderLength, Header)) {
+            //short header at the end - completed by the next PES
+            if (Offset + m_HeaderLength > m_InSize || !xRead(Offset, m_HeaderLength, Header)) break;
+            memset(Header + m_HeaderLength, 0, MaxHeaderLength - m_HeaderLength);
+        }
+        if (!ParseFrameHeader(m_Codec, Header, Frame)) {
+            m_Locked = false;
+            m_NumSkippedBytes++;
+            Offset++;
+            continue;
+        }
+        if (Offset + Frame.FrameSize > m_InSize) break;
+        //without lock the frame has to be followed by another one (when it is already here)
+        if (!m_Locked && xRead(Offset + Frame.FrameSize, MaxHeaderLength, Header) &&
+            !ParseFrameHeader(m_Codec, Header, Next)) {
+            m_NumSkippedBytes++;
+            Offset++;
+            continue;
+        }
+        m_Locked = true;
+
+        if (Frame.SampleRate != m_SampleRate) {
+            //restart interpolation at the current position
+            if (m_BasePTS != NOT_VALID && m_SampleRate)
+                m_BasePTS = (m_BasePTS + (int64_t) (m_NumBaseSamples * TS::BaseClockFrequency_Hz / m_SampleRate)) %
+                            PTS_Period;
+            m_NumBaseSamples = 0;
+            m_SampleRate = Frame.SampleRate;
+        }
+        //first frame starting in this PES carries its PTS
+        if (PendingPTS && Offset >= CarrySize) {
+            m_BasePTS = (int64_t) PESH.getPTS();
+            m_NumBaseSamples = 0;
+            PendingPTS = false;
+        }
+        const int64_t PTS = m_BasePTS == NOT_VALID ? NOT_VALID :
+                            (m_BasePTS + (int64_t) (m_NumBaseSamples * TS::BaseClockFrequency_Hz / m_SampleRate)) %
+                            PTS_Period;
+        m_NumBaseSamples += Frame.NumSamples;
+        xEmitFrame(Offset, Frame, PTS);
+        Offset += Frame.FrameSize;
+    }
+
+    //incomplete frame - copied, next PES memory follows it
+    m_NextCarry.resize(m_InSize - Offset);
+    xRead(Offset, (uint32_t) m_NextCarry.size(), m_NextCarry.data());
+    m_Carry.swap(m_NextCarry);
+}
+
+void TS_AudioFrameSplitter::Finish() {
+    m_NumSkippedBytes += m_Carry.size();
+    m_Carry.clear();
+    m_Locked = false;
+}
+
+uint32_t TS_AudioFrameSplitter::xLocate(uint64_t Offset) {
+    while (m_Cursor > 0 && m_InOffsets[m_Cursor] > Offset) m_Cursor--;
+    while (m_Cursor + 1 < m_In.size() && m_InOffsets[m_Cursor + 1] <= Offset) m_Cursor++;
+    return m_Cursor;
+}
+
+bool TS_AudioFrameSplitter::xRead(uint64_t Offset, uint32_t Size, uint8_t *Data) {
+    if (Offset + Size > m_InSize) return false;
+    if (Size == 0) return true;
+    for (uint32_t v = xLocate(Offset); Size; v++) {
+        const uint64_t Local = Offset - m_InOffsets[v];
+        const uint32_t Len = (uint32_t) std::min<uint64_t>(Size, m_In[v].Size - Local);
+        memcpy(Data, m_In[v].Data + Local, Len);
+        Data += Len;
+        Offset += Len;
+        Size -= Len;
+    }
+    return true;
+}
+
+uint64_t TS_AudioFrameSplitter::xFindSync(uint64_t Offset) {
+    if (Offset >= m_InSize) return m_InSize;
+    for (uint32_t v = xLocate(Offset); v < m_In.size(); v++) {
+        const uint64_t Local = Offset > m_InOffsets[v] ? Offset - m_InOffsets[v] : 0;
+        const void *Found = memchr(m_In[v].Data + Local, 0xFF, m_In[v].Size - Local);
+        if (Found) return m_InOffsets[v] + ((const uint8_t *) Found - m_In[v].Data);
+    }
+    return m_InSize;
+}
+
+void TS_AudioFrameSplitter::xEmitFrame(uint64_t Offset, const FrameHeader &Header, int64_t PTS) {
+    m_FrameViews.clear();
+    uint64_t Size = Header.FrameSize;
+    for (uint32_t v = xLocate(Offset); Size; v++) {
+        const uint64_t Local = Offset - m_InOffsets[v];
+        const uint32_t Len = (uint32_t) std::min<uint64_t>(Size, m_In[v].Size - Local);
+        m_FrameViews.push_back({m_In[v].Data + Local, Len});
+        Offset += Len;
+        Size -= Len;
+    }
+    TS_AudioFrame Frame;
+    Frame.Views = m_FrameViews.data();
+    Frame.NumViews = (uint32_t) m_FrameViews.size();
+    Frame.Size = Header.FrameSize;
+    Frame.Number = m_NumFrames++;
+    Frame.PTS = PTS;
+    Frame.SampleRate = Header.SampleRate;
+    Frame.NumSamples = Header.NumSamples;
+    Frame.NumChannels = Header.NumChannels;
+    xAudioFrame(Frame);
+}
+
+//=============================================================================================================================================================================
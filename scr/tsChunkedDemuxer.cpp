@@ -0,0 +1,159 @@
+#include "tsChunkedDemuxer.h"
+#include <cstdio>
+#include <thread>
+
+//=============================================================================================================================================================================
+// PSI handlers used by the prescan - discovered streams are only collected
+//=============================================================================================================================================================================
+class xPrescanPMTHandler : public PSI_PMTHandler {
+protected:
+    TS_ChunkedDemuxer *m_Owner;
+
+public:
+    xPrescanPMTHandler(TS_Demuxer *Demuxer, TS_ChunkedDemuxer *Owner) : PSI_PMTHandler(Demuxer), m_Owner(Owner) {};
+
+protected:
+    void xRegisterStream(const PSI_ElementaryStream &Stream) override {
+        char FileName[32];
+        snprintf(FileName, sizeof(FileName), "pid%d.%s", Stream.PID, PSI::getStreamTypeExtension(Stream.StreamType));
+        m_Owner->RegisterStream(Stream.PID, FileName);
+    }
+};
+
+class xPrescanPATHandler : public PSI_PATHandler {
+protected:
+    TS_ChunkedDemuxer *m_Owner;
+
+public:
+    xPrescanPATHandler(TS_Demuxer *Demuxer, TS_ChunkedDemuxer *Owner) : PSI_PATHandler(Demuxer), m_Owner(Owner) {};
+
+protected:
+    void xRegisterProgram(const PSI_Program &Program) override {
+        m_Demuxer->AddHandler<xPrescanPMTHandler>(Program.PID, m_Demuxer, m_Owner);
+    }
+};
+
+//=============================================================================================================================================================================
+// TS_ChunkedDemuxer
+//=============================================================================================================================================================================
+TS_ChunkedDemuxer::TS_ChunkedDemuxer(uint32_t NumChunks, uint64_t PrescanSize) {
+    m_NumChunks = NumChunks ? NumChunks : 1;
+    m_PrescanSize = PrescanSize;
+}
+
+void TS_ChunkedDemuxer::RegisterStream(uint16_t PID, const char *FileName) {
+    for (const Stream &S : m_Streams)
+        if (S.PID == PID) return;
+    m_Streams.push_back({PID, FileName});
+}
+
+std::string TS_ChunkedDemuxer::xPartFileName(const Stream &S, uint32_t Chunk) {
+    return S.FileName + ".part" + std::to_string(Chunk);
+}
+
+bool TS_ChunkedDemuxer::Run(const char *FileName) {
+    TS_MmapPacketSource File(FileName);
+    if (!File.isGood()) return false;
+    const uint8_t *Data = File.getData();
+    const uint64_t Size = File.getSize();
+
+    xDiscoverStreams(Data, Size < m_PrescanSize ? Size : m_PrescanSize);
+    for (const Stream &S : m_Streams)
+        for (uint32_t c = 0; c < m_NumChunks; c++) remove(xPartFileName(S, c).c_str());
+
+    std::vector<uint64_t> NumPackets(m_NumChunks, 0);
+    std::vector<std::thread> Threads;
+    for (uint32_t c = 0; c < m_NumChunks; c++) {
+        const uint64_t Begin = Size * c / m_NumChunks;
+        const uint64_t End = Size * (c + 1) / m_NumChunks;
+        Threads.emplace_back([this, Data, Size, Begin, End, c, &NumPackets]() {
+            NumPackets[c] = xProcessChunk(Data, Size, Begin, End, c);
+        });
+    }
+    for (std::thread &Thread : Threads) Thread.join();
+    for (uint64_t N : NumPackets) m_NumPackets += N;
+
+    xMerge();
+    return true;
+}
+
+void TS_ChunkedDemuxer::xDiscoverStreams(const uint8_t *Data, uint64_t Size) {
+    TS_Demuxer PSIDemuxer;
+    PSIDemuxer.AddHandler<xPrescanPATHandler>((uint16_t) TS_PacketHeader::ePID::PAT, &PSIDemuxer, this);
+    TS_MemoryPacketSource Source(Data, Size);
+    TS_PacketSpan Span;
+    while (Source.ReadBatch(Span)) PSIDemuxer.Demux(Span);
+}
+
+uint64_t TS_ChunkedDemuxer::xProcessChunk(const uint8_t *Data, uint64_t Size, uint64_t Begin, uint64_t End,
+                                          uint32_t Chunk) {
+    TS_Demuxer Demuxer;
+    Demuxer.setBufferLimits(m_BufferLimits);
+    std::vector<TS_PesHandler *> Handlers;
+    for (const Stream &S : m_Streams)
+        Handlers.push_back(Demuxer.AddHandler<TS_PesHandler>(S.PID, S.PID, xPartFileName(S, Chunk).c_str()));
+
+    TS_MemoryPacketSource Source(Data + Begin, Size - Begin);
+    TS_PacketSpan Span;
+    //past the range end only PID and PUSI decide
+    TS_LitePacketHeader<eLiteField_PID | eLiteField_PayloadUnitStart> PacketHeader;
+    uint64_t NumPackets = 0;
+    uint32_t NumUnfinished = 0;
+    bool PastEnd = false;
+
+    while (Source.ReadBatch(Span)) {
+        const bool Measured = TS_STATS_ENABLED();
+        for (uint32_t i = 0; i < Span.NumPackets; i++) {
+            const uint8_t *Packet = Span.getPacket(i);
+            if (!PastEnd && (uint64_t) (Packet - Data) >= End) {
+                //range finished - keep following only PES started within it
+                PastEnd = true;
+                for (TS_PesHandler *Handler : Handlers) {
+                    if (Handler->getAssembler().isStarted()) NumUnfinished++;
+                    else Handler->Flush();
+                }
+            }
+            if (!PastEnd) {
+                if (Demuxer.DemuxPacket(Packet) && Measured)
+                    TS_STATS_PACKET(((Packet[1] & 0x1F) << 8) | Packet[2], TS_Demuxer::getPayloadSize(Packet));
+                NumPackets++;
+                continue;
+            }
+            if (NumUnfinished == 0) break;
+            PacketHeader.Parse(Packet);
+            TS_PacketHandler *Handler = Demuxer.getHandler(PacketHeader.getPID());
+            if (Handler == nullptr || !static_cast<TS_PesHandler *>(Handler)->getAssembler().isStarted()) continue;
+            if (PacketHeader.getPayloadUnitStartIndicator()) {
+                Handler->Flush();
+                NumUnfinished--;
+            } else {
+                Demuxer.DemuxPacket(Packet);
+                if (Measured) TS_STATS_PACKET(PacketHeader.getPID(), TS_Demuxer::getPayloadSize(Packet));
+            }
+        }
+        if (PastEnd && NumUnfinished == 0) break;
+    }
+    Demuxer.Flush();
+    return NumPackets;
+}
+
+void TS_ChunkedDemuxer::xMerge() {
+    const size_t BufferSize = 1 << 20;
+    std::vector<uint8_t> Buffer(BufferSize);
+    for (const Stream &S : m_Streams) {
+        FILE *Output = fopen(S.FileName.c_str(), "ab");
+        if (Output == nullptr) continue;
+        for (uint32_t c = 0; c < m_NumChunks; c++) {
+            const std::string PartFileName = xPartFileName(S, c);
+            FILE *Part = fopen(PartFileName.c_str(), "rb");
+            if (Part == nullptr) continue;
+            size_t Read;
+            while ((Read = fread(Buffer.data(), 1, BufferSize, Part)) > 0) fwrite(Buffer.data(), 1, Read, Output);
+            fclose(Part);
+            remove(PartFileName.c_str());
+        }
+        fclose(Output);
+    }
+}
+
+//=============================================================================================================================================================================
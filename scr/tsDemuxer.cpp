@@ -0,0 +1,54 @@
+#include "tsDemuxer.h"
+
+//=============================================================================================================================================================================
+// TS_Demuxer
+//=============================================================================================================================================================================
+TS_PacketHandler *TS_Demuxer::DemuxPacket(const uint8_t *TransportStreamPacket) {
+    m_PacketHeader.Parse(TransportStreamPacket);
+    //skip header parsing work for packets nobody listens to
+    if (m_Handlers[m_PacketHeader.getPID()] == nullptr) {
+        m_NumPackets++;
+        m_NumDroppedPackets++;
+        return nullptr;
+    }
+    if (m_PacketHeader.hasAdaptationField()) m_AdaptationField.Parse(TransportStreamPacket);
+    return Dispatch(TransportStreamPacket, &m_PacketHeader, &m_AdaptationField);
+}
+
+void TS_Demuxer::Demux(const TS_PacketSpan &Span) {
+    if (TS_STATS_ENABLED()) {
+        xDemuxMeasured(Span);
+        return;
+    }
+    for (uint32_t i = 0; i < Span.NumPackets; i++) DemuxPacket(Span.getPacket(i));
+}
+
+void TS_Demuxer::xDemuxMeasured(const TS_PacketSpan &Span) {
+    if (m_SpanHeaders.size() < Span.NumPackets) {
+        m_SpanHeaders.resize(Span.NumPackets);
+        m_SpanAdaptationFields.resize(Span.NumPackets);
+    }
+    {
+        TS_STATS_TIMER(HeaderParse);
+        for (uint32_t i = 0; i < Span.NumPackets; i++) m_SpanHeaders[i].Parse(Span.getPacket(i));
+    }
+    {
+        TS_STATS_TIMER(AdaptationFieldParse);
+        //also for PIDs without a handler yet - PSI routed later in the span may register one
+        for (uint32_t i = 0; i < Span.NumPackets; i++)
+            if (m_SpanHeaders[i].hasAdaptationField()) m_SpanAdaptationFields[i].Parse(Span.getPacket(i));
+    }
+    TS_STATS_TIMER(PesAssembly);
+    for (uint32_t i = 0; i < Span.NumPackets; i++) {
+        const TS_PacketHeader *PacketHeader = &m_SpanHeaders[i];
+        const TS_AdaptationField *AdaptationField = &m_SpanAdaptationFields[i];
+        if (Dispatch(Span.getPacket(i), PacketHeader, AdaptationField))
+            TS_STATS_PACKET(PacketHeader->getPID(), getPayloadSize(PacketHeader, AdaptationField));
+    }
+}
+
+void TS_Demuxer::Flush() {
+    for (std::unique_ptr<TS_PacketHandler> &Handler : m_OwnedHandlers) Handler->Flush();
+}
+
+//=============================================================================================================================================================================
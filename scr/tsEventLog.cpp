@@ -0,0 +1,351 @@
+#include "tsEventLog.h"
+
+//=============================================================================================================================================================================
+// TS_PacketRecord
+//=============================================================================================================================================================================
+void TS_PacketRecord::Set(uint64_t PacketIndex, const TS_PacketHeader &PacketHeader,
+                          const TS_AdaptationField *AdaptationField) {
+    memset(this, 0, sizeof(*this));
+    Index = PacketIndex;
+    PCR = OPCR = PTS = DTS = NOT_VALID;
+    PID = PacketHeader.getPID();
+    SyncByte = PacketHeader.getSyncByte();
+    ContinuityCounter = PacketHeader.getContinuityCounter();
+    AdaptationFieldControl = PacketHeader.getAdaptationFieldControl();
+    TransportScramblingControl = PacketHeader.getTransportScramblingControl();
+    Flags = (PacketHeader.getTransportErrorIndicator() ? eFlag_TransportErrorIndicator : 0) |
+            (PacketHeader.getPayloadUnitStartIndicator() ? eFlag_PayloadUnitStartIndicator : 0) |
+            (PacketHeader.getTransportPriority() ? eFlag_TransportPriority : 0);
+    if (AdaptationField == nullptr) return;
+    Flags |= eFlag_AdaptationField |
+             (AdaptationField->getDC() ? eFlag_Discontinuity : 0) |
+             (AdaptationField->getRA() ? eFlag_RandomAccess : 0) |
+             (AdaptationField->getSPI() ? eFlag_StreamPriority : 0) |
+             (AdaptationField->getSP() ? eFlag_SplicingPoint : 0) |
+             (AdaptationField->getTPD() ? eFlag_TransportPrivateData : 0) |
+             (AdaptationField->getAFExt() ? eFlag_AdaptationFieldExtension : 0);
+    AFLength = AdaptationField->getAFLength();
+    Stuffing = (uint8_t) AdaptationField->getStuffing();
+    if (AdaptationField->getPCR()) PCR = AdaptationField->getPCR_data();
+    if (AdaptationField->getOPCR()) OPCR = AdaptationField->getOPCR_data();
+}
+
+void TS_PacketRecord::setPreviousPES(const PES_Assembler &Assembler) {
+    if (!Assembler.isStarted()) return;
+    Flags |= eFlag_PreviousPesFinished;
+    PesSize = Assembler.getBufferSize();
+    PesHeaderLen = Assembler.getHeaderLen();
+}
+
+void TS_PacketRecord::setPES(PES_Assembler::eResult Result, const PES_Assembler &Assembler) {
+    PesResult = (int8_t) Result;
+    if (Result == PES_Assembler::eResult::AssemblingStarted) {
+        const PES_PacketHeader &PESH = Assembler.getPESH();
+        PacketStartCodePrefix = PESH.getPacketStartCodePrefix();
+        StreamId = PESH.getStreamId();
+        PesPacketLength = PESH.getPacketLength();
+        if (PESH.hasPTS()) PTS = (int64_t) PESH.getPTS();
+        if (PESH.hasDTS()) DTS = (int64_t) PESH.getDTS();
+    } else if (Result == PES_Assembler::eResult::AssemblingFinished) {
+        PesSize = Assembler.getBufferSize();
+        PesHeaderLen = Assembler.getHeaderLen();
+    }
+}
+
+//=============================================================================================================================================================================
+// TS_EventLog
+//=============================================================================================================================================================================
+static const char DigitPairs[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+TS_EventLog::TS_EventLog(TS_OutputSink *Sink, uint32_t BufferSize) {
+    m_Sink = Sink;
+    m_BufferSize = BufferSize < MaxRecordSize ? MaxRecordSize : BufferSize;
+    m_Buffer = new char[m_BufferSize];
+    m_Good = Sink != nullptr && Sink->isGood();
+}
+
+TS_EventLog::~TS_EventLog() {
+    Flush();
+    delete m_Sink;
+    delete[] m_Buffer;
+}
+
+TS_EventLog *TS_EventLog::Create(eFormat Format, TS_OutputSink *Sink, uint32_t BufferSize) {
+    switch (Format) {
+        case eFormat::NDJSON:
+            return new TS_JsonEventLog(Sink, BufferSize);
+        case eFormat::Binary:
+            return new TS_BinaryEventLog(Sink, BufferSize);
+        case eFormat::Text:
+        default:
+            return new TS_TextEventLog(Sink, BufferSize);
+    }
+}
+
+void TS_EventLog::xFlushBuffer() {
+    TS_STATS_TIMER(Output);
+    if (m_Pos && m_Good) {
+        TS_PayloadView View = {(const uint8_t *) m_Buffer, m_Pos};
+        m_Good = m_Sink->Write(&View, 1, false);
+    }
+    m_Pos = 0;
+}
+
+bool TS_EventLog::Flush() {
+    xFlushBuffer();
+    TS_STATS_TIMER(Output);
+    if (m_Good) m_Good = m_Sink->Flush();
+    return m_Good;
+}
+
+void TS_EventLog::xPutUInt(uint64_t Value, uint32_t MinDigits) {
+    char Digits[20];
+    uint32_t Pos = 20;
+    while (Value >= 100) {
+        const uint32_t Pair = (uint32_t) (Value % 100) * 2;
+        Value /= 100;
+        Digits[--Pos] = DigitPairs[Pair + 1];
+        Digits[--Pos] = DigitPairs[Pair];
+    }
+    if (Value >= 10) {
+        Digits[--Pos] = DigitPairs[Value * 2 + 1];
+        Digits[--Pos] = DigitPairs[Value * 2];
+    } else Digits[--Pos] = (char) ('0' + Value);
+    for (uint32_t Length = 20 - Pos; Length < MinDigits; Length++) xPut('0');
+    xPut(Digits + Pos, 20 - Pos);
+}
+
+void TS_EventLog::xPutFixed6(uint64_t Numerator, uint32_t Denominator) {
+    //exact rounding of the real quotient - callers pass clock ticks, far below 2^64 / 10^6
+    const uint64_t Micro = (Numerator * 1000000 + Denominator / 2) / Denominator;
+    xPutUInt(Micro / 1000000);
+    xPut('.');
+    xPutUInt(Micro % 1000000, 6);
+}
+
+//=============================================================================================================================================================================
+// TS_TextEventLog
+//=============================================================================================================================================================================
+void TS_TextEventLog::Write(const TS_PacketRecord &R) {
+    xReserve(MaxRecordSize);
+    xPutUInt(R.Index, 10);
+    xPut(" TS: SB=");
+    xPutUInt(R.SyncByte);
+    xPut(" E=");
+    xPut(R.hasFlag(TS_PacketRecord::eFlag_TransportErrorIndicator) ? '1' : '0');
+    xPut(" S=");
+    xPut(R.hasFlag(TS_PacketRecord::eFlag_PayloadUnitStartIndicator) ? '1' : '0');
+    xPut(" F=");
+    xPut(R.hasFlag(TS_PacketRecord::eFlag_TransportPriority) ? '1' : '0');
+    xPut(" PID=");
+    xPutUInt(R.PID);
+    xPut(" TSC=");
+    xPutUInt(R.TransportScramblingControl);
+    xPut(" AF=");
+    xPutUInt(R.AdaptationFieldControl);
+    xPut(" CC=");
+    xPutUInt(R.ContinuityCounter);
+    xPut(' ');
+    if (R.hasFlag(TS_PacketRecord::eFlag_AdaptationField)) {
+        xPut("AF: L=");
+        xPutUInt(R.AFLength);
+        xPut(" DC=");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_Discontinuity) ? '1' : '0');
+        xPut(" RA=");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_RandomAccess) ? '1' : '0');
+        xPut(" SP=");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_StreamPriority) ? '1' : '0');
+        xPut(" PR=");
+        xPut(R.PCR != NOT_VALID ? '1' : '0');
+        xPut(" OR=");
+        xPut(R.OPCR != NOT_VALID ? '1' : '0');
+        xPut(" SP=");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_SplicingPoint) ? '1' : '0');
+        xPut(" TP=");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_TransportPrivateData) ? '1' : '0');
+        xPut(" EX=");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_AdaptationFieldExtension) ? '1' : '0');
+        xPut(' ');
+        if (R.PCR != NOT_VALID) {
+            xPut("PCR=");
+            xPutInt(R.PCR);
+            xPut(" (Time=");
+            xPutFixed6((uint64_t) R.PCR, TS::ExtendedClockFrequency_Hz);
+            xPut("s) ");
+        }
+        if (R.OPCR != NOT_VALID) {
+            xPut("OPCR=");
+            xPutInt(R.OPCR);
+            xPut(' ');
+        }
+        xPut("Stuffing=");
+        xPutInt(R.Stuffing);
+        xPut(' ');
+    }
+    if (R.hasFlag(TS_PacketRecord::eFlag_PreviousPesFinished)) {
+        xPut(" PES: Previous was Finished of PES, PcktLen=");
+        xPutUInt(R.PesSize);
+        xPut(" HeadLen=");
+        xPutUInt(R.PesHeaderLen);
+        xPut(" DataLen=");
+        xPutInt((int64_t) R.PesSize - R.PesHeaderLen);
+        xPut(' ');
+    }
+    switch ((PES_Assembler::eResult) R.PesResult) {
+        case PES_Assembler::eResult::StreamPackedLost:
+            xPut("PcktLost ");
+            break;
+        case PES_Assembler::eResult::AssemblingStarted:
+            xPut("Started PES: PSCP=");
+            xPutUInt(R.PacketStartCodePrefix);
+            xPut(" SID=");
+            xPutUInt(R.StreamId);
+            xPut(" L=");
+            xPutUInt(R.PesPacketLength);
+            xPut(' ');
+            if (R.PTS != NOT_VALID) {
+                xPut("PTS= ");
+                xPutInt(R.PTS);
+                xPut(" (Time= ");
+                xPutFixed6((uint64_t) R.PTS, TS::BaseClockFrequency_Hz);
+                xPut("s)");
+            }
+            if (R.DTS != NOT_VALID) {
+                xPut("DTS= ");
+                xPutInt(R.DTS);
+                xPut(" (Time= ");
+                xPutFixed6((uint64_t) R.DTS, TS::BaseClockFrequency_Hz);
+                xPut("s)");
+            }
+            break;
+        case PES_Assembler::eResult::AssemblingContinue:
+            xPut("Continue ");
+            break;
+        case PES_Assembler::eResult::BufferOverflow:
+            xPut("Overflow ");
+            break;
+        case PES_Assembler::eResult::AssemblingFinished:
+            xPut("Finished PES: PcktLen=");
+            xPutUInt(R.PesSize);
+            xPut(" HeadLen=");
+            xPutUInt(R.PesHeaderLen);
+            xPut(" DataLen=");
+            xPutInt((int64_t) R.PesSize - R.PesHeaderLen);
+            xPut(' ');
+            break;
+        default:
+            break;
+    }
+    xPut('\n');
+}
+
+//=============================================================================================================================================================================
+// TS_JsonEventLog
+//=============================================================================================================================================================================
+void TS_JsonEventLog::Write(const TS_PacketRecord &R) {
+    xReserve(MaxRecordSize);
+    xPut("{\"packet\":");
+    xPutUInt(R.Index);
+    xPut(",\"pid\":");
+    xPutUInt(R.PID);
+    xPut(",\"cc\":");
+    xPutUInt(R.ContinuityCounter);
+    xPut(",\"tei\":");
+    xPut(R.hasFlag(TS_PacketRecord::eFlag_TransportErrorIndicator) ? '1' : '0');
+    xPut(",\"pusi\":");
+    xPut(R.hasFlag(TS_PacketRecord::eFlag_PayloadUnitStartIndicator) ? '1' : '0');
+    xPut(",\"tp\":");
+    xPut(R.hasFlag(TS_PacketRecord::eFlag_TransportPriority) ? '1' : '0');
+    xPut(",\"tsc\":");
+    xPutUInt(R.TransportScramblingControl);
+    xPut(",\"afc\":");
+    xPutUInt(R.AdaptationFieldControl);
+    if (R.hasFlag(TS_PacketRecord::eFlag_AdaptationField)) {
+        xPut(",\"af\":{\"len\":");
+        xPutUInt(R.AFLength);
+        xPut(",\"dc\":");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_Discontinuity) ? '1' : '0');
+        xPut(",\"ra\":");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_RandomAccess) ? '1' : '0');
+        xPut(",\"spi\":");
+        xPut(R.hasFlag(TS_PacketRecord::eFlag_StreamPriority) ? '1' : '0');
+        if (R.PCR != NOT_VALID) {
+            xPut(",\"pcr\":");
+            xPutInt(R.PCR);
+        }
+        if (R.OPCR != NOT_VALID) {
+            xPut(",\"opcr\":");
+            xPutInt(R.OPCR);
+        }
+        xPut(",\"stuffing\":");
+        xPutInt(R.Stuffing);
+        xPut('}');
+    }
+    if (R.hasFlag(TS_PacketRecord::eFlag_PreviousPesFinished)) {
+        xPut(",\"pes_finished\":{\"size\":");
+        xPutUInt(R.PesSize);
+        xPut(",\"header\":");
+        xPutUInt(R.PesHeaderLen);
+        xPut('}');
+    }
+    switch ((PES_Assembler::eResult) R.PesResult) {
+        case PES_Assembler::eResult::StreamPackedLost:
+            xPut(",\"pes\":{\"event\":\"lost\"}");
+            break;
+        case PES_Assembler::eResult::AssemblingStarted:
+            xPut(",\"pes\":{\"event\":\"started\",\"sid\":");
+            xPutUInt(R.StreamId);
+            xPut(",\"len\":");
+            xPutUInt(R.PesPacketLength);
+            if (R.PTS != NOT_VALID) {
+                xPut(",\"pts\":");
+                xPutInt(R.PTS);
+            }
+            if (R.DTS != NOT_VALID) {
+                xPut(",\"dts\":");
+                xPutInt(R.DTS);
+            }
+            xPut('}');
+            break;
+        case PES_Assembler::eResult::AssemblingContinue:
+            xPut(",\"pes\":{\"event\":\"continue\"}");
+            break;
+        case PES_Assembler::eResult::BufferOverflow:
+            xPut(",\"pes\":{\"event\":\"overflow\"}");
+            break;
+        case PES_Assembler::eResult::AssemblingFinished:
+            xPut(",\"pes\":{\"event\":\"finished\",\"size\":");
+            xPutUInt(R.PesSize);
+            xPut(",\"header\":");
+            xPutUInt(R.PesHeaderLen);
+            xPut('}');
+            break;
+        default:
+            break;
+    }
+    xPut("}\n");
+}
+
+//=============================================================================================================================================================================
+// TS_BinaryEventLog
+//=============================================================================================================================================================================
+TS_BinaryEventLog::TS_BinaryEventLog(TS_OutputSink *Sink, uint32_t BufferSize) : TS_EventLog(Sink, BufferSize) {
+    TS_EventLogFileHeader Header;
+    memcpy(Header.Magic, "TSEV", 4);
+    Header.Version = TS_EventLogFileHeader::CurrentVersion;
+    Header.RecordSize = sizeof(TS_PacketRecord);
+    Header.Reserved = 0;
+    xPut((const char *) &Header, sizeof(Header));
+}
+
+//=============================================================================================================================================================================
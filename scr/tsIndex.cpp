@@ -0,0 +1,410 @@
+#include "tsIndex.h"
+#include <cstdio>
+#include <cstring>
+
+//=============================================================================================================================================================================
+// delta coding helpers
+//=============================================================================================================================================================================
+static constexpr int64_t PTS_Period = (int64_t) 1 << 33;
+static constexpr int64_t PCR_Period = PTS_Period * TS::BaseToExtendedClockMultiplier;
+
+static void xPutVarint(std::vector<uint8_t> &Dst, uint64_t Value) {
+    while (Value >= 0x80) {
+        Dst.push_back((uint8_t) (Value | 0x80));
+        Value >>= 7;
+    }
+    Dst.push_back((uint8_t) Value);
+}
+
+static void xPutSigned(std::vector<uint8_t> &Dst, int64_t Value) {
+    xPutVarint(Dst, ((uint64_t) Value << 1) ^ (uint64_t) (Value >> 63));
+}
+
+//returns false when the varint runs past End
+static bool xGetVarint(const uint8_t *&Src, const uint8_t *End, uint64_t &Value) {
+    Value = 0;
+    for (uint32_t Shift = 0; Shift < 64; Shift += 7) {
+        if (Src >= End) return false;
+        const uint8_t Byte = *Src++;
+        Value |= (uint64_t) (Byte & 0x7F) << Shift;
+        if ((Byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+static bool xGetSigned(const uint8_t *&Src, const uint8_t *End, int64_t &Value) {
+    uint64_t Raw;
+    if (!xGetVarint(Src, End, Raw)) return false;
+    Value = (int64_t) (Raw >> 1) ^ -(int64_t) (Raw & 1);
+    return true;
+}
+
+static void xAlign8(std::vector<uint8_t> &File) {
+    File.resize((File.size() + 7) & ~(size_t) 7, 0);
+}
+
+template<class T>
+static void xAppend(std::vector<uint8_t> &File, const T *Items, size_t NumItems) {
+    const size_t Pos = File.size();
+    File.resize(Pos + sizeof(T) * NumItems);
+    if (NumItems) memcpy(&File[Pos], Items, sizeof(T) * NumItems);
+}
+
+//=============================================================================================================================================================================
+// TS_IndexBuilder
+//=============================================================================================================================================================================
+int64_t TS_IndexBuilder::xTimestampUnwrapper::Unwrap(int64_t Value, int64_t Period) {
+    if (Last != NOT_VALID) {
+        if (Value < Last - Period / 2) Base += Period;
+        else if (Value > Last + Period / 2 && Base >= Period) Base -= Period; //late timestamp from before the wrap
+    }
+    Last = Value;
+    return Base + Value;
+}
+
+TS_IndexBuilder::xStream &TS_IndexBuilder::xGetStream(uint16_t PID) {
+    std::unique_ptr<xStream> &Stream = m_Streams[PID & (TS_Demuxer::NumPIDs - 1)];
+    if (!Stream) {
+        Stream.reset(new xStream);
+        Stream->PID = PID;
+    }
+    return *Stream;
+}
+
+void TS_IndexBuilder::Build(TS_PacketSource &Source) {
+    TS_StreamParser<TS_IndexBuilder> Parser(*this);
+    Parser.setZeroCopy(Source.isPersistent());
+    const TS_MemoryPacketSource *Memory = dynamic_cast<const TS_MemoryPacketSource *>(&Source);
+    TS_PacketSpan Span;
+    while (Source.ReadBatch(Span)) {
+        m_PacketSize = Source.getPacketSize();
+        m_SpanData = Span.Data;
+        //non-memory sources do not expose positions, skipped bytes are attributed to the beginning of the file
+        m_SpanOffset = Memory ? (uint64_t) (Span.Data - Memory->getData())
+                              : Span.FirstPacketIndex * m_PacketSize + Source.getSkippedBytes();
+        Parser.Parse(Span);
+    }
+    Parser.Finish();
+    m_SourceSize = Memory ? Memory->getSize() : Source.getNumPacketsRead() * m_PacketSize + Source.getSkippedBytes();
+}
+
+void TS_IndexBuilder::onPacket(const TS_PacketHeader &, const uint8_t *Packet) {
+    m_PacketOffset = m_SpanOffset + (uint64_t) (Packet - m_SpanData);
+    m_RandomAccess = false;
+}
+
+void TS_IndexBuilder::onAdaptationField(const TS_PacketHeader &, const TS_AdaptationField &AdaptationField) {
+    m_RandomAccess = AdaptationField.getRA();
+}
+
+void TS_IndexBuilder::onPcr(uint16_t PID, uint64_t PCR) {
+    xStream &Stream = xGetStream(PID);
+    TS_IndexPcrEntry Entry;
+    Entry.Number = Stream.Pcr.size();
+    Entry.Offset = m_PacketOffset;
+    Entry.PCR = Stream.PCR.Unwrap((int64_t) PCR, PCR_Period);
+    Stream.Pcr.push_back(Entry);
+}
+
+void TS_IndexBuilder::onPesStart(uint16_t PID, const PES_PacketHeader &PESH) {
+    xStream &Stream = xGetStream(PID);
+    TS_IndexPesEntry Entry;
+    Entry.Number = Stream.Pes.size();
+    Entry.Offset = m_PacketOffset;
+    Entry.Flags = m_RandomAccess ? (uint32_t) TS_IndexPesEntry::eFlag_RandomAccess : 0;
+    Entry.PTS = NOT_VALID;
+    Entry.DTS = NOT_VALID;
+    if (PESH.hasPTS()) {
+        Entry.PTS = Stream.PTS.Unwrap((int64_t) PESH.getPTS(), PTS_Period);
+        Entry.Flags |= TS_IndexPesEntry::eFlag_PTS;
+    }
+    if (PESH.hasDTS()) {
+        Entry.DTS = Stream.DTS.Unwrap((int64_t) PESH.getDTS(), PTS_Period);
+        Entry.Flags |= TS_IndexPesEntry::eFlag_DTS;
+    }
+    Entry.Time = Entry.DTS != NOT_VALID ? Entry.DTS : Entry.PTS != NOT_VALID ? Entry.PTS : Stream.LastTime;
+    Stream.LastTime = Entry.Time;
+    Stream.Pes.push_back(Entry);
+}
+
+void TS_IndexBuilder::xWriteStream(const xStream &Stream, std::vector<uint8_t> &File,
+                                   TS_IndexStreamHeader &Header) const {
+    memset(&Header, 0, sizeof(Header));
+    Header.PID = Stream.PID;
+    Header.NumPes = Stream.Pes.size();
+    Header.NumPcr = Stream.Pcr.size();
+
+    std::vector<TS_IndexPesAnchor> PesAnchors;
+    std::vector<uint8_t> PesDeltas;
+    int64_t LastRandomAccess = NOT_VALID;
+    int64_t LastPTS = 0, LastDTS = 0;
+    for (size_t i = 0; i < Stream.Pes.size(); i++) {
+        const TS_IndexPesEntry &Entry = Stream.Pes[i];
+        if (i % m_BlockSize == 0) {
+            TS_IndexPesAnchor Anchor;
+            Anchor.Offset = Entry.Offset;
+            Anchor.PTS = Entry.PTS;
+            Anchor.DTS = Entry.DTS;
+            Anchor.Time = Entry.Time;
+            Anchor.LastRandomAccess = LastRandomAccess;
+            Anchor.DeltasPos = (uint32_t) PesDeltas.size();
+            Anchor.Flags = Entry.Flags;
+            PesAnchors.push_back(Anchor);
+            LastPTS = Entry.PTS != NOT_VALID ? Entry.PTS : 0;
+            LastDTS = Entry.DTS != NOT_VALID ? Entry.DTS : 0;
+        } else {
+            xPutVarint(PesDeltas, Entry.Offset - Stream.Pes[i - 1].Offset);
+            xPutVarint(PesDeltas, Entry.Flags);
+            if (Entry.Flags & TS_IndexPesEntry::eFlag_PTS) {
+                xPutSigned(PesDeltas, Entry.PTS - LastPTS);
+                LastPTS = Entry.PTS;
+            }
+            if (Entry.Flags & TS_IndexPesEntry::eFlag_DTS) {
+                xPutSigned(PesDeltas, Entry.DTS - LastDTS);
+                LastDTS = Entry.DTS;
+            }
+        }
+        if (Entry.isRandomAccess()) LastRandomAccess = (int64_t) i;
+    }
+
+    std::vector<TS_IndexPcrAnchor> PcrAnchors;
+    std::vector<uint8_t> PcrDeltas;
+    for (size_t i = 0; i < Stream.Pcr.size(); i++) {
+        const TS_IndexPcrEntry &Entry = Stream.Pcr[i];
+        if (i % m_BlockSize == 0) {
+            PcrAnchors.push_back({Entry.Offset, Entry.PCR, (uint32_t) PcrDeltas.size(), 0});
+        } else {
+            xPutVarint(PcrDeltas, Entry.Offset - Stream.Pcr[i - 1].Offset);
+            xPutSigned(PcrDeltas, Entry.PCR - Stream.Pcr[i - 1].PCR);
+        }
+    }
+
+    xAlign8(File);
+    Header.PesAnchorsPos = File.size();
+    xAppend(File, PesAnchors.data(), PesAnchors.size());
+    Header.PesDeltasPos = File.size();
+    xAppend(File, PesDeltas.data(), PesDeltas.size());
+    xAlign8(File);
+    Header.PcrAnchorsPos = File.size();
+    xAppend(File, PcrAnchors.data(), PcrAnchors.size());
+    Header.PcrDeltasPos = File.size();
+    xAppend(File, PcrDeltas.data(), PcrDeltas.size());
+}
+
+bool TS_IndexBuilder::Write(const char *FileName) const {
+    std::vector<const xStream *> Streams;
+    for (const std::unique_ptr<xStream> &Stream : m_Streams)
+        if (Stream) Streams.push_back(Stream.get());
+
+    TS_IndexFileHeader FileHeader;
+    memset(&FileHeader, 0, sizeof(FileHeader));
+    memcpy(FileHeader.Magic, "TSIX", 4);
+    FileHeader.Version = TS_IndexFileHeader::CurrentVersion;
+    FileHeader.BlockSize = m_BlockSize;
+    FileHeader.NumStreams = (uint32_t) Streams.size();
+    FileHeader.PacketSize = m_PacketSize;
+    FileHeader.SourceSize = m_SourceSize;
+
+    std::vector<TS_IndexStreamHeader> Headers(Streams.size());
+    std::vector<uint8_t> File;
+    xAppend(File, &FileHeader, 1);
+    xAppend(File, Headers.data(), Headers.size());
+    for (size_t i = 0; i < Streams.size(); i++) xWriteStream(*Streams[i], File, Headers[i]);
+    if (!Headers.empty())
+        memcpy(&File[sizeof(FileHeader)], Headers.data(), sizeof(TS_IndexStreamHeader) * Headers.size());
+
+    FILE *Output = fopen(FileName, "wb");
+    if (Output == nullptr) return false;
+    const bool Written = fwrite(File.data(), 1, File.size(), Output) == File.size();
+    return (fclose(Output) == 0) && Written;
+}
+
+//=============================================================================================================================================================================
+// TS_Index
+//=============================================================================================================================================================================
+bool TS_Index::Open(const char *FileName) {
+    m_Header = nullptr;
+    if (!m_File.Open(FileName) || m_File.getSize() < sizeof(TS_IndexFileHeader)) return false;
+    m_Data = m_File.getData();
+    m_Size = m_File.getSize();
+    const TS_IndexFileHeader *Header = (const TS_IndexFileHeader *) m_Data;
+    if (memcmp(Header->Magic, "TSIX", 4) != 0 || Header->Version != TS_IndexFileHeader::CurrentVersion ||
+        Header->BlockSize == 0)
+        return false;
+    if (sizeof(TS_IndexFileHeader) + (uint64_t) Header->NumStreams * sizeof(TS_IndexStreamHeader) > m_Size)
+        return false;
+    m_Streams = (const TS_IndexStreamHeader *) (m_Data + sizeof(TS_IndexFileHeader));
+    for (uint32_t i = 0; i < Header->NumStreams; i++) {
+        const TS_IndexStreamHeader &S = m_Streams[i];
+        const uint64_t NumPesBlocks = (S.NumPes + Header->BlockSize - 1) / Header->BlockSize;
+        const uint64_t NumPcrBlocks = (S.NumPcr + Header->BlockSize - 1) / Header->BlockSize;
+        if (S.PesAnchorsPos + NumPesBlocks * sizeof(TS_IndexPesAnchor) > S.PesDeltasPos ||
+            S.PcrAnchorsPos + NumPcrBlocks * sizeof(TS_IndexPcrAnchor) > S.PcrDeltasPos ||
+            S.PesDeltasPos > S.PcrAnchorsPos || S.PcrDeltasPos > m_Size)
+            return false;
+    }
+    m_Header = Header;
+    return true;
+}
+
+const TS_IndexStreamHeader *TS_Index::xFindStream(uint16_t PID) const {
+    for (uint32_t i = 0; i < getNumStreams(); i++)
+        if (m_Streams[i].PID == PID) return &m_Streams[i];
+    return nullptr;
+}
+
+uint64_t TS_Index::getNumPes(uint16_t PID) const {
+    const TS_IndexStreamHeader *Stream = xFindStream(PID);
+    return Stream ? Stream->NumPes : 0;
+}
+
+uint64_t TS_Index::getNumPcr(uint16_t PID) const {
+    const TS_IndexStreamHeader *Stream = xFindStream(PID);
+    return Stream ? Stream->NumPcr : 0;
+}
+
+template<class Func>
+bool TS_Index::xDecodePesBlock(const TS_IndexStreamHeader &Stream, uint64_t Block, uint64_t Last,
+                               Func Visit) const {
+    const TS_IndexPesAnchor &Anchor = ((const TS_IndexPesAnchor *) (m_Data + Stream.PesAnchorsPos))[Block];
+    const uint64_t BlockLast = (Block + 1) * m_Header->BlockSize - 1;
+    if (Last > BlockLast) Last = BlockLast;
+    const uint8_t *Src = m_Data + Stream.PesDeltasPos + Anchor.DeltasPos;
+    const uint8_t *End = m_Data + Stream.PcrAnchorsPos;
+    TS_IndexPesEntry Entry;
+    Entry.Number = Block * m_Header->BlockSize;
+    Entry.Offset = Anchor.Offset;
+    Entry.PTS = Anchor.PTS;
+    Entry.DTS = Anchor.DTS;
+    Entry.Time = Anchor.Time;
+    Entry.Flags = Anchor.Flags;
+    int64_t LastPTS = Anchor.PTS != NOT_VALID ? Anchor.PTS : 0;
+    int64_t LastDTS = Anchor.DTS != NOT_VALID ? Anchor.DTS : 0;
+    for (;;) {
+        if (!Visit(Entry) || Entry.Number == Last) return true;
+        uint64_t OffsetDelta, Flags;
+        if (!xGetVarint(Src, End, OffsetDelta) || !xGetVarint(Src, End, Flags)) return false;
+        Entry.Number++;
+        Entry.Offset += OffsetDelta;
+        Entry.Flags = (uint32_t) Flags;
+        Entry.PTS = NOT_VALID;
+        Entry.DTS = NOT_VALID;
+        int64_t Delta;
+        if (Flags & TS_IndexPesEntry::eFlag_PTS) {
+            if (!xGetSigned(Src, End, Delta)) return false;
+            Entry.PTS = LastPTS += Delta;
+        }
+        if (Flags & TS_IndexPesEntry::eFlag_DTS) {
+            if (!xGetSigned(Src, End, Delta)) return false;
+            Entry.DTS = LastDTS += Delta;
+        }
+        if (Entry.DTS != NOT_VALID) Entry.Time = Entry.DTS;
+        else if (Entry.PTS != NOT_VALID) Entry.Time = Entry.PTS;
+    }
+}
+
+template<class Func>
+bool TS_Index::xDecodePcrBlock(const TS_IndexStreamHeader &Stream, uint64_t Block, uint64_t Last,
+                               Func Visit) const {
+    const TS_IndexPcrAnchor &Anchor = ((const TS_IndexPcrAnchor *) (m_Data + Stream.PcrAnchorsPos))[Block];
+    const uint64_t BlockLast = (Block + 1) * m_Header->BlockSize - 1;
+    if (Last > BlockLast) Last = BlockLast;
+    const uint8_t *Src = m_Data + Stream.PcrDeltasPos + Anchor.DeltasPos;
+    const uint8_t *End = m_Data + m_Size;
+    TS_IndexPcrEntry Entry;
+    Entry.Number = Block * m_Header->BlockSize;
+    Entry.Offset = Anchor.Offset;
+    Entry.PCR = Anchor.PCR;
+    for (;;) {
+        if (!Visit(Entry) || Entry.Number == Last) return true;
+        uint64_t OffsetDelta;
+        int64_t PcrDelta;
+        if (!xGetVarint(Src, End, OffsetDelta) || !xGetSigned(Src, End, PcrDelta)) return false;
+        Entry.Number++;
+        Entry.Offset += OffsetDelta;
+        Entry.PCR += PcrDelta;
+    }
+}
+
+bool TS_Index::getPes(uint16_t PID, uint64_t Number, TS_IndexPesEntry &Entry) const {
+    const TS_IndexStreamHeader *Stream = xFindStream(PID);
+    if (Stream == nullptr || Number >= Stream->NumPes) return false;
+    return xDecodePesBlock(*Stream, Number / m_Header->BlockSize, Number, [&](const TS_IndexPesEntry &E) {
+        Entry = E;
+        return true;
+    });
+}
+
+bool TS_Index::getPcr(uint16_t PID, uint64_t Number, TS_IndexPcrEntry &Entry) const {
+    const TS_IndexStreamHeader *Stream = xFindStream(PID);
+    if (Stream == nullptr || Number >= Stream->NumPcr) return false;
+    return xDecodePcrBlock(*Stream, Number / m_Header->BlockSize, Number, [&](const TS_IndexPcrEntry &E) {
+        Entry = E;
+        return true;
+    });
+}
+
+bool TS_Index::FindPes(uint16_t PID, int64_t Time, TS_IndexPesEntry &Entry) const {
+    const TS_IndexStreamHeader *Stream = xFindStream(PID);
+    if (Stream == nullptr || Stream->NumPes == 0) return false;
+    const TS_IndexPesAnchor *Anchors = (const TS_IndexPesAnchor *) (m_Data + Stream->PesAnchorsPos);
+    const uint64_t NumBlocks = (Stream->NumPes + m_Header->BlockSize - 1) / m_Header->BlockSize;
+    //first block starting after Time
+    uint64_t Lo = 0, Hi = NumBlocks;
+    while (Lo < Hi) {
+        const uint64_t Mid = (Lo + Hi) / 2;
+        if (Anchors[Mid].Time <= Time) Lo = Mid + 1;
+        else Hi = Mid;
+    }
+    if (Lo == 0) return false;
+    bool Found = false;
+    xDecodePesBlock(*Stream, Lo - 1, Stream->NumPes - 1, [&](const TS_IndexPesEntry &E) {
+        if (E.Time > Time) return false;
+        Entry = E;
+        Found = true;
+        return true;
+    });
+    return Found;
+}
+
+bool TS_Index::FindRandomAccess(uint16_t PID, int64_t Time, TS_IndexPesEntry &Entry) const {
+    TS_IndexPesEntry Target;
+    if (!FindPes(PID, Time, Target)) return false;
+    const TS_IndexStreamHeader *Stream = xFindStream(PID);
+    const uint64_t Block = Target.Number / m_Header->BlockSize;
+    bool Found = false;
+    xDecodePesBlock(*Stream, Block, Target.Number, [&](const TS_IndexPesEntry &E) {
+        if (E.isRandomAccess()) {
+            Entry = E;
+            Found = true;
+        }
+        return true;
+    });
+    if (Found) return true;
+    const int64_t LastRandomAccess = ((const TS_IndexPesAnchor *) (m_Data + Stream->PesAnchorsPos))[Block].LastRandomAccess;
+    return LastRandomAccess != NOT_VALID && getPes(PID, (uint64_t) LastRandomAccess, Entry);
+}
+
+bool TS_Index::FindPcr(uint16_t PID, int64_t PCR, TS_IndexPcrEntry &Entry) const {
+    const TS_IndexStreamHeader *Stream = xFindStream(PID);
+    if (Stream == nullptr || Stream->NumPcr == 0) return false;
+    const TS_IndexPcrAnchor *Anchors = (const TS_IndexPcrAnchor *) (m_Data + Stream->PcrAnchorsPos);
+    const uint64_t NumBlocks = (Stream->NumPcr + m_Header->BlockSize - 1) / m_Header->BlockSize;
+    uint64_t Lo = 0, Hi = NumBlocks;
+    while (Lo < Hi) {
+        const uint64_t Mid = (Lo + Hi) / 2;
+        if (Anchors[Mid].PCR <= PCR) Lo = Mid + 1;
+        else Hi = Mid;
+    }
+    if (Lo == 0) return false;
+    bool Found = false;
+    xDecodePcrBlock(*Stream, Lo - 1, Stream->NumPcr - 1, [&](const TS_IndexPcrEntry &E) {
+        if (E.PCR > PCR) return false;
+        Entry = E;
+        Found = true;
+        return true;
+    });
+    return Found;
+}
+
+//=============================================================================================================================================================================
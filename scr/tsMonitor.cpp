@@ -0,0 +1,237 @@
+#include "tsMonitor.h"
+#include <cstring>
+
+//=============================================================================================================================================================================
+// PAT handler - PMT PIDs are put on the watch list, stream PIDs come through CreateStreamHandler
+//=============================================================================================================================================================================
+class xMonitorPATHandler : public PSI_PATHandler {
+protected:
+    TS_Monitor *m_Monitor;
+
+public:
+    xMonitorPATHandler(TS_Demuxer *Demuxer, TS_Monitor *Monitor) : PSI_PATHandler(Demuxer), m_Monitor(Monitor) {};
+
+protected:
+    void xRegisterProgram(const PSI_Program &Program) override {
+        m_Monitor->m_Sections.push_back(m_Demuxer->AddHandler<PSI_PMTHandler>(Program.PID, m_Demuxer));
+        m_Monitor->xWatch(Program.PID, TS_Monitor::ePidType_PMT);
+    }
+};
+
+//=============================================================================================================================================================================
+// TS_Monitor
+//=============================================================================================================================================================================
+static constexpr int64_t MaxClockStep = 100 * (int64_t) TS::ExtendedClockFrequency_kHz; //larger PCR steps are jumps
+
+const char *TS_Monitor::getEventName(eEvent Type) {
+    switch (Type) {
+        case eEvent::SyncLoss:
+            return "TS_sync_loss";
+        case eEvent::SyncByteError:
+            return "Sync_byte_error";
+        case eEvent::PatError:
+            return "PAT_error";
+        case eEvent::ContinuityCountError:
+            return "Continuity_count_error";
+        case eEvent::PmtError:
+            return "PMT_error";
+        case eEvent::PidError:
+            return "PID_error";
+        case eEvent::TransportError:
+            return "Transport_error";
+        case eEvent::CrcError:
+            return "CRC_error";
+        case eEvent::PtsError:
+            return "PTS_error";
+        default:
+            return "unknown";
+    }
+}
+
+TS_Monitor::TS_Monitor(int64_t PidTimeout, int64_t WindowLength) {
+    m_PidTimeout = PidTimeout;
+    m_WindowLength = WindowLength > 0 ? WindowLength : DefaultWindowLength;
+    m_PSIDemuxer.setStreamFactory(this);
+    m_Sections.push_back(
+            m_PSIDemuxer.AddHandler<xMonitorPATHandler>((uint16_t) TS_PacketHeader::ePID::PAT, &m_PSIDemuxer, this));
+    xWatch((uint16_t) TS_PacketHeader::ePID::PAT, ePidType_PAT);
+    xStartWindow();
+}
+
+TS_PacketHandler *TS_Monitor::CreateStreamHandler(TS_Demuxer *, uint16_t PID, uint8_t) {
+    xWatch(PID, ePidType_Stream);
+    return nullptr;
+}
+
+void TS_Monitor::xWatch(uint16_t PID, ePidType Type) {
+    xPidState &State = m_PIDs[PID & (TS_Demuxer::NumPIDs - 1)];
+    if (State.Type == ePidType_None) m_Watched.push_back(PID);
+    State.Type = Type;
+}
+
+void TS_Monitor::xStartWindow() {
+    memset(&m_Window, 0, sizeof(m_Window));
+    m_Window.StartTime = m_Time;
+    m_Window.FirstPacket = m_NumPackets;
+}
+
+void TS_Monitor::xEvent(eEvent Type, uint16_t PID, int64_t Value) {
+    m_Counters[(uint32_t) Type]++;
+    m_Window.Counts[(uint32_t) Type]++;
+    const Event E = {Type, PID, m_NumPackets, m_Time, Value};
+    xReportEvent(E);
+}
+
+void TS_Monitor::xUpdateClock(const TS_PacketHeader &PacketHeader, const TS_AdaptationField *AdaptationField,
+                              int64_t ArrivalTime_ns) {
+    if (ArrivalTime_ns != NOT_VALID) {
+        m_Time = ArrivalTime_ns * TS::ExtendedClockFrequency_kHz / 1000000;
+        return;
+    }
+    const bool HasPCR = AdaptationField && AdaptationField->getPCR();
+    if (HasPCR && m_ClockPID == NOT_VALID) m_ClockPID = PacketHeader.getPID();
+    if (HasPCR && PacketHeader.getPID() == m_ClockPID) {
+        const int64_t PCR = AdaptationField->getPCR_data();
+        const int64_t Period = ((int64_t) 1 << 33) * TS::BaseToExtendedClockMultiplier;
+        if (m_ClockPCR == NOT_VALID) {
+            m_ClockTime = 0;
+        } else {
+            int64_t Delta = PCR - m_ClockPCR;
+            if (Delta < -Period / 2) Delta += Period;
+            const uint64_t Packets = m_NumPackets - m_ClockPacket;
+            //discontinuities do not move the clock, it keeps running at the last known rate
+            if (Delta > 0 && Delta <= MaxClockStep && !AdaptationField->getDC() && Packets) {
+                m_TicksPerPacket = (double) Delta / Packets;
+                m_ClockTime += Delta;
+            } else m_ClockTime += (int64_t) (Packets * m_TicksPerPacket);
+        }
+        m_ClockPCR = PCR;
+        m_ClockPacket = m_NumPackets;
+        m_Time = m_ClockTime;
+        return;
+    }
+    if (m_ClockPCR != NOT_VALID)
+        m_Time = m_ClockTime + (int64_t) ((m_NumPackets - m_ClockPacket) * m_TicksPerPacket);
+}
+
+void TS_Monitor::AbsorbPacket(const uint8_t *Packet, const TS_PacketHeader &PacketHeader,
+                              const TS_AdaptationField *AdaptationField, int64_t ArrivalTime_ns) {
+    const uint16_t PID = PacketHeader.getPID();
+    xPidState &State = m_PIDs[PID];
+    xUpdateClock(PacketHeader, AdaptationField, ArrivalTime_ns);
+
+    if (PacketHeader.getSyncByte() != TS::TS_SyncByte) xEvent(eEvent::SyncByteError, PID);
+    if (PacketHeader.getTransportErrorIndicator()) xEvent(eEvent::TransportError, PID);
+    if (PID != (uint16_t) TS_PacketHeader::ePID::NuLL) xCheckContinuity(PacketHeader, AdaptationField, State);
+
+    if (State.Type != ePidType_None) {
+        //PSI repetition is measured between section starts
+        if (State.Type == ePidType_PAT || State.Type == ePidType_PMT) {
+            const eEvent Error = State.Type == ePidType_PAT ? eEvent::PatError : eEvent::PmtError;
+            if (PacketHeader.getTransportScramblingControl()) xEvent(Error, PID);
+            if (PacketHeader.getPayloadUnitStartIndicator()) {
+                if (m_Time != NOT_VALID && State.LastSeen != NOT_VALID && m_Time - State.LastSeen > MaxPsiInterval &&
+                    !State.TimeoutReported)
+                    xEvent(Error, PID, m_Time - State.LastSeen);
+                State.LastSeen = m_Time;
+                State.TimeoutReported = false;
+            }
+            m_PSIDemuxer.Dispatch(Packet, &PacketHeader, AdaptationField);
+        } else {
+            State.LastSeen = m_Time;
+            State.TimeoutReported = false;
+            if (PacketHeader.getPayloadUnitStartIndicator()) xCheckPts(Packet, PacketHeader, AdaptationField, State);
+        }
+    }
+
+    m_NumPackets++;
+    if (m_Time == NOT_VALID) return;
+    if (m_NextCheck == NOT_VALID || m_Time >= m_NextCheck) {
+        m_NextCheck = m_Time + CheckInterval;
+        xCheckTimeouts();
+    }
+    if (m_Window.StartTime == NOT_VALID) m_Window.StartTime = m_Time;
+    if (m_Time - m_Window.StartTime >= m_WindowLength) {
+        xCheckCRC();
+        m_Window.Duration = m_Time - m_Window.StartTime;
+        m_Window.NumPackets = m_NumPackets - m_Window.FirstPacket;
+        xWindowCompleted(m_Window);
+        xStartWindow();
+    }
+}
+
+void TS_Monitor::xCheckContinuity(const TS_PacketHeader &PacketHeader, const TS_AdaptationField *AdaptationField,
+                                  xPidState &State) {
+    const uint8_t CC = PacketHeader.getContinuityCounter();
+    const bool HasPayload = (PacketHeader.getAdaptationFieldControl() & 1) != 0;
+    const bool Discontinuity = AdaptationField && AdaptationField->getDC();
+    if (State.LastCC != UnknownCC && !Discontinuity) {
+        //CC increments only with payload, a packet may be sent twice
+        const uint8_t Expected = HasPayload ? (State.LastCC + 1) & 0xF : State.LastCC;
+        if (HasPayload && CC == State.LastCC) {
+            if (++State.NumDuplicates > 1) {
+                State.NumCCErrors++;
+                xEvent(eEvent::ContinuityCountError, PacketHeader.getPID(), Expected);
+            }
+            return;
+        }
+        if (CC != Expected) {
+            State.NumCCErrors++;
+            xEvent(eEvent::ContinuityCountError, PacketHeader.getPID(), Expected);
+        }
+    }
+    State.LastCC = CC;
+    State.NumDuplicates = 0;
+}
+
+void TS_Monitor::xCheckPts(const uint8_t *Packet, const TS_PacketHeader &PacketHeader,
+                           const TS_AdaptationField *AdaptationField, xPidState &State) {
+    if ((PacketHeader.getAdaptationFieldControl() & 1) == 0) return;
+    uint32_t Offset = TS::TS_HeaderLength;
+    if (PacketHeader.hasAdaptationField()) Offset += 1 + AdaptationField->getAFLength();
+    //start code, stream_id, length, flags, header length, PTS
+    if (Offset + 14 > TS::TS_PacketLength) return;
+    const uint8_t *PES = Packet + Offset;
+    if (PES[0] != 0 || PES[1] != 0 || PES[2] != 1 || (PES[7] & 0x80) == 0) return;
+    if (m_Time == NOT_VALID) return;
+    if (State.LastPts != NOT_VALID && m_Time - State.LastPts > MaxPtsInterval)
+        xEvent(eEvent::PtsError, PacketHeader.getPID(), m_Time - State.LastPts);
+    State.LastPts = m_Time;
+}
+
+void TS_Monitor::xCheckTimeouts() {
+    for (uint16_t PID : m_Watched) {
+        xPidState &State = m_PIDs[PID];
+        if (State.TimeoutReported) continue;
+        const int64_t Timeout = State.Type == ePidType_Stream ? m_PidTimeout : MaxPsiInterval;
+        //PIDs never seen are measured from the moment they were put on the list
+        if (State.LastSeen == NOT_VALID) State.LastSeen = m_Time;
+        if (m_Time - State.LastSeen <= Timeout) continue;
+        State.TimeoutReported = true;
+        xEvent(State.Type == ePidType_PAT ? eEvent::PatError : State.Type == ePidType_PMT ? eEvent::PmtError
+                                                                                           : eEvent::PidError,
+               PID, m_Time - State.LastSeen);
+    }
+}
+
+void TS_Monitor::xCheckCRC() {
+    uint64_t NumCRCErrors = 0;
+    for (const PSI_SectionAssembler *Section : m_Sections) NumCRCErrors += Section->getNumCRCErrors();
+    for (; m_LastCRCErrors < NumCRCErrors; m_LastCRCErrors++) xEvent(eEvent::CrcError, (uint16_t) TS_PacketHeader::ePID::NuLL);
+}
+
+void TS_Monitor::CheckSource(const TS_PacketSource &Source) {
+    for (; m_LastSyncLosses < Source.getNumSyncLosses(); m_LastSyncLosses++)
+        xEvent(eEvent::SyncLoss, (uint16_t) TS_PacketHeader::ePID::NuLL);
+}
+
+void TS_Monitor::Finish() {
+    xCheckCRC();
+    if (m_NumPackets == m_Window.FirstPacket) return;
+    m_Window.Duration = m_Time != NOT_VALID && m_Window.StartTime != NOT_VALID ? m_Time - m_Window.StartTime : 0;
+    m_Window.NumPackets = m_NumPackets - m_Window.FirstPacket;
+    xWindowCompleted(m_Window);
+    xStartWindow();
+}
+
+//=============================================================================================================================================================================
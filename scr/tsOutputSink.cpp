@@ -0,0 +1,320 @@
+#include "tsOutputSink.h"
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#if defined(TS_ENABLE_IO_URING) && defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define TS_HAS_IO_URING 1
+#else
+#define TS_HAS_IO_URING 0
+#endif
+
+//=============================================================================================================================================================================
+// TS_OutputSink
+//=============================================================================================================================================================================
+TS_OutputSink *TS_OutputSink::Create(const char *FileName, bool Append) {
+#if TS_HAS_IO_URING
+    return new TS_IoUringSink(FileName, Append);
+#elif defined(_WIN32)
+    return new TS_FileSink(FileName, Append);
+#else
+    return new TS_WritevSink(FileName, Append);
+#endif
+}
+
+//=============================================================================================================================================================================
+// TS_WritevSink
+//=============================================================================================================================================================================
+TS_WritevSink::TS_WritevSink(const char *FileName, bool Append) {
+#if defined(_WIN32)
+    m_FileDescriptor = _open(FileName, _O_WRONLY | _O_CREAT | _O_BINARY | (Append ? _O_APPEND : _O_TRUNC), 0644);
+#else
+    m_FileDescriptor = open(FileName, O_WRONLY | O_CREAT | (Append ? O_APPEND : O_TRUNC), 0644);
+#endif
+    m_Pending.reserve(MaxBatchViews);
+}
+
+TS_WritevSink::~TS_WritevSink() {
+    Flush();
+#if defined(_WIN32)
+    if (m_FileDescriptor >= 0) _close(m_FileDescriptor);
+#else
+    if (m_FileDescriptor >= 0) close(m_FileDescriptor);
+#endif
+}
+
+bool TS_WritevSink::Write(const TS_PayloadView *Views, uint32_t NumViews, bool Persistent) {
+    if (!Persistent) return Flush() && xWritev(Views, NumViews);
+    for (uint32_t i = 0; i < NumViews; i++) {
+        if (Views[i].Size == 0) continue;
+        m_Pending.push_back(Views[i]);
+        if (m_Pending.size() == MaxBatchViews && !Flush()) return false;
+    }
+    return true;
+}
+
+bool TS_WritevSink::Flush() {
+    bool Result = m_Pending.empty() || xWritev(m_Pending.data(), (uint32_t) m_Pending.size());
+    m_Pending.clear();
+    return Result;
+}
+
+bool TS_WritevSink::xWritev(const TS_PayloadView *Views, uint32_t NumViews) {
+    if (m_FileDescriptor < 0) return false;
+#if defined(_WIN32)
+    for (uint32_t i = 0; i < NumViews; i++) {
+        m_NumSystemCalls++;
+        if (_write(m_FileDescriptor, Views[i].Data, Views[i].Size) != (int) Views[i].Size) return false;
+    }
+    return true;
+#else
+    struct iovec IoVecs[MaxBatchViews];
+    while (NumViews) {
+        const uint32_t NumBatch = NumViews < MaxBatchViews ? NumViews : MaxBatchViews;
+        for (uint32_t i = 0; i < NumBatch; i++) {
+            IoVecs[i].iov_base = (void *) Views[i].Data;
+            IoVecs[i].iov_len = Views[i].Size;
+        }
+        //retry the remainder after partial writes
+        struct iovec *Pending = IoVecs;
+        uint32_t NumPending = NumBatch;
+        while (NumPending) {
+            m_NumSystemCalls++;
+            ssize_t Written = writev(m_FileDescriptor, Pending, NumPending);
+            if (Written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            while (NumPending && (size_t) Written >= Pending->iov_len) {
+                Written -= Pending->iov_len;
+                Pending++;
+                NumPending--;
+            }
+            if (NumPending) {
+                Pending->iov_base = (uint8_t *) Pending->iov_base + Written;
+                Pending->iov_len -= Written;
+            }
+        }
+        Views += NumBatch;
+        NumViews -= NumBatch;
+    }
+    return true;
+#endif
+}
+
+//=============================================================================================================================================================================
+// TS_IoUringSink
+//=============================================================================================================================================================================
+#if TS_HAS_IO_URING
+struct TS_IoUringSink::Ring {
+    int FileDescriptor = NOT_VALID;
+    uint8_t *SQRing = nullptr;
+    uint8_t *CQRing = nullptr;
+    size_t SQRingSize = 0;
+    size_t CQRingSize = 0;
+    io_uring_sqe *SQEs = nullptr;
+    size_t SQEsSize = 0;
+    uint32_t *SQTail, *SQMask, *SQArray;
+    uint32_t *CQHead, *CQTail, *CQMask;
+    io_uring_cqe *CQEs;
+    std::vector<struct iovec> IoVecs;
+
+    bool Init(uint32_t Entries) {
+        io_uring_params Params;
+        memset(&Params, 0, sizeof(Params));
+        FileDescriptor = (int) syscall(__NR_io_uring_setup, Entries, &Params);
+        if (FileDescriptor < 0) return false;
+        SQRingSize = Params.sq_off.array + Params.sq_entries * sizeof(uint32_t);
+        CQRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+        const bool SingleMmap = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (SingleMmap) SQRingSize = CQRingSize = SQRingSize > CQRingSize ? SQRingSize : CQRingSize;
+        void *SQ = mmap(nullptr, SQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, FileDescriptor,
+                        IORING_OFF_SQ_RING);
+        if (SQ == MAP_FAILED) return false;
+        SQRing = (uint8_t *) SQ;
+        if (SingleMmap) CQRing = SQRing;
+        else {
+            void *CQ = mmap(nullptr, CQRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, FileDescriptor,
+                            IORING_OFF_CQ_RING);
+            if (CQ == MAP_FAILED) return false;
+            CQRing = (uint8_t *) CQ;
+        }
+        SQEsSize = Params.sq_entries * sizeof(io_uring_sqe);
+        void *S = mmap(nullptr, SQEsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, FileDescriptor,
+                       IORING_OFF_SQES);
+        if (S == MAP_FAILED) return false;
+        SQEs = (io_uring_sqe *) S;
+        SQTail = (uint32_t *) (SQRing + Params.sq_off.tail);
+        SQMask = (uint32_t *) (SQRing + Params.sq_off.ring_mask);
+        SQArray = (uint32_t *) (SQRing + Params.sq_off.array);
+        CQHead = (uint32_t *) (CQRing + Params.cq_off.head);
+        CQTail = (uint32_t *) (CQRing + Params.cq_off.tail);
+        CQMask = (uint32_t *) (CQRing + Params.cq_off.ring_mask);
+        CQEs = (io_uring_cqe *) (CQRing + Params.cq_off.cqes);
+        return true;
+    }
+
+    ~Ring() {
+        if (SQEs) munmap(SQEs, SQEsSize);
+        if (CQRing && CQRing != SQRing) munmap(CQRing, CQRingSize);
+        if (SQRing) munmap(SQRing, SQRingSize);
+        if (FileDescriptor >= 0) close(FileDescriptor);
+    }
+
+    void Queue(int Fd, const struct iovec *Vecs, uint32_t NumVecs, uint64_t Offset, uint64_t UserData) {
+        const uint32_t Tail = *SQTail;
+        const uint32_t Idx = Tail & *SQMask;
+        io_uring_sqe *SQE = &SQEs[Idx];
+        memset(SQE, 0, sizeof(*SQE));
+        SQE->opcode = IORING_OP_WRITEV;
+        SQE->fd = Fd;
+        SQE->addr = (uint64_t) (uintptr_t) Vecs;
+        SQE->len = NumVecs;
+        SQE->off = Offset;
+        SQE->user_data = UserData;
+        SQArray[Idx] = Idx;
+        __atomic_store_n(SQTail, Tail + 1, __ATOMIC_RELEASE);
+    }
+
+    //submits NumQueued entries and waits for all of them, stores the result of each request at Results[user_data]
+    bool SubmitAndWait(uint32_t NumQueued, int32_t *Results) {
+        uint32_t NumSubmitted = 0;
+        while (NumSubmitted < NumQueued) {
+            int Result = (int) syscall(__NR_io_uring_enter, FileDescriptor, NumQueued - NumSubmitted,
+                                       NumQueued - NumSubmitted, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (Result < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            NumSubmitted += Result;
+        }
+        uint32_t NumCompleted = 0;
+        while (NumCompleted < NumQueued) {
+            uint32_t Head = *CQHead;
+            while (Head == __atomic_load_n(CQTail, __ATOMIC_ACQUIRE)) {
+                if (syscall(__NR_io_uring_enter, FileDescriptor, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+                    errno != EINTR)
+                    return false;
+            }
+            const io_uring_cqe &CQE = CQEs[Head & *CQMask];
+            Results[CQE.user_data] = CQE.res;
+            __atomic_store_n(CQHead, Head + 1, __ATOMIC_RELEASE);
+            NumCompleted++;
+        }
+        return true;
+    }
+};
+
+TS_IoUringSink::TS_IoUringSink(const char *FileName, bool Append) : TS_WritevSink(FileName, Append) {
+    if (m_FileDescriptor < 0) return;
+    Ring *R = new Ring;
+    if (!R->Init(QueueDepth)) {
+        delete R;
+        return;
+    }
+    //explicit offsets are used - with O_APPEND the order of in-flight writes would not be defined
+    fcntl(m_FileDescriptor, F_SETFL, fcntl(m_FileDescriptor, F_GETFL) & ~O_APPEND);
+    m_FileOffset = (uint64_t) lseek(m_FileDescriptor, 0, Append ? SEEK_END : SEEK_SET);
+    m_Ring = R;
+}
+
+TS_IoUringSink::~TS_IoUringSink() {
+    Flush();
+    delete m_Ring;
+}
+
+bool TS_IoUringSink::Flush() {
+    if (m_Ring == nullptr) return TS_WritevSink::Flush();
+    if (m_Pending.empty()) return true;
+
+    //iovec arrays must stay untouched until the kernel completed the requests
+    std::vector<struct iovec> &IoVecs = m_Ring->IoVecs;
+    IoVecs.resize(m_Pending.size());
+    for (size_t i = 0; i < m_Pending.size(); i++) {
+        IoVecs[i].iov_base = (void *) m_Pending[i].Data;
+        IoVecs[i].iov_len = m_Pending[i].Size;
+    }
+
+    bool Result = true;
+    for (size_t Window = 0; Window < IoVecs.size() && Result; Window += (size_t) MaxBatchViews * QueueDepth) {
+        const size_t WindowEnd = IoVecs.size() - Window < (size_t) MaxBatchViews * QueueDepth
+                                     ? IoVecs.size()
+                                     : Window + (size_t) MaxBatchViews * QueueDepth;
+        uint64_t Sizes[QueueDepth];
+        int32_t Results[QueueDepth];
+        uint32_t NumQueued = 0;
+        uint64_t Offset = m_FileOffset;
+        for (size_t Begin = Window; Begin < WindowEnd; Begin += MaxBatchViews, NumQueued++) {
+            const uint32_t Num = (uint32_t) (WindowEnd - Begin < MaxBatchViews ? WindowEnd - Begin : MaxBatchViews);
+            Sizes[NumQueued] = 0;
+            for (uint32_t i = 0; i < Num; i++) Sizes[NumQueued] += IoVecs[Begin + i].iov_len;
+            Results[NumQueued] = -EIO;
+            m_Ring->Queue(m_FileDescriptor, &IoVecs[Begin], Num, Offset, NumQueued);
+            Offset += Sizes[NumQueued];
+        }
+        m_NumSystemCalls++;
+        if (!m_Ring->SubmitAndWait(NumQueued, Results)) {
+            //completions cannot be trusted anymore - nothing past the current offset counts as written
+            Result = false;
+            break;
+        }
+        //requests are checked in file order, a short or failed one gets its remainder written synchronously
+        for (uint32_t r = 0; r < NumQueued; r++) {
+            const uint64_t Written = Results[r] < 0 ? 0 : (uint64_t) Results[r];
+            if (Written < Sizes[r]) {
+                const size_t Begin = Window + (size_t) r * MaxBatchViews;
+                const size_t End = WindowEnd - Begin < MaxBatchViews ? WindowEnd : Begin + MaxBatchViews;
+                size_t First = Begin;
+                uint64_t Skip = Written;
+                while (Skip >= m_Pending[First].Size) Skip -= m_Pending[First++].Size;
+                std::vector<TS_PayloadView> Remainder(m_Pending.begin() + First, m_Pending.begin() + End);
+                Remainder[0].Data += Skip;
+                Remainder[0].Size -= (uint32_t) Skip;
+                if (lseek(m_FileDescriptor, (off_t) (m_FileOffset + Written), SEEK_SET) < 0 ||
+                    !xWritev(Remainder.data(), (uint32_t) Remainder.size())) {
+                    m_FileOffset += Written;
+                    Result = false;
+                    break;
+                }
+            }
+            m_FileOffset += Sizes[r];
+        }
+    }
+    m_Pending.clear();
+    //keep the descriptor position in sync for direct writes
+    lseek(m_FileDescriptor, (off_t) m_FileOffset, SEEK_SET);
+    return Result;
+}
+
+bool TS_IoUringSink::Write(const TS_PayloadView *Views, uint32_t NumViews, bool Persistent) {
+    if (m_Ring == nullptr || Persistent) return TS_WritevSink::Write(Views, NumViews, Persistent);
+    bool Result = Flush() && xWritev(Views, NumViews);
+    m_FileOffset = (uint64_t) lseek(m_FileDescriptor, 0, SEEK_CUR);
+    return Result;
+}
+#else
+struct TS_IoUringSink::Ring {
+};
+
+TS_IoUringSink::TS_IoUringSink(const char *FileName, bool Append) : TS_WritevSink(FileName, Append) {}
+
+TS_IoUringSink::~TS_IoUringSink() {}
+
+bool TS_IoUringSink::Write(const TS_PayloadView *Views, uint32_t NumViews, bool Persistent) {
+    return TS_WritevSink::Write(Views, NumViews, Persistent);
+}
+
+bool TS_IoUringSink::Flush() { return TS_WritevSink::Flush(); }
+#endif
+
+//=============================================================================================================================================================================
@@ -0,0 +1,261 @@
+#include "tsPSI.h"
+#include <cstring>
+#include <cstdio>
+
+//=============================================================================================================================================================================
+// PSI
+//=============================================================================================================================================================================
+struct xCRC32Tables {
+    uint32_t T[8][256];
+
+    xCRC32Tables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t CRC = i << 24;
+            for (int32_t b = 0; b < 8; b++) CRC = (CRC & 0x80000000) ? (CRC << 1) ^ 0x04C11DB7 : (CRC << 1);
+            T[0][i] = CRC;
+        }
+        for (uint32_t s = 1; s < 8; s++)
+            for (uint32_t i = 0; i < 256; i++) T[s][i] = (T[s - 1][i] << 8) ^ T[0][T[s - 1][i] >> 24];
+    }
+};
+
+static const xCRC32Tables CRC32Tables;
+
+uint32_t PSI::CRC32(const uint8_t *Data, uint32_t Size, uint32_t CRC) {
+    const uint32_t(*T)[256] = CRC32Tables.T;
+    for (; Size >= 8; Size -= 8, Data += 8) {
+        uint32_t One, Two;
+        memcpy(&One, Data, sizeof(One));
+        memcpy(&Two, Data + 4, sizeof(Two));
+        One = xSwapBytes32(One) ^ CRC;
+        Two = xSwapBytes32(Two);
+        CRC = T[7][One >> 24] ^ T[6][(One >> 16) & 0xFF] ^ T[5][(One >> 8) & 0xFF] ^ T[4][One & 0xFF] ^
+              T[3][Two >> 24] ^ T[2][(Two >> 16) & 0xFF] ^ T[1][(Two >> 8) & 0xFF] ^ T[0][Two & 0xFF];
+    }
+    for (; Size; Size--, Data++) CRC = (CRC << 8) ^ T[0][(CRC >> 24) ^ *Data];
+    return CRC;
+}
+
+const char *PSI::getStreamTypeExtension(uint8_t StreamType) {
+    switch (StreamType) {
+        case eStreamType_MPEG1_Audio:
+        case eStreamType_MPEG2_Audio:
+            return "mp2";
+        case eStreamType_MPEG2_Video:
+            return "m2v";
+        case eStreamType_AAC_ADTS:
+            return "aac";
+        case eStreamType_H264:
+            return "264";
+        case eStreamType_HEVC:
+            return "265";
+        default:
+            return "pes";
+    }
+}
+
+//=============================================================================================================================================================================
+// PSI_SectionAssembler
+//=============================================================================================================================================================================
+int32_t PSI_SectionAssembler::AbsorbPacket(const uint8_t *TransportStreamPacket, const TS_PacketHeader *PacketHeader,
+                                           const TS_AdaptationField *AdaptationField) {
+    if ((PacketHeader->getAdaptationFieldControl() & 1) == 0) return 0;
+
+    //a lost packet breaks the section in progress (repeated packets are ignored)
+    const int8_t ContinuityCounter = PacketHeader->getContinuityCounter();
+    if (ContinuityCounter == m_LastContinuityCounter) return 0;
+    if (m_InSection && ContinuityCounter != ((m_LastContinuityCounter + 1) & 0xF)) {
+        m_InSection = false;
+        m_NumBrokenSections++;
+    }
+    m_LastContinuityCounter = ContinuityCounter;
+
+    uint32_t PayloadStart = TS::TS_HeaderLength;
+    if (PacketHeader->hasAdaptationField()) PayloadStart += 1 + AdaptationField->getAFLength();
+    if (PayloadStart >= TS::TS_PacketLength) return 0;
+    const uint8_t *Payload = TransportStreamPacket + PayloadStart;
+    const uint32_t PayloadSize = TS::TS_PacketLength - PayloadStart;
+
+    if (!PacketHeader->getPayloadUnitStartIndicator()) return xAppend(Payload, PayloadSize, false);
+
+    const uint32_t PointerField = Payload[0];
+    if (1 + PointerField >= PayloadSize) return 0;
+    int32_t NumSections = 0;
+    if (m_InSection) {
+        NumSections += xAppend(Payload + 1, PointerField, false);
+        if (m_InSection) {
+            m_InSection = false;
+            m_NumBrokenSections++;
+        }
+    }
+    NumSections += xAppend(Payload + 1 + PointerField, PayloadSize - 1 - PointerField, true);
+    return NumSections;
+}
+
+int32_t PSI_SectionAssembler::xAppend(const uint8_t *Data, uint32_t Size, bool AllowNewSection) {
+    int32_t NumSections = 0;
+    while (Size) {
+        if (!m_InSection) {
+            if (!AllowNewSection || Data[0] == PSI::StuffingByte) return NumSections;
+            m_InSection = true;
+            m_SkipSection = false;
+            m_DataInSection = 0;
+            m_SectionLength = 0;
+        }
+
+        //section header first, then the rest once the length is known
+        const uint32_t Needed = (m_SectionLength ? m_SectionLength : PSI::SectionHeaderLength) - m_DataInSection;
+        const uint32_t Len = Size < Needed ? Size : Needed;
+        const bool HeaderPresent = m_DataInSection >= PSI::LongSectionHeaderLength;
+        if (!m_SkipSection || !HeaderPresent) memcpy(m_Section + m_DataInSection, Data, Len);
+        m_DataInSection += Len;
+        Data += Len;
+        Size -= Len;
+
+        if (m_SectionLength == 0 && m_DataInSection == PSI::SectionHeaderLength) {
+            m_SectionLength = PSI::SectionHeaderLength + (((m_Section[1] & 0x0F) << 8) | m_Section[2]);
+            if (m_SectionLength > PSI::MaxSectionLength) {
+                m_InSection = false;
+                m_NumBrokenSections++;
+                return NumSections;
+            }
+        }
+        if (!HeaderPresent && m_DataInSection >= PSI::LongSectionHeaderLength && m_SectionLength >= PSI::LongSectionHeaderLength)
+            m_SkipSection = xIsKnownVersion();
+        if (m_SectionLength && m_DataInSection == m_SectionLength) {
+            m_InSection = false;
+            NumSections += xCompleteSection();
+        }
+    }
+    return NumSections;
+}
+
+int32_t PSI_SectionAssembler::xCompleteSection() {
+    if (m_SkipSection) {
+        m_NumSkippedSections++;
+        return 0;
+    }
+    const bool SectionSyntax = (m_Section[1] & 0x80) != 0;
+    //PAT and PMT are always long sections - without the syntax indicator there is no length or CRC to trust
+    if (!SectionSyntax && (m_Section[0] == PSI::eTableId_PAT || m_Section[0] == PSI::eTableId_PMT)) {
+        m_NumBrokenSections++;
+        return 0;
+    }
+    if (SectionSyntax) {
+        if (m_SectionLength < PSI::LongSectionHeaderLength + PSI::CRC32Length) {
+            m_NumBrokenSections++;
+            return 0;
+        }
+        //CRC over the whole section including CRC_32 field is 0 for valid sections
+        if (PSI::CRC32(m_Section, m_SectionLength) != 0) {
+            m_NumCRCErrors++;
+            return 0;
+        }
+        xStoreVersion();
+    }
+    m_NumSections++;
+    xProcessSection(m_Section, m_SectionLength);
+    return 1;
+}
+
+bool PSI_SectionAssembler::xIsKnownVersion() const {
+    const bool SectionSyntax = (m_Section[1] & 0x80) != 0;
+    const bool CurrentNext = (m_Section[5] & 0x01) != 0;
+    if (!SectionSyntax || !CurrentNext) return false;
+    const uint16_t TableIdExtension = (m_Section[3] << 8) | m_Section[4];
+    const uint8_t VersionNumber = (m_Section[5] & 0x3E) >> 1;
+    for (const SectionVersion &Version : m_Versions) {
+        if (Version.TableId == m_Section[0] && Version.TableIdExtension == TableIdExtension &&
+            Version.SectionNumber == m_Section[6])
+            return Version.VersionNumber == VersionNumber;
+    }
+    return false;
+}
+
+void PSI_SectionAssembler::xStoreVersion() {
+    if ((m_Section[5] & 0x01) == 0) return; //not applicable yet
+    const uint16_t TableIdExtension = (m_Section[3] << 8) | m_Section[4];
+    const uint8_t VersionNumber = (m_Section[5] & 0x3E) >> 1;
+    for (SectionVersion &Version : m_Versions) {
+        if (Version.TableId == m_Section[0] && Version.TableIdExtension == TableIdExtension &&
+            Version.SectionNumber == m_Section[6]) {
+            Version.VersionNumber = VersionNumber;
+            return;
+        }
+    }
+    m_Versions.push_back({m_Section[0], TableIdExtension, m_Section[6], VersionNumber});
+}
+
+//=============================================================================================================================================================================
+// PSI_PATHandler
+//=============================================================================================================================================================================
+void PSI_PATHandler::xProcessSection(const uint8_t *Section, uint32_t Length) {
+    if (Section[0] != PSI::eTableId_PAT || !(Section[1] & 0x80) ||
+        Length < PSI::LongSectionHeaderLength + PSI::CRC32Length) return;
+    m_TransportStreamId = (Section[3] << 8) | Section[4];
+    for (uint32_t Pos = PSI::LongSectionHeaderLength; Pos + 4 <= Length - PSI::CRC32Length; Pos += 4) {
+        PSI_Program Program;
+        Program.ProgramNumber = (Section[Pos] << 8) | Section[Pos + 1];
+        Program.PID = ((Section[Pos + 2] & 0x1F) << 8) | Section[Pos + 3];
+
+        bool Known = false;
+        for (PSI_Program &Existing : m_Programs) {
+            if (Existing.ProgramNumber == Program.ProgramNumber) {
+                Existing.PID = Program.PID;
+                Known = true;
+            }
+        }
+        if (!Known) m_Programs.push_back(Program);
+        if (Program.ProgramNumber != 0 && m_Demuxer->getHandler(Program.PID) == nullptr) xRegisterProgram(Program);
+    }
+}
+
+void PSI_PATHandler::xRegisterProgram(const PSI_Program &Program) {
+    m_Demuxer->AddHandler<PSI_PMTHandler>(Program.PID, m_Demuxer);
+}
+
+//=============================================================================================================================================================================
+// PSI_PMTHandler
+//=============================================================================================================================================================================
+void PSI_PMTHandler::xProcessSection(const uint8_t *Section, uint32_t Length) {
+    if (Section[0] != PSI::eTableId_PMT || !(Section[1] & 0x80) ||
+        Length < PSI::LongSectionHeaderLength + 4 + PSI::CRC32Length) return;
+    m_ProgramNumber = (Section[3] << 8) | Section[4];
+    m_PCR_PID = ((Section[8] & 0x1F) << 8) | Section[9];
+    const uint32_t ProgramInfoLength = ((Section[10] & 0x0F) << 8) | Section[11];
+    const uint32_t End = Length - PSI::CRC32Length;
+
+    m_Streams.clear();
+    for (uint32_t Pos = PSI::LongSectionHeaderLength + 4 + ProgramInfoLength; Pos + 5 <= End;) {
+        PSI_ElementaryStream Stream;
+        Stream.StreamType = Section[Pos];
+        Stream.PID = ((Section[Pos + 1] & 0x1F) << 8) | Section[Pos + 2];
+        const uint32_t ESInfoLength = ((Section[Pos + 3] & 0x0F) << 8) | Section[Pos + 4];
+        Pos += 5 + ESInfoLength;
+        m_Streams.push_back(Stream);
+        if (m_Demuxer->getHandler(Stream.PID) == nullptr) xRegisterStream(Stream);
+    }
+}
+
+void PSI_PMTHandler::xRegisterStream(const PSI_ElementaryStream &Stream) {
+    if (m_Demuxer->getStreamFactory()) {
+        TS_PacketHandler *Handler = m_Demuxer->getStreamFactory()->CreateStreamHandler(m_Demuxer, Stream.PID,
+                                                                                         Stream.StreamType);
+        if (Handler) m_Demuxer->AdoptHandler(Stream.PID, Handler);
+        return;
+    }
+    char FileName[32];
+    snprintf(FileName, sizeof(FileName), "pid%d.%s", Stream.PID, PSI::getStreamTypeExtension(Stream.StreamType));
+    m_Demuxer->AddHandler<TS_PesHandler>(Stream.PID, Stream.PID, FileName);
+}
+
+//=============================================================================================================================================================================
+// PSI_SinkStreamFactory
+//=============================================================================================================================================================================
+TS_PacketHandler *PSI_SinkStreamFactory::CreateStreamHandler(TS_Demuxer *, uint16_t PID, uint8_t StreamType) {
+    char FileName[32];
+    snprintf(FileName, sizeof(FileName), "pid%d.%s", PID, PSI::getStreamTypeExtension(StreamType));
+    return new TS_PesHandler(PID, TS_OutputSink::Create(FileName), m_ZeroCopy);
+}
+
+//=============================================================================================================================================================================
@@ -0,0 +1,133 @@
+#include "tsPacketHeaderBatch.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TS_AVX2_KERNEL 1
+#define TS_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#define TS_AVX2_KERNEL 1
+#define TS_AVX2_TARGET
+#else
+#define TS_AVX2_KERNEL 0
+#endif
+
+//=============================================================================================================================================================================
+// TS_PacketHeaderBatch
+//=============================================================================================================================================================================
+TS_PacketHeaderBatch::TS_PacketHeaderBatch(uint32_t Capacity) {
+    m_Kernel = isKernelSupported(eKernel::AVX2) ? eKernel::AVX2 : eKernel::Scalar;
+    xReserve(Capacity);
+}
+
+bool TS_PacketHeaderBatch::isKernelSupported(eKernel Kernel) {
+    switch (Kernel) {
+        case eKernel::Scalar:
+            return true;
+        case eKernel::AVX2:
+#if TS_AVX2_KERNEL && defined(__GNUC__)
+            return __builtin_cpu_supports("avx2");
+#elif TS_AVX2_KERNEL
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool TS_PacketHeaderBatch::setKernel(eKernel Kernel) {
+    if (!isKernelSupported(Kernel)) return false;
+    m_Kernel = Kernel;
+    return true;
+}
+
+void TS_PacketHeaderBatch::xReserve(uint32_t Capacity) {
+    if (Capacity <= SyncByte.size()) return;
+    SyncByte.resize(Capacity);
+    TransportErrorIndicator.resize(Capacity);
+    PayloadUnitStartIndicator.resize(Capacity);
+    TransportPriority.resize(Capacity);
+    PID.resize(Capacity);
+    TransportScramblingControl.resize(Capacity);
+    AdaptationFieldControl.resize(Capacity);
+    ContinuityCounter.resize(Capacity);
+}
+
+void TS_PacketHeaderBatch::Decode(const uint8_t *Data, uint32_t NumPackets, uint32_t Stride) {
+    TS_STATS_TIMER(HeaderParse);
+    xReserve(NumPackets);
+    m_NumPackets = NumPackets;
+    uint32_t Done = 0;
+    if (m_Kernel == eKernel::AVX2) Done = xDecodeAVX2(Data, NumPackets, Stride);
+    xDecodeScalar(Data, Done, NumPackets, Stride);
+}
+
+uint32_t TS_PacketHeaderBatch::SelectPID(uint16_t SelectedPID, uint32_t *Indexes) const {
+    uint32_t NumSelected = 0;
+    for (uint32_t i = 0; i < m_NumPackets; i++) {
+        Indexes[NumSelected] = i;
+        NumSelected += PID[i] == SelectedPID;
+    }
+    return NumSelected;
+}
+
+void TS_PacketHeaderBatch::xDecodeScalar(const uint8_t *Data, uint32_t Begin, uint32_t End, uint32_t Stride) {
+    for (uint32_t i = Begin; i < End; i++) {
+        uint32_t Header;
+        memcpy(&Header, Data + (size_t) i * Stride, sizeof(Header));
+        Header = xSwapBytes32(Header);
+        SyncByte[i] = (Header & 0xFF000000) >> 24;
+        TransportErrorIndicator[i] = (Header & 0x00800000) >> 23;
+        PayloadUnitStartIndicator[i] = (Header & 0x00400000) >> 22;
+        TransportPriority[i] = (Header & 0x00200000) >> 21;
+        PID[i] = (Header & 0x001FFF00) >> 8;
+        TransportScramblingControl[i] = (Header & 0x000000C0) >> 6;
+        AdaptationFieldControl[i] = (Header & 0x00000030) >> 4;
+        ContinuityCounter[i] = (Header & 0x0000000F);
+    }
+}
+
+#if TS_AVX2_KERNEL
+//narrows eight 32-bit lanes (values < 256) to bytes and stores them
+TS_AVX2_TARGET static inline void xStore8x8(uint8_t *Dst, __m256i Value) {
+    __m256i Packed16 = _mm256_permute4x64_epi64(_mm256_packus_epi32(Value, Value), 0x08);
+    __m128i Packed8 = _mm_packus_epi16(_mm256_castsi256_si128(Packed16), _mm256_castsi256_si128(Packed16));
+    _mm_storel_epi64((__m128i *) Dst, Packed8);
+}
+
+//narrows eight 32-bit lanes (values < 65536) to 16-bit words and stores them
+TS_AVX2_TARGET static inline void xStore8x16(uint16_t *Dst, __m256i Value) {
+    __m256i Packed16 = _mm256_permute4x64_epi64(_mm256_packus_epi32(Value, Value), 0x08);
+    _mm_storeu_si128((__m128i *) Dst, _mm256_castsi256_si128(Packed16));
+}
+
+TS_AVX2_TARGET uint32_t TS_PacketHeaderBatch::xDecodeAVX2(const uint8_t *Data, uint32_t NumPackets, uint32_t Stride) {
+    const int32_t S = (int32_t) Stride;
+    const __m256i Offsets = _mm256_setr_epi32(0, S, 2 * S, 3 * S, 4 * S, 5 * S, 6 * S, 7 * S);
+    const __m256i SwapMask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                              3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i Mask1 = _mm256_set1_epi32(0x1);
+    const __m256i Mask2 = _mm256_set1_epi32(0x3);
+    const __m256i Mask4 = _mm256_set1_epi32(0xF);
+    const __m256i Mask13 = _mm256_set1_epi32(0x1FFF);
+
+    uint32_t i = 0;
+    for (; i + 8 <= NumPackets; i += 8) {
+        const int *Base = (const int *) (Data + (size_t) i * Stride);
+        __m256i Header = _mm256_shuffle_epi8(_mm256_i32gather_epi32(Base, Offsets, 1), SwapMask);
+        xStore8x8(&SyncByte[i], _mm256_srli_epi32(Header, 24));
+        xStore8x8(&TransportErrorIndicator[i], _mm256_and_si256(_mm256_srli_epi32(Header, 23), Mask1));
+        xStore8x8(&PayloadUnitStartIndicator[i], _mm256_and_si256(_mm256_srli_epi32(Header, 22), Mask1));
+        xStore8x8(&TransportPriority[i], _mm256_and_si256(_mm256_srli_epi32(Header, 21), Mask1));
+        xStore8x16(&PID[i], _mm256_and_si256(_mm256_srli_epi32(Header, 8), Mask13));
+        xStore8x8(&TransportScramblingControl[i], _mm256_and_si256(_mm256_srli_epi32(Header, 6), Mask2));
+        xStore8x8(&AdaptationFieldControl[i], _mm256_and_si256(_mm256_srli_epi32(Header, 4), Mask2));
+        xStore8x8(&ContinuityCounter[i], _mm256_and_si256(Header, Mask4));
+    }
+    return i;
+}
+#else
+uint32_t TS_PacketHeaderBatch::xDecodeAVX2(const uint8_t *, uint32_t, uint32_t) { return 0; }
+#endif
+
+//=============================================================================================================================================================================
@@ -0,0 +1,243 @@
+#include "tsPacketSource.h"
+#include "tsUdpPacketSource.h"
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#define TS_HAS_MMAP 0
+#define O_BINARY_FLAG _O_BINARY
+static inline int64_t xReadFile(int Fd, void *Dst, uint32_t Size) { return _read(Fd, Dst, Size); }
+static inline int xOpenFile(const char *FileName) { return _open(FileName, _O_RDONLY | _O_BINARY); }
+static inline void xCloseFile(int Fd) { _close(Fd); }
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#define TS_HAS_MMAP 1
+static inline int64_t xReadFile(int Fd, void *Dst, uint32_t Size) { return ::read(Fd, Dst, Size); }
+static inline int xOpenFile(const char *FileName) { return ::open(FileName, O_RDONLY); }
+static inline void xCloseFile(int Fd) { ::close(Fd); }
+#endif
+
+//=============================================================================================================================================================================
+// TS_PacketSource
+//=============================================================================================================================================================================
+std::unique_ptr<TS_PacketSource> TS_PacketSource::Open(const char *FileName, uint32_t BatchSize) {
+    if (strcmp(FileName, "-") == 0) return std::unique_ptr<TS_PacketSource>(new TS_BlockPacketSource(0, BatchSize));
+    //udp://address:port or rtp://address:port (RTP is detected per datagram, both prefixes behave the same)
+    if (strncmp(FileName, "udp://", 6) == 0 || strncmp(FileName, "rtp://", 6) == 0) {
+        char Address[64] = {0};
+        const char *Colon = strrchr(FileName + 6, ':');
+        const size_t Length = Colon ? (size_t) (Colon - FileName - 6) : 0;
+        if (Length < sizeof(Address)) memcpy(Address, FileName + 6, Length);
+        return std::unique_ptr<TS_PacketSource>(
+                new TS_UdpPacketSource(Address, Colon ? (uint16_t) atoi(Colon + 1) : 0, nullptr, BatchSize));
+    }
+#if TS_HAS_MMAP
+    struct stat Stat;
+    if (stat(FileName, &Stat) == 0 && S_ISREG(Stat.st_mode) && Stat.st_size > 0)
+        return std::unique_ptr<TS_PacketSource>(new TS_MmapPacketSource(FileName, BatchSize));
+#endif
+    return std::unique_ptr<TS_PacketSource>(new TS_BlockPacketSource(FileName, BatchSize));
+}
+
+uint64_t TS_PacketSource::xExtractSpan(const uint8_t *Data, uint64_t Size, bool EndOfStream, TS_PacketSpan &Span) {
+    TS_STATS_TIMER(Sync);
+    Span.NumPackets = 0;
+    uint64_t Consumed = 0;
+    for (;;) {
+        if (!m_Locked) {
+            uint64_t Offset;
+            uint32_t PacketSize;
+            TS_SyncScanner::eResult Result = m_Scanner.FindLock(Data + Consumed, Size - Consumed, EndOfStream,
+                                                                Offset, PacketSize);
+            m_SkippedBytes += Offset;
+            Consumed += Offset;
+            if (Result != TS_SyncScanner::eResult::Locked) return Consumed;
+            m_Locked = true;
+            m_PacketSize = PacketSize;
+        }
+
+        const uint64_t Remaining = Size - Consumed;
+        uint32_t NumPackets = TS_SyncScanner::CountAligned(Data + Consumed, Remaining, m_PacketSize, m_BatchSize);
+        if (NumPackets == 0) {
+            if (Remaining < TS::TS_PacketLength) return Consumed; //incomplete packet - wait for more data
+            m_Locked = false;
+            m_NumSyncLosses++;
+            continue;
+        }
+
+        //CountAligned takes a packet once its 188 TS bytes are present - the trailing bytes of a 192/204 stride may
+        //still be missing. Only the last RS packet of a stream may lack its parity bytes, before the end such a
+        //packet is left for the next read.
+        uint64_t SpanBytes = (uint64_t) NumPackets * m_PacketSize;
+        if (SpanBytes > Remaining) {
+            if (EndOfStream) SpanBytes = Remaining;
+            else if (--NumPackets == 0) return Consumed;
+            else SpanBytes -= m_PacketSize;
+        }
+
+        Span.Data = Data + Consumed;
+        Span.NumPackets = NumPackets;
+        Span.Stride = m_PacketSize;
+        Span.FirstPacketIndex = m_NumPackets;
+        m_NumPackets += NumPackets;
+        return Consumed + SpanBytes;
+    }
+}
+
+//=============================================================================================================================================================================
+// TS_MemoryPacketSource
+//=============================================================================================================================================================================
+TS_MemoryPacketSource::TS_MemoryPacketSource(const uint8_t *Data, uint64_t Size, uint32_t BatchSize) {
+    m_Data = Data;
+    m_Size = Size;
+    m_BatchSize = BatchSize;
+    m_Good = Data != nullptr;
+}
+
+uint32_t TS_MemoryPacketSource::ReadBatch(TS_PacketSpan &Span) {
+    m_Offset += xExtractSpan(m_Data + m_Offset, m_Size - m_Offset, true, Span);
+    if (Span.NumPackets == 0) m_TrailingBytes = (uint32_t) (m_Size - m_Offset);
+    return Span.NumPackets;
+}
+
+//=============================================================================================================================================================================
+// TS_MappedFile
+//=============================================================================================================================================================================
+bool TS_MappedFile::Open(const char *FileName, bool Sequential) {
+    Close();
+#if TS_HAS_MMAP
+    int Fd = xOpenFile(FileName);
+    if (Fd < 0) return false;
+    struct stat Stat;
+    if (fstat(Fd, &Stat) == 0 && Stat.st_size > 0) {
+        void *Map = mmap(nullptr, Stat.st_size, PROT_READ, MAP_PRIVATE, Fd, 0);
+        if (Map != MAP_FAILED) {
+            if (Sequential) madvise(Map, Stat.st_size, MADV_SEQUENTIAL);
+            m_Data = (const uint8_t *) Map;
+            m_Size = Stat.st_size;
+        }
+    }
+    xCloseFile(Fd);
+#else
+    (void) FileName;
+    (void) Sequential;
+#endif
+    return m_Data != nullptr;
+}
+
+void TS_MappedFile::Close() {
+#if TS_HAS_MMAP
+    if (m_Data) munmap((void *) m_Data, m_Size);
+#endif
+    m_Data = nullptr;
+    m_Size = 0;
+}
+
+//=============================================================================================================================================================================
+// TS_MmapPacketSource
+//=============================================================================================================================================================================
+TS_MmapPacketSource::TS_MmapPacketSource(const char *FileName, uint32_t BatchSize) {
+    m_BatchSize = BatchSize;
+    if (!m_File.Open(FileName, true)) return;
+    m_Data = m_File.getData();
+    m_Size = m_File.getSize();
+    m_Good = true;
+}
+
+//=============================================================================================================================================================================
+// TS_BlockPacketSource
+//=============================================================================================================================================================================
+TS_BlockPacketSource::TS_BlockPacketSource(const char *FileName, uint32_t BatchSize) {
+    xInit(BatchSize);
+    m_FileDescriptor = xOpenFile(FileName);
+    m_OwnsDescriptor = true;
+    m_Good = m_FileDescriptor >= 0;
+}
+
+TS_BlockPacketSource::TS_BlockPacketSource(int FileDescriptor, uint32_t BatchSize) {
+    xInit(BatchSize);
+    m_FileDescriptor = FileDescriptor;
+    m_Good = m_FileDescriptor >= 0;
+}
+
+TS_BlockPacketSource::~TS_BlockPacketSource() {
+    //O_NONBLOCK belongs to the open file description - shared with whoever else uses the descriptor (stdin)
+    if (m_NonBlocking) setNonBlocking(false);
+    if (m_OwnsDescriptor && m_FileDescriptor >= 0) xCloseFile(m_FileDescriptor);
+    delete[] m_Buffer;
+}
+
+void TS_BlockPacketSource::xInit(uint32_t BatchSize) {
+    m_BatchSize = BatchSize;
+    //large enough for a full batch of RS packets and for confirming a lock
+    const uint32_t MinBatchSize = m_Scanner.getLockCount() + 1;
+    m_BufferSize = (BatchSize > MinBatchSize ? BatchSize : MinBatchSize) * TS::RS_PacketLength;
+    m_Buffer = new uint8_t[m_BufferSize];
+}
+
+void TS_BlockPacketSource::setNonBlocking(bool NonBlocking) {
+    m_NonBlocking = NonBlocking;
+#if !defined(_WIN32)
+    if (m_FileDescriptor < 0) return;
+    //flags found on the descriptor are restored when switching back (a descriptor opened non-blocking stays so)
+    if (m_OriginalFlags == NOT_VALID) m_OriginalFlags = fcntl(m_FileDescriptor, F_GETFL);
+    if (m_OriginalFlags >= 0)
+        fcntl(m_FileDescriptor, F_SETFL, NonBlocking ? m_OriginalFlags | O_NONBLOCK : m_OriginalFlags);
+#endif
+}
+
+int TS_BlockPacketSource::getPollDescriptor() const {
+#if defined(_WIN32)
+    return NOT_VALID;
+#else
+    struct stat Stat;
+    if (m_FileDescriptor < 0 || (fstat(m_FileDescriptor, &Stat) == 0 && S_ISREG(Stat.st_mode))) return NOT_VALID;
+    return m_FileDescriptor;
+#endif
+}
+
+uint32_t TS_BlockPacketSource::ReadBatch(TS_PacketSpan &Span) {
+    m_Pending = false;
+    for (;;) {
+        //carry over bytes not consumed by the previous span (incomplete packet, unconfirmed sync candidate)
+        const uint32_t Leftover = m_DataInBuffer - m_ConsumedBytes;
+        if (Leftover && m_ConsumedBytes) memmove(m_Buffer, m_Buffer + m_ConsumedBytes, Leftover);
+        m_DataInBuffer = Leftover;
+        m_ConsumedBytes = 0;
+
+        //pipes may return short reads - keep reading until the block is full or the stream ends (or, non-blocking,
+        //until nothing more is available)
+        bool WouldBlock = false;
+        while (m_Good && !m_EndOfStream && m_DataInBuffer < m_BufferSize) {
+            TS_STATS_TIMER(Read);
+            int64_t Read = xReadFile(m_FileDescriptor, m_Buffer + m_DataInBuffer, m_BufferSize - m_DataInBuffer);
+            if (Read > 0) m_DataInBuffer += (uint32_t) Read;
+            else if (Read == 0) m_EndOfStream = true;
+            else if (m_NonBlocking && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                WouldBlock = true;
+                break;
+            } else if (errno != EINTR) {
+                m_EndOfStream = true;
+                m_Good = false;
+            }
+        }
+
+        m_ConsumedBytes = (uint32_t) xExtractSpan(m_Buffer, m_DataInBuffer, m_EndOfStream, Span);
+        if (Span.NumPackets) return Span.NumPackets;
+        if (m_EndOfStream) {
+            m_TrailingBytes = m_DataInBuffer - m_ConsumedBytes;
+            return 0;
+        }
+        if (WouldBlock) {
+            m_Pending = true;
+            return 0;
+        }
+    }
+}
+
+//=============================================================================================================================================================================
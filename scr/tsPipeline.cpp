@@ -0,0 +1,238 @@
+#include "tsPipeline.h"
+#include "tsPacketHeaderBatch.h"
+#include "tsPSI.h"
+#include <cstring>
+#include <cstdio>
+#include <thread>
+
+//=============================================================================================================================================================================
+// PSI handlers of the decode thread - discovered streams are assigned to workers instead of being assembled locally
+//=============================================================================================================================================================================
+class xPipelinePMTHandler : public PSI_PMTHandler {
+protected:
+    TS_Pipeline *m_Pipeline;
+
+public:
+    xPipelinePMTHandler(TS_Demuxer *Demuxer, TS_Pipeline *Pipeline) : PSI_PMTHandler(Demuxer), m_Pipeline(Pipeline) {};
+
+protected:
+    void xRegisterStream(const PSI_ElementaryStream &Stream) override {
+        char FileName[32];
+        snprintf(FileName, sizeof(FileName), "pid%d.%s", Stream.PID, PSI::getStreamTypeExtension(Stream.StreamType));
+        m_Pipeline->RegisterStream(Stream.PID, FileName);
+    }
+};
+
+class xPipelinePATHandler : public PSI_PATHandler {
+protected:
+    TS_Pipeline *m_Pipeline;
+
+public:
+    xPipelinePATHandler(TS_Demuxer *Demuxer, TS_Pipeline *Pipeline) : PSI_PATHandler(Demuxer), m_Pipeline(Pipeline) {};
+
+protected:
+    void xRegisterProgram(const PSI_Program &Program) override {
+        m_Demuxer->AddHandler<xPipelinePMTHandler>(Program.PID, m_Demuxer, m_Pipeline);
+    }
+};
+
+//=============================================================================================================================================================================
+// TS_Pipeline
+//=============================================================================================================================================================================
+TS_Pipeline::TS_Pipeline(uint32_t NumWorkers, uint32_t BatchSize, uint32_t QueueDepth) {
+    m_NumWorkers = NumWorkers ? NumWorkers : 1;
+    m_BatchSize = BatchSize;
+    m_QueueDepth = QueueDepth;
+    for (int16_t &Worker : m_WorkerOfPID) Worker = NOT_VALID;
+
+    xInitStage(m_InputStage);
+    m_WorkerStages.resize(m_NumWorkers);
+    for (uint32_t w = 0; w < m_NumWorkers; w++) {
+        xInitStage(m_WorkerStages[w]);
+        m_WorkerDemuxers.emplace_back(new TS_Demuxer);
+    }
+}
+
+void TS_Pipeline::xInitStage(Stage &S) {
+    S.Full.reset(new TS_SpscRing<TS_PacketBatch *>(m_QueueDepth));
+    S.Free.reset(new TS_SpscRing<TS_PacketBatch *>(m_QueueDepth));
+    S.Batches.resize(m_QueueDepth);
+    S.Memory.reset(new uint8_t[(size_t) m_QueueDepth * m_BatchSize * TS::TS_PacketLength]);
+    S.Packets.reset(new const uint8_t *[(size_t) m_QueueDepth * m_BatchSize]);
+    for (uint32_t b = 0; b < m_QueueDepth; b++) {
+        S.Batches[b].Memory = S.Memory.get() + (size_t) b * m_BatchSize * TS::TS_PacketLength;
+        S.Batches[b].Data = S.Batches[b].Memory;
+        S.Free->TryPush(&S.Batches[b]);
+    }
+}
+
+void TS_Pipeline::xSetZeroCopy(bool ZeroCopy) {
+    m_ZeroCopy = ZeroCopy;
+    for (Stage &S : m_WorkerStages)
+        for (uint32_t b = 0; b < m_QueueDepth; b++)
+            S.Batches[b].Packets = ZeroCopy ? S.Packets.get() + (size_t) b * m_BatchSize : nullptr;
+}
+
+void TS_Pipeline::RegisterStream(uint16_t PID, const char *FileName) {
+    if (m_WorkerOfPID[PID] != NOT_VALID) return;
+    snprintf(m_Streams[PID].FileName, sizeof(m_Streams[PID].FileName), "%s", FileName);
+    m_WorkerOfPID[PID] = (int16_t) (m_NextWorker++ % m_NumWorkers);
+}
+
+void TS_Pipeline::setBufferLimits(const TS_BufferLimits &Limits) {
+    for (std::unique_ptr<TS_Demuxer> &Demuxer : m_WorkerDemuxers) Demuxer->setBufferLimits(Limits);
+}
+
+void TS_Pipeline::Run(TS_PacketSource *Source) {
+    xSetZeroCopy(Source->isPersistent());
+    std::vector<std::thread> Threads;
+    for (uint32_t w = 0; w < m_NumWorkers; w++) Threads.emplace_back(&TS_Pipeline::xWorker, this, w);
+    Threads.emplace_back(&TS_Pipeline::xDecoder, this);
+    Threads.emplace_back(&TS_Pipeline::xReader, this, Source);
+    for (std::thread &Thread : Threads) Thread.join();
+}
+
+TS_PacketBatch *TS_Pipeline::xPop(TS_SpscRing<TS_PacketBatch *> &Ring) {
+    return Ring.Pop();
+}
+
+TS_PacketBatch *TS_Pipeline::xPop(TS_SpscRing<TS_PacketBatch *> &Ring, uint64_t &NumStalls) {
+    TS_PacketBatch *Batch;
+    if (Ring.TryPop(Batch)) return Batch;
+    NumStalls++;
+    return Ring.Pop();
+}
+
+void TS_Pipeline::xPush(TS_SpscRing<TS_PacketBatch *> &Ring, TS_PacketBatch *Batch) {
+    Ring.Push(Batch);
+}
+
+void TS_Pipeline::xReader(TS_PacketSource *Source) {
+    TS_PacketSpan Span;
+    uint32_t SpanPos = 0;
+    bool EndOfStream = false;
+    while (!EndOfStream) {
+        TS_PacketBatch *Batch = xPop(*m_InputStage.Free, m_NumReaderStalls);
+        Batch->NumPackets = 0;
+        //persistent source - the batch is a window of the span
+        if (m_ZeroCopy) {
+            if (SpanPos == Span.NumPackets) {
+                SpanPos = 0;
+                EndOfStream = Source->ReadBatch(Span) == 0;
+            }
+            Batch->Data = Span.getPacket(SpanPos);
+            Batch->Stride = Span.Stride;
+            Batch->NumPackets = Span.NumPackets - SpanPos < m_BatchSize ? Span.NumPackets - SpanPos : m_BatchSize;
+            SpanPos += Batch->NumPackets;
+        }
+        while (!m_ZeroCopy && Batch->NumPackets < m_BatchSize) {
+            if (SpanPos == Span.NumPackets) {
+                SpanPos = 0;
+                if (Source->ReadBatch(Span) == 0) {
+                    EndOfStream = true;
+                    break;
+                }
+            }
+            //packets are copied without M2TS/RS extra bytes
+            uint32_t NumPackets = Span.NumPackets - SpanPos;
+            if (NumPackets > m_BatchSize - Batch->NumPackets) NumPackets = m_BatchSize - Batch->NumPackets;
+            uint8_t *Dst = Batch->Memory + (size_t) Batch->NumPackets * TS::TS_PacketLength;
+            if (Span.Stride == TS::TS_PacketLength)
+                memcpy(Dst, Span.getPacket(SpanPos), NumPackets * TS::TS_PacketLength);
+            else
+                for (uint32_t i = 0; i < NumPackets; i++)
+                    memcpy(Dst + (size_t) i * TS::TS_PacketLength, Span.getPacket(SpanPos + i), TS::TS_PacketLength);
+            Batch->NumPackets += NumPackets;
+            SpanPos += NumPackets;
+        }
+        m_NumPacketsRead += Batch->NumPackets;
+        Batch->EndOfStream = EndOfStream;
+        xPush(*m_InputStage.Full, Batch);
+        TS_STATS_QUEUE_DEPTH(m_InputStage.Full->getSize());
+    }
+}
+
+void TS_Pipeline::xDecoder() {
+    TS_Demuxer PSIDemuxer;
+    PSIDemuxer.AddHandler<xPipelinePATHandler>((uint16_t) TS_PacketHeader::ePID::PAT, &PSIDemuxer, this);
+    TS_PacketHeaderBatch Headers(m_BatchSize);
+    std::vector<TS_PacketBatch *> Output(m_NumWorkers, nullptr);
+
+    for (;;) {
+        TS_PacketBatch *Input = xPop(*m_InputStage.Full);
+        Headers.Decode(Input->Data, Input->NumPackets, Input->Stride);
+        const bool Measured = TS_STATS_ENABLED();
+        for (uint32_t i = 0; i < Input->NumPackets; i++) {
+            const uint16_t PID = Headers.PID[i];
+            if (PSIDemuxer.getHandler(PID) != nullptr) {
+                PSIDemuxer.DemuxPacket(Input->getPacket(i));
+                if (Measured) TS_STATS_PACKET(PID, TS_Demuxer::getPayloadSize(Input->getPacket(i)));
+                continue;
+            }
+            const int16_t Worker = m_WorkerOfPID[PID];
+            if (Worker == NOT_VALID) {
+                m_NumDroppedPackets++;
+                continue;
+            }
+            TS_PacketBatch *&Batch = Output[Worker];
+            if (Batch == nullptr) {
+                Batch = xPop(*m_WorkerStages[Worker].Free, m_NumDecoderStalls);
+                Batch->NumPackets = 0;
+                Batch->EndOfStream = false;
+            }
+            if (m_ZeroCopy) Batch->Packets[Batch->NumPackets++] = Input->getPacket(i);
+            else memcpy(Batch->Memory + (size_t) Batch->NumPackets++ * TS::TS_PacketLength, Input->getPacket(i),
+                        TS::TS_PacketLength);
+            if (Batch->NumPackets == m_BatchSize) {
+                xPush(*m_WorkerStages[Worker].Full, Batch);
+                TS_STATS_QUEUE_DEPTH(m_WorkerStages[Worker].Full->getSize());
+                Batch = nullptr;
+            }
+        }
+        const bool EndOfStream = Input->EndOfStream;
+        xPush(*m_InputStage.Free, Input);
+
+        //hand over partially filled batches to bound latency, finish workers at the end of the stream
+        for (uint32_t w = 0; w < m_NumWorkers; w++) {
+            if (EndOfStream && Output[w] == nullptr) {
+                Output[w] = xPop(*m_WorkerStages[w].Free, m_NumDecoderStalls);
+                Output[w]->NumPackets = 0;
+            }
+            if (Output[w] == nullptr) continue;
+            Output[w]->EndOfStream = EndOfStream;
+            xPush(*m_WorkerStages[w].Full, Output[w]);
+            TS_STATS_QUEUE_DEPTH(m_WorkerStages[w].Full->getSize());
+            Output[w] = nullptr;
+        }
+        if (EndOfStream) return;
+    }
+}
+
+void TS_Pipeline::xWorker(uint32_t Worker) {
+    TS_Demuxer &Demuxer = *m_WorkerDemuxers[Worker];
+    Stage &S = m_WorkerStages[Worker];
+    for (;;) {
+        TS_PacketBatch *Batch = xPop(*S.Full);
+        {
+            //timed per batch - parsing and PES assembly of the worker
+            TS_STATS_TIMER(PesAssembly);
+            const bool Measured = TS_STATS_ENABLED();
+            for (uint32_t i = 0; i < Batch->NumPackets; i++) {
+                const uint8_t *Packet = Batch->getPacket(i);
+                const uint16_t PID = ((Packet[1] & 0x1F) << 8) | Packet[2];
+                if (Demuxer.getHandler(PID) == nullptr)
+                    Demuxer.AddHandler<TS_PesHandler>(PID, PID, m_Streams[PID].FileName);
+                Demuxer.DemuxPacket(Packet);
+                if (Measured) TS_STATS_PACKET(PID, TS_Demuxer::getPayloadSize(Packet));
+            }
+        }
+        const bool EndOfStream = Batch->EndOfStream;
+        xPush(*S.Free, Batch);
+        if (EndOfStream) {
+            Demuxer.Flush();
+            return;
+        }
+    }
+}
+
+//=============================================================================================================================================================================
@@ -0,0 +1,426 @@
+#include "tsRemuxer.h"
+#include <cstring>
+
+//=============================================================================================================================================================================
+// PSI handlers - sections are passed to the remuxer instead of registering stream handlers
+//=============================================================================================================================================================================
+class xRemuxPMTHandler : public PSI_PMTHandler {
+protected:
+    TS_Remuxer *m_Remuxer;
+
+public:
+    xRemuxPMTHandler(TS_Demuxer *Demuxer, TS_Remuxer *Remuxer) : PSI_PMTHandler(Demuxer), m_Remuxer(Remuxer) {};
+
+protected:
+    void xProcessSection(const uint8_t *Section, uint32_t Length) override {
+        PSI_PMTHandler::xProcessSection(Section, Length);
+        if (Section[0] == PSI::eTableId_PMT) m_Remuxer->UpdatePMT(Section, Length);
+    }
+
+    void xRegisterStream(const PSI_ElementaryStream &) override {}
+};
+
+class xRemuxPATHandler : public PSI_PATHandler {
+protected:
+    TS_Remuxer *m_Remuxer;
+
+public:
+    xRemuxPATHandler(TS_Demuxer *Demuxer, TS_Remuxer *Remuxer) : PSI_PATHandler(Demuxer), m_Remuxer(Remuxer) {};
+
+protected:
+    void xProcessSection(const uint8_t *Section, uint32_t Length) override {
+        PSI_PATHandler::xProcessSection(Section, Length);
+        if (Section[0] == PSI::eTableId_PAT) m_Remuxer->UpdatePAT(*this);
+    }
+
+    void xRegisterProgram(const PSI_Program &Program) override {
+        m_Demuxer->AddHandler<xRemuxPMTHandler>(Program.PID, m_Demuxer, m_Remuxer);
+    }
+};
+
+//=============================================================================================================================================================================
+
+//NullBlockPackets contiguous null packets - padding is written as views of this block
+struct xNullBlock {
+    uint8_t Data[TS_Remuxer::NullBlockPackets * TS::TS_PacketLength];
+
+    xNullBlock() {
+        memset(Data, 0xFF, sizeof(Data));
+        for (uint32_t p = 0; p < TS_Remuxer::NullBlockPackets; p++) {
+            uint8_t *Packet = Data + p * TS::TS_PacketLength;
+            Packet[0] = TS::TS_SyncByte;
+            Packet[1] = 0x1F;
+            Packet[2] = 0xFF;
+            Packet[3] = 0x10;
+        }
+    }
+};
+
+static const xNullBlock NullBlock;
+
+//sets section_length of a section without CRC_32 and appends the CRC_32
+static void xFinishSection(std::vector<uint8_t> &Section) {
+    const uint32_t SectionLength = (uint32_t) Section.size() + PSI::CRC32Length - PSI::SectionHeaderLength;
+    Section[1] = (uint8_t) ((Section[1] & 0xF0) | ((SectionLength >> 8) & 0x0F));
+    Section[2] = (uint8_t) SectionLength;
+    const uint32_t CRC = PSI::CRC32(Section.data(), (uint32_t) Section.size());
+    for (int32_t s = 24; s >= 0; s -= 8) Section.push_back((uint8_t) (CRC >> s));
+}
+
+//=============================================================================================================================================================================
+// TS_Remuxer
+//=============================================================================================================================================================================
+TS_Remuxer::TS_Remuxer(TS_OutputSink *Sink) : m_Sink(Sink), m_Scratch(new uint8_t[ScratchSize]) {
+    for (uint32_t PID = 0; PID < NumPIDs; PID++) {
+        m_OutputPID[PID] = (uint16_t) PID;
+        m_Actions[PID] = eAction::Drop;
+        m_LastInputCC[PID] = NOT_VALID;
+        m_LastOutputCC[PID] = NOT_VALID;
+        m_Collided[PID] = false;
+    }
+    m_PSIDemuxer.AddHandler<xRemuxPATHandler>((uint16_t) TS_PacketHeader::ePID::PAT, &m_PSIDemuxer, this);
+}
+
+bool TS_Remuxer::RemapPID(uint16_t From, uint16_t To) {
+    const uint16_t PAT = (uint16_t) TS_PacketHeader::ePID::PAT;
+    const uint16_t Null = (uint16_t) TS_PacketHeader::ePID::NuLL;
+    if (From == PAT || To == PAT || From >= Null || To >= Null) return false;
+    m_OutputPID[From] = To;
+    return true;
+}
+
+void TS_Remuxer::Remux(const TS_PacketSpan &Span) {
+    //actions of SelectPID / null packets are needed before any PSI arrives
+    if (m_NumPacketsIn == 0) xRebuild();
+    for (uint32_t i = 0; i < Span.NumPackets; i++) xRemuxPacket(Span.getPacket(i));
+    xWrite();
+}
+
+bool TS_Remuxer::Run(TS_PacketSource &Source) {
+    TS_PacketSpan Span;
+    while (Source.ReadBatch(Span)) Remux(Span);
+    return Flush();
+}
+
+bool TS_Remuxer::Flush() {
+    xWrite();
+    if (m_Sink && !m_Sink->Flush()) m_Good = false;
+    return isGood();
+}
+
+void TS_Remuxer::UpdatePAT(const PSI_PATHandler &Handler) {
+    m_TransportStreamId = Handler.getTransportStreamId();
+    for (const PSI_Program &Announced : Handler.getPrograms()) {
+        if (Announced.ProgramNumber == 0 || !xIsSelected(Announced.ProgramNumber)) continue;
+        bool Known = false;
+        for (Program &P : m_Programs) {
+            if (P.ProgramNumber != Announced.ProgramNumber) continue;
+            Known = true;
+            //moved PMT - the new one has to be received first
+            if (P.PMT_PID != Announced.PID) {
+                P.PMT_PID = Announced.PID;
+                P.Section.clear();
+                P.PMT.clear();
+                P.PIDs.clear();
+            }
+        }
+        if (!Known) {
+            m_Programs.emplace_back();
+            m_Programs.back().ProgramNumber = Announced.ProgramNumber;
+            m_Programs.back().PMT_PID = Announced.PID;
+        }
+    }
+    xRebuild();
+}
+
+void TS_Remuxer::UpdatePMT(const uint8_t *Section, uint32_t Length) {
+    if (Length < PSI::LongSectionHeaderLength + 4 + PSI::CRC32Length) return;
+    const uint16_t ProgramNumber = (Section[3] << 8) | Section[4];
+    Program *P = nullptr;
+    for (Program &Candidate : m_Programs)
+        if (Candidate.ProgramNumber == ProgramNumber) P = &Candidate;
+    if (P == nullptr) return;
+
+    const uint32_t ProgramInfoLength = ((Section[10] & 0x0F) << 8) | Section[11];
+    const uint32_t End = Length - PSI::CRC32Length;
+    uint32_t Pos = PSI::LongSectionHeaderLength + 4 + ProgramInfoLength;
+    if (Pos > End) return;
+
+    //input section kept - the output PMT depends on the PIDs which won their output PID (xRebuild)
+    P->PCR_PID = ((Section[8] & 0x1F) << 8) | Section[9];
+    P->PIDs.clear();
+    P->Section.assign(Section, Section + Length);
+    while (Pos + 5 <= End) {
+        const uint16_t PID = ((Section[Pos + 1] & 0x1F) << 8) | Section[Pos + 2];
+        const uint32_t EntryLength = 5 + (((Section[Pos + 3] & 0x0F) << 8) | Section[Pos + 4]);
+        if (Pos + EntryLength > End) break;
+        if (!m_ExcludedPIDs[PID]) P->PIDs.push_back(PID);
+        Pos += EntryLength;
+    }
+    xRebuild();
+}
+
+bool TS_Remuxer::xIsSelected(uint16_t ProgramNumber) const {
+    if (m_SelectedPrograms.empty()) return true;
+    for (uint16_t Selected : m_SelectedPrograms)
+        if (Selected == ProgramNumber) return true;
+    return false;
+}
+
+void TS_Remuxer::xRebuild() {
+    const uint16_t Null = (uint16_t) TS_PacketHeader::ePID::NuLL;
+    const uint16_t PAT_PID = (uint16_t) TS_PacketHeader::ePID::PAT;
+    for (uint32_t PID = 0; PID < NumPIDs; PID++) m_Actions[PID] = m_SelectedPIDs[PID] ? eAction::Forward : eAction::Drop;
+    m_Actions[Null] = m_StripNull || m_TargetBitrate ? eAction::Drop : eAction::Forward;
+    for (const Program &P : m_Programs) {
+        if (P.Section.empty()) continue;
+        for (uint16_t PID : P.PIDs) m_Actions[PID] = eAction::Forward;
+        if (P.PCR_PID != Null) m_Actions[P.PCR_PID] = eAction::Forward;
+    }
+    for (uint32_t PID = 0; PID < NumPIDs; PID++)
+        if (m_ExcludedPIDs[PID]) m_Actions[PID] = eAction::Drop;
+
+    //an output PID carries a single input PID - two streams merged onto one PID would share a continuity_counter
+    //sequence (and a PMT entry). Output PIDs are claimed by the PAT and PMTs first, then by PIDs keeping their
+    //number, then by remapped PIDs in ascending order; a PID finding its output PID taken is dropped and counted.
+    std::vector<uint16_t> Owner(NumPIDs, Null);
+    Owner[PAT_PID] = PAT_PID;
+    m_Actions[PAT_PID] = eAction::PAT;
+    for (Program &P : m_Programs) {
+        P.Collided = !xClaim(Owner, P.PMT_PID);
+        if (!P.Collided) m_Actions[P.PMT_PID] = eAction::PMT;
+        else {
+            P.PMT.clear();
+            if (m_Actions[P.PMT_PID] != eAction::PMT) m_Actions[P.PMT_PID] = eAction::Drop;
+        }
+    }
+    for (uint32_t Pass = 0; Pass < 2; Pass++) {
+        for (uint32_t PID = 0; PID < Null; PID++) {
+            if (m_Actions[PID] != eAction::Forward || (m_OutputPID[PID] == PID) != (Pass == 0)) continue;
+            if (!xClaim(Owner, (uint16_t) PID)) m_Actions[PID] = eAction::Drop;
+        }
+    }
+
+    m_PcrPID = Null;
+    for (Program &P : m_Programs) {
+        if (P.Collided || P.Section.empty()) continue;
+        if (m_PcrPID == Null && P.PCR_PID != Null && m_Actions[P.PCR_PID] == eAction::Forward) m_PcrPID = P.PCR_PID;
+        xBuildPMT(P, Owner);
+    }
+
+    //PAT of the selected programs, new version only if the program list changed
+    if (m_Programs.empty()) return;
+    std::vector<uint8_t> PAT = {PSI::eTableId_PAT, 0xB0, 0, (uint8_t) (m_TransportStreamId >> 8),
+                                (uint8_t) m_TransportStreamId, (uint8_t) (0xC1 | (m_PatVersion << 1)), 0, 0};
+    for (const Program &P : m_Programs) {
+        if (P.Collided) continue;
+        const uint16_t PMT_PID = m_OutputPID[P.PMT_PID];
+        PAT.push_back((uint8_t) (P.ProgramNumber >> 8));
+        PAT.push_back((uint8_t) P.ProgramNumber);
+        PAT.push_back((uint8_t) (0xE0 | (PMT_PID >> 8)));
+        PAT.push_back((uint8_t) PMT_PID);
+    }
+    xFinishSection(PAT);
+    if (m_PAT.empty() || PAT == m_PAT) {
+        m_PAT.swap(PAT);
+        return;
+    }
+    m_PatVersion = (m_PatVersion + 1) & 0x1F;
+    PAT[5] = (uint8_t) (0xC1 | (m_PatVersion << 1));
+    PAT.resize(PAT.size() - PSI::CRC32Length);
+    xFinishSection(PAT);
+    m_PAT.swap(PAT);
+}
+
+bool TS_Remuxer::xClaim(std::vector<uint16_t> &Owner, uint16_t PID) {
+    const uint16_t Null = (uint16_t) TS_PacketHeader::ePID::NuLL;
+    uint16_t &OutputOwner = Owner[m_OutputPID[PID]];
+    if (OutputOwner == Null || OutputOwner == PID) {
+        OutputOwner = PID;
+        return true;
+    }
+    if (!m_Collided[PID]) {
+        m_Collided[PID] = true;
+        m_NumPidCollisions++;
+    }
+    return false;
+}
+
+void TS_Remuxer::xBuildPMT(Program &P, const std::vector<uint16_t> &Owner) {
+    const uint8_t *Section = P.Section.data();
+    const uint32_t Length = (uint32_t) P.Section.size();
+    const uint32_t ProgramInfoLength = ((Section[10] & 0x0F) << 8) | Section[11];
+    const uint32_t End = Length - PSI::CRC32Length;
+    uint32_t Pos = PSI::LongSectionHeaderLength + 4 + ProgramInfoLength;
+
+    //header and program descriptors are kept, PIDs remapped, excluded and dropped streams left out
+    const uint16_t Null = (uint16_t) TS_PacketHeader::ePID::NuLL;
+    auto Lost = [&](uint16_t PID) {
+        const uint16_t OutputOwner = Owner[m_OutputPID[PID]];
+        return OutputOwner != Null && OutputOwner != PID;
+    };
+    std::vector<uint8_t> &PMT = P.PMT;
+    PMT.assign(Section, Section + Pos);
+    const uint16_t OutputPCR_PID = P.PCR_PID != Null && Lost(P.PCR_PID) ? Null : m_OutputPID[P.PCR_PID];
+    PMT[8] = (uint8_t) ((PMT[8] & 0xE0) | (OutputPCR_PID >> 8));
+    PMT[9] = (uint8_t) OutputPCR_PID;
+    while (Pos + 5 <= End) {
+        const uint16_t PID = ((Section[Pos + 1] & 0x1F) << 8) | Section[Pos + 2];
+        const uint32_t EntryLength = 5 + (((Section[Pos + 3] & 0x0F) << 8) | Section[Pos + 4]);
+        if (Pos + EntryLength > End) break;
+        if (!m_ExcludedPIDs[PID] && !Lost(PID)) {
+            const size_t Entry = PMT.size();
+            PMT.insert(PMT.end(), Section + Pos, Section + Pos + EntryLength);
+            PMT[Entry + 1] = (uint8_t) ((PMT[Entry + 1] & 0xE0) | (m_OutputPID[PID] >> 8));
+            PMT[Entry + 2] = (uint8_t) m_OutputPID[PID];
+        }
+        Pos += EntryLength;
+    }
+    xFinishSection(PMT);
+}
+
+void TS_Remuxer::xRemuxPacket(const uint8_t *Packet) {
+    m_NumPacketsIn++;
+    xHeader Header;
+    Header.Parse(Packet);
+    const uint16_t PID = Header.getPID();
+    //regenerated tables replace the input ones - sent when an input section ends (same repetition rate)
+    bool SectionEnd = false;
+    if (m_PSIDemuxer.getHandler(PID) != nullptr) {
+        const PSI_SectionAssembler *Assembler = static_cast<const PSI_SectionAssembler *>(m_PSIDemuxer.getHandler(PID));
+        const uint64_t NumSections = Assembler->getNumSections() + Assembler->getNumSkippedSections();
+        m_PSIDemuxer.DemuxPacket(Packet);
+        SectionEnd = Assembler->getNumSections() + Assembler->getNumSkippedSections() != NumSections;
+    }
+
+    switch (m_Actions[PID]) {
+        case eAction::Drop:
+            return;
+        case eAction::PAT:
+            if (SectionEnd && !m_PAT.empty()) xEmitSection(m_PAT, PID);
+            return;
+        case eAction::PMT:
+            if (SectionEnd)
+                for (const Program &P : m_Programs)
+                    if (P.PMT_PID == PID && !P.PMT.empty()) xEmitSection(P.PMT, m_OutputPID[PID]);
+            return;
+        case eAction::Forward:
+            break;
+    }
+    if (PID == (uint16_t) TS_PacketHeader::ePID::NuLL) {
+        m_NumPacketsOut++;
+        xEmit(Packet, TS::TS_PacketLength);
+        return;
+    }
+    if (m_TargetBitrate && PID == m_PcrPID && Header.getPCR() != NOT_VALID)
+        xPad(Header.getPCR(), Header.getDiscontinuityIndicator());
+
+    const bool HasPayload = (Header.getAdaptationFieldControl() & 1) != 0;
+    const uint8_t CC = Header.getContinuityCounter();
+    //counter step of the input - 0 for packets without payload and duplicates, >1 after a loss
+    uint8_t Step = 0;
+    if (HasPayload) {
+        Step = m_LastInputCC[PID] == NOT_VALID ? 1 : (uint8_t) ((CC - m_LastInputCC[PID]) & 0xF);
+        m_LastInputCC[PID] = (int8_t) CC;
+    }
+    const uint16_t OutputPID = m_OutputPID[PID];
+    const uint8_t OutputCC = xNextCC(OutputPID, Step, CC);
+    m_NumPacketsOut++;
+    if (OutputPID == PID && OutputCC == CC) {
+        xEmit(Packet, TS::TS_PacketLength);
+        return;
+    }
+    //new header, payload still taken from the input
+    uint8_t *NewHeader = xScratch(TS::TS_HeaderLength);
+    NewHeader[0] = Packet[0];
+    NewHeader[1] = (uint8_t) ((Packet[1] & 0xE0) | (OutputPID >> 8));
+    NewHeader[2] = (uint8_t) OutputPID;
+    NewHeader[3] = (uint8_t) ((Packet[3] & 0xF0) | OutputCC);
+    xEmit(NewHeader, TS::TS_HeaderLength);
+    xEmit(Packet + TS::TS_HeaderLength, TS::TS_PacketLength - TS::TS_HeaderLength);
+    m_NumRewrittenPackets++;
+}
+
+uint8_t TS_Remuxer::xNextCC(uint16_t OutputPID, uint8_t Step, uint8_t InputCC) {
+    int8_t &LastCC = m_LastOutputCC[OutputPID];
+    //the first packet keeps its counter - a PID with a single source is forwarded unchanged
+    if (LastCC == NOT_VALID) LastCC = (int8_t) InputCC;
+    else LastCC = (int8_t) ((LastCC + Step) & 0xF);
+    return (uint8_t) LastCC;
+}
+
+void TS_Remuxer::xPad(int64_t PCR, bool Discontinuity) {
+    //PCR wraps at 2^33 * 300
+    const int64_t PcrPeriod = ((int64_t) 1 << 33) * 300;
+    const int64_t Delta = m_LastPCR == NOT_VALID ? NOT_VALID : ((PCR - m_LastPCR) % PcrPeriod + PcrPeriod) % PcrPeriod;
+    const uint64_t BitsPerPacketPeriod = (uint64_t) TS::ExtendedClockFrequency_Hz * TS::TS_PacketLength * 8;
+    if (Discontinuity || Delta == NOT_VALID || Delta > MaxPcrGap) {
+        m_PaddingRemainder = 0;
+    } else {
+        //packets the interval should have at the target bitrate, remainder carried to avoid drift
+        const uint64_t Scaled = (uint64_t) Delta * m_TargetBitrate + m_PaddingRemainder;
+        const uint64_t Expected = Scaled / BitsPerPacketPeriod;
+        m_PaddingRemainder = Scaled % BitsPerPacketPeriod;
+        const uint64_t Sent = m_NumPacketsOut - m_LastPcrPacket;
+        if (Sent > Expected) m_NumBitrateOverruns++;
+        for (uint64_t Missing = Sent < Expected ? Expected - Sent : 0; Missing;) {
+            const uint32_t NumPackets = Missing < NullBlockPackets ? (uint32_t) Missing : NullBlockPackets;
+            xEmit(NullBlock.Data, NumPackets * TS::TS_PacketLength);
+            m_NumPacketsOut += NumPackets;
+            m_NumPaddingPackets += NumPackets;
+            Missing -= NumPackets;
+        }
+    }
+    m_LastPCR = PCR;
+    m_LastPcrPacket = m_NumPacketsOut;
+}
+
+void TS_Remuxer::xEmit(const uint8_t *Data, uint32_t Size) {
+    //consecutive input packets become one view
+    if (!m_Views.empty() && m_Views.back().Data + m_Views.back().Size == Data) {
+        m_Views.back().Size += Size;
+        return;
+    }
+    m_Views.push_back({Data, Size});
+}
+
+void TS_Remuxer::xEmitSection(const std::vector<uint8_t> &Section, uint16_t OutputPID) {
+    const uint32_t Size = (uint32_t) Section.size();
+    uint32_t Pos = 0;
+    bool First = true;
+    while (First || Pos < Size) {
+        uint8_t *Packet = xScratch(TS::TS_PacketLength);
+        Packet[0] = TS::TS_SyncByte;
+        Packet[1] = (uint8_t) ((First ? 0x40 : 0x00) | (OutputPID >> 8));
+        Packet[2] = (uint8_t) OutputPID;
+        Packet[3] = (uint8_t) (0x10 | xNextCC(OutputPID, 1, 0));
+        uint32_t Offset = TS::TS_HeaderLength;
+        if (First) Packet[Offset++] = 0; //pointer_field
+        const uint32_t Len = Size - Pos < TS::TS_PacketLength - Offset ? Size - Pos : TS::TS_PacketLength - Offset;
+        memcpy(Packet + Offset, Section.data() + Pos, Len);
+        memset(Packet + Offset + Len, PSI::StuffingByte, TS::TS_PacketLength - Offset - Len);
+        xEmit(Packet, TS::TS_PacketLength);
+        m_NumPsiPackets++;
+        m_NumPacketsOut++;
+        Pos += Len;
+        First = false;
+    }
+}
+
+uint8_t *TS_Remuxer::xScratch(uint32_t Size) {
+    //views gathered so far are written to free the scratch memory they reference
+    if (m_ScratchUsed + Size > ScratchSize) xWrite();
+    uint8_t *Data = m_Scratch.get() + m_ScratchUsed;
+    m_ScratchUsed += Size;
+    return Data;
+}
+
+void TS_Remuxer::xWrite() {
+    if (!m_Views.empty()) {
+        if (!m_Sink || !m_Sink->Write(m_Views.data(), (uint32_t) m_Views.size(), false)) m_Good = false;
+        m_Views.clear();
+    }
+    m_ScratchUsed = 0;
+}
+
+//=============================================================================================================================================================================
@@ -0,0 +1,249 @@
+#include "tsStats.h"
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+//=============================================================================================================================================================================
+// TS_Stats
+//=============================================================================================================================================================================
+//counter blocks of running threads, blocks of finished threads are added to s_Retired and freed
+static std::mutex s_RegistryMutex;
+static std::vector<TS_Stats::ThreadCounters *> s_Registry;
+static TS_Stats::ThreadCounters s_Retired;
+static uint32_t s_NumRetiredThreads = 0;
+
+struct TS_Stats::ThreadOwner {
+    ThreadCounters *Counters = nullptr;
+
+    ~ThreadOwner() {
+        if (Counters == nullptr) return;
+        std::lock_guard<std::mutex> Lock(s_RegistryMutex);
+        for (uint32_t s = 0; s < NumStages; s++) {
+            s_Retired.StageCycles[s].Add(Counters->StageCycles[s].get());
+            s_Retired.StageCalls[s].Add(Counters->StageCalls[s].get());
+        }
+        for (uint32_t p = 0; p < NumPIDs; p++) {
+            s_Retired.PidPackets[p].Add(Counters->PidPackets[p].get());
+            s_Retired.PidBytes[p].Add(Counters->PidBytes[p].get());
+            s_Retired.PidPES[p].Add(Counters->PidPES[p].get());
+        }
+        s_Retired.NumAllocations.Add(Counters->NumAllocations.get());
+        s_Retired.QueueDepthSum.Add(Counters->QueueDepthSum.get());
+        s_Retired.NumQueueDepthSamples.Add(Counters->NumQueueDepthSamples.get());
+        s_Retired.MaxQueueDepth.Max(Counters->MaxQueueDepth.get());
+        s_NumRetiredThreads++;
+        for (size_t i = 0; i < s_Registry.size(); i++) {
+            if (s_Registry[i] != Counters) continue;
+            s_Registry[i] = s_Registry.back();
+            s_Registry.pop_back();
+            break;
+        }
+        delete Counters;
+        Counters = nullptr;
+        t_Counters = nullptr;
+    }
+};
+
+std::atomic<bool> TS_Stats::s_Enabled{false};
+thread_local TS_Stats::ThreadCounters *TS_Stats::t_Counters = nullptr;
+thread_local TS_Stats::ThreadOwner TS_Stats::t_Owner;
+
+//reference points for cycles -> seconds, taken on the first enable
+static std::atomic<bool> s_Started{false};
+static uint64_t s_StartCycles = 0;
+static std::chrono::steady_clock::time_point s_StartTime;
+
+static const char *StageNames[TS_Stats::NumStages] = {"read", "sync", "header_parse", "adaptation_field_parse",
+                                                      "pes_assembly", "output"};
+
+bool TS_Stats::setEnabled(bool Enabled) {
+    if (!isCompiled()) return false;
+    if (Enabled && !s_Started.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> Lock(s_RegistryMutex);
+        if (!s_Started.load(std::memory_order_relaxed)) {
+            s_StartTime = std::chrono::steady_clock::now();
+            s_StartCycles = ReadCycles();
+            s_Started.store(true, std::memory_order_release);
+        }
+    }
+    s_Enabled.store(Enabled, std::memory_order_relaxed);
+    return Enabled;
+}
+
+TS_Stats::ThreadCounters *TS_Stats::xRegisterThread() {
+    ThreadCounters *Counters = new ThreadCounters;
+    {
+        std::lock_guard<std::mutex> Lock(s_RegistryMutex);
+        s_Registry.push_back(Counters);
+    }
+    t_Owner.Counters = Counters;
+    return Counters;
+}
+
+uint64_t TS_Stats::xReadClock_ns() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const char *TS_Stats::getStageName(eStage Stage) {
+    return (uint32_t) Stage < NumStages ? StageNames[(uint32_t) Stage] : "unknown";
+}
+
+void TS_Stats::getSnapshot(Snapshot &S) {
+    for (uint32_t s = 0; s < NumStages; s++) S.StageCycles[s] = S.StageCalls[s] = 0;
+    S.PIDs.clear();
+    S.NumAllocations = 0;
+    S.MaxQueueDepth = 0;
+    S.AvgQueueDepth = 0;
+    S.CyclesPerSecond = 0;
+    S.Uptime = 0;
+    uint64_t QueueDepthSum = 0;
+    uint64_t NumQueueDepthSamples = 0;
+
+    std::lock_guard<std::mutex> Lock(s_RegistryMutex);
+    S.NumThreads = (uint32_t) s_Registry.size() + s_NumRetiredThreads;
+    std::vector<PidSnapshot> PIDs(NumPIDs);
+    auto Merge = [&](const ThreadCounters *Counters) {
+        for (uint32_t s = 0; s < NumStages; s++) {
+            S.StageCycles[s] += Counters->StageCycles[s].get();
+            S.StageCalls[s] += Counters->StageCalls[s].get();
+        }
+        for (uint32_t p = 0; p < NumPIDs; p++) {
+            PIDs[p].Packets += Counters->PidPackets[p].get();
+            PIDs[p].Bytes += Counters->PidBytes[p].get();
+            PIDs[p].PES += Counters->PidPES[p].get();
+        }
+        S.NumAllocations += Counters->NumAllocations.get();
+        QueueDepthSum += Counters->QueueDepthSum.get();
+        NumQueueDepthSamples += Counters->NumQueueDepthSamples.get();
+        if (Counters->MaxQueueDepth.get() > S.MaxQueueDepth) S.MaxQueueDepth = Counters->MaxQueueDepth.get();
+    };
+    Merge(&s_Retired);
+    for (const ThreadCounters *Counters : s_Registry) Merge(Counters);
+    for (uint32_t p = 0; p < NumPIDs; p++) {
+        if (PIDs[p].Packets == 0 && PIDs[p].PES == 0) continue;
+        PIDs[p].PID = (uint16_t) p;
+        S.PIDs.push_back(PIDs[p]);
+    }
+    if (NumQueueDepthSamples) S.AvgQueueDepth = (double) QueueDepthSum / NumQueueDepthSamples;
+
+    if (s_Started.load(std::memory_order_acquire)) {
+        S.Uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - s_StartTime).count();
+        if (S.Uptime > 0) S.CyclesPerSecond = (double) (ReadCycles() - s_StartCycles) / S.Uptime;
+    }
+    for (uint32_t s = 0; s < NumStages; s++)
+        S.StageSeconds[s] = S.CyclesPerSecond > 0 ? S.StageCycles[s] / S.CyclesPerSecond : 0;
+}
+
+std::string TS_Stats::FormatPrometheus(const Snapshot &S) {
+    std::string Text;
+    char Line[256];
+    auto Header = [&Text](const char *Name, const char *Type, const char *Help) {
+        Text += "# HELP ";
+        Text += Name;
+        Text += ' ';
+        Text += Help;
+        Text += "\n# TYPE ";
+        Text += Name;
+        Text += ' ';
+        Text += Type;
+        Text += '\n';
+    };
+
+    Header("ts_stage_cycles_total", "counter", "TSC cycles spent in a parsing stage (inclusive)");
+    for (uint32_t s = 0; s < NumStages; s++) {
+        snprintf(Line, sizeof(Line), "ts_stage_cycles_total{stage=\"%s\"} %" PRIu64 "\n", StageNames[s],
+                 S.StageCycles[s]);
+        Text += Line;
+    }
+    Header("ts_stage_seconds_total", "counter", "Time spent in a parsing stage (inclusive)");
+    for (uint32_t s = 0; s < NumStages; s++) {
+        snprintf(Line, sizeof(Line), "ts_stage_seconds_total{stage=\"%s\"} %.9f\n", StageNames[s],
+                 S.StageSeconds[s]);
+        Text += Line;
+    }
+    Header("ts_stage_calls_total", "counter", "Timed calls of a parsing stage");
+    for (uint32_t s = 0; s < NumStages; s++) {
+        snprintf(Line, sizeof(Line), "ts_stage_calls_total{stage=\"%s\"} %" PRIu64 "\n", StageNames[s],
+                 S.StageCalls[s]);
+        Text += Line;
+    }
+
+    Header("ts_pid_packets_total", "counter", "Transport stream packets per PID");
+    for (const PidSnapshot &P : S.PIDs) {
+        snprintf(Line, sizeof(Line), "ts_pid_packets_total{pid=\"%u\"} %" PRIu64 "\n", P.PID, P.Packets);
+        Text += Line;
+    }
+    Header("ts_pid_payload_bytes_total", "counter", "Transport stream payload bytes per PID");
+    for (const PidSnapshot &P : S.PIDs) {
+        snprintf(Line, sizeof(Line), "ts_pid_payload_bytes_total{pid=\"%u\"} %" PRIu64 "\n", P.PID, P.Bytes);
+        Text += Line;
+    }
+    Header("ts_pid_pes_total", "counter", "PES packets started per PID");
+    for (const PidSnapshot &P : S.PIDs) {
+        snprintf(Line, sizeof(Line), "ts_pid_pes_total{pid=\"%u\"} %" PRIu64 "\n", P.PID, P.PES);
+        Text += Line;
+    }
+
+    Header("ts_allocations_total", "counter", "PES buffer allocations");
+    snprintf(Line, sizeof(Line), "ts_allocations_total %" PRIu64 "\n", S.NumAllocations);
+    Text += Line;
+    Header("ts_queue_depth_max", "gauge", "Maximum pipeline queue depth (batches)");
+    snprintf(Line, sizeof(Line), "ts_queue_depth_max %" PRIu64 "\n", S.MaxQueueDepth);
+    Text += Line;
+    Header("ts_queue_depth_avg", "gauge", "Average pipeline queue depth (batches)");
+    snprintf(Line, sizeof(Line), "ts_queue_depth_avg %.3f\n", S.AvgQueueDepth);
+    Text += Line;
+    Header("ts_threads", "gauge", "Threads which reported statistics");
+    snprintf(Line, sizeof(Line), "ts_threads %u\n", S.NumThreads);
+    Text += Line;
+    Header("ts_cycles_per_second", "gauge", "Measured TSC frequency");
+    snprintf(Line, sizeof(Line), "ts_cycles_per_second %.0f\n", S.CyclesPerSecond);
+    Text += Line;
+    Header("ts_uptime_seconds", "gauge", "Time since statistics were enabled");
+    snprintf(Line, sizeof(Line), "ts_uptime_seconds %.3f\n", S.Uptime);
+    Text += Line;
+    return Text;
+}
+
+bool TS_Stats::WritePrometheus(const char *FileName) {
+    Snapshot S;
+    getSnapshot(S);
+    const std::string Text = FormatPrometheus(S);
+    const std::string TempName = std::string(FileName) + ".tmp";
+    FILE *File = fopen(TempName.c_str(), "wb");
+    if (File == nullptr) return false;
+    const bool Written = fwrite(Text.data(), 1, Text.size(), File) == Text.size();
+    if (fclose(File) != 0 || !Written) {
+        remove(TempName.c_str());
+        return false;
+    }
+    return rename(TempName.c_str(), FileName) == 0;
+}
+
+//=============================================================================================================================================================================
+// TS_StatsDumper
+//=============================================================================================================================================================================
+TS_StatsDumper::TS_StatsDumper(const char *FileName, uint32_t Interval_ms)
+        : m_FileName(FileName), m_Interval_ms(Interval_ms ? Interval_ms : 1000) {
+    m_Thread = std::thread(&TS_StatsDumper::xRun, this);
+}
+
+void TS_StatsDumper::Stop() {
+    if (!m_Thread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> Lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_Wakeup.notify_one();
+    m_Thread.join();
+    TS_Stats::WritePrometheus(m_FileName.c_str());
+}
+
+void TS_StatsDumper::xRun() {
+    std::unique_lock<std::mutex> Lock(m_Mutex);
+    while (!m_Wakeup.wait_for(Lock, std::chrono::milliseconds(m_Interval_ms), [this] { return m_Stop; }))
+        TS_Stats::WritePrometheus(m_FileName.c_str());
+}
+
+//=============================================================================================================================================================================
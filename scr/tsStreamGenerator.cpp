@@ -0,0 +1,190 @@
+#include "tsStreamGenerator.h"
+#include "tsPSI.h"
+#include <cstring>
+#include <algorithm>
+
+//=============================================================================================================================================================================
+// TS_StreamGenerator
+//=============================================================================================================================================================================
+TS_StreamGenerator::TS_StreamGenerator(const Config &C) : m_Config(C) {
+    //PMT has to fit one packet
+    m_Config.NumPIDs = std::min<uint32_t>(std::max<uint32_t>(m_Config.NumPIDs, 1), 32);
+    m_Config.MinPesSize = std::max<uint32_t>(m_Config.MinPesSize, 1);
+    m_Config.MaxPesSize = std::max(m_Config.MaxPesSize, m_Config.MinPesSize);
+    m_Config.PsiInterval = std::max<uint32_t>(m_Config.PsiInterval, 2);
+    if (m_Config.PacketSize != TS::M2TS_PacketLength && m_Config.PacketSize != TS::RS_PacketLength)
+        m_Config.PacketSize = TS::TS_PacketLength;
+    if (m_Config.Bitrate == 0) m_Config.Bitrate = 20000000;
+
+    //splitmix64 of the seed - xorshift state must not be 0
+    uint64_t Z = m_Config.Seed + 0x9E3779B97F4A7C15ull;
+    Z = (Z ^ (Z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    Z = (Z ^ (Z >> 27)) * 0x94D049BB133111EBull;
+    m_Random = (Z ^ (Z >> 31)) | 1;
+
+    for (uint32_t s = 0; s < m_Config.NumPIDs; s++) {
+        xStream Stream;
+        Stream.PID = (uint16_t) ((m_Config.FirstPID + s) & 0x1FFF);
+        Stream.StreamId = s == 0 ? 0xE0 : (uint8_t) (0xC0 + ((s - 1) & 0x1F));
+        m_Streams.push_back(Stream);
+    }
+    xBuildPSI();
+}
+
+uint64_t TS_StreamGenerator::xRandom() {
+    //xorshift64*
+    m_Random ^= m_Random >> 12;
+    m_Random ^= m_Random << 25;
+    m_Random ^= m_Random >> 27;
+    return m_Random * 0x2545F4914F6CDD1Dull;
+}
+
+void TS_StreamGenerator::Generate(std::vector<uint8_t> &Stream) {
+    Stream.reserve(Stream.size() + m_Config.NumPackets * m_Config.PacketSize);
+    uint8_t Packet[TS::TS_PacketLength];
+    for (uint64_t Idx = 0; Idx < m_Config.NumPackets; Idx++) {
+        const uint64_t Phase = Idx % m_Config.PsiInterval;
+        if (Phase == 0) xSectionPacket(Packet, (uint16_t) TS_PacketHeader::ePID::PAT, m_PAT, m_PatCC);
+        else if (Phase == 1) xSectionPacket(Packet, m_Config.PmtPID, m_PMT, m_PmtCC);
+        else {
+            xStream &ES = m_Streams[xRandom(0, m_Config.NumPIDs - 1)];
+            if (ES.Pos >= ES.PES.size()) xStartPES(ES, Idx);
+            int64_t PCR = NOT_VALID;
+            if (&ES == &m_Streams[0] && m_Config.PcrInterval && ES.NumSincePCR++ % m_Config.PcrInterval == 0) {
+                PCR = (int64_t) (Idx * m_Config.PacketSize * 8 * TS::ExtendedClockFrequency_Hz / m_Config.Bitrate);
+                m_NumPCRs++;
+            }
+            xPacket(Packet, ES, PCR);
+        }
+
+        if (m_Config.LossPermille && xRandom(0, 999) < m_Config.LossPermille) m_NumDropped++;
+        else xWrite(Stream, Packet, Idx);
+
+        if (m_Config.MisalignmentInterval && (Idx + 1) % m_Config.MisalignmentInterval == 0) {
+            const uint32_t NumJunk = xRandom(1, m_Config.PacketSize - 1);
+            for (uint32_t i = 0; i < NumJunk; i++) Stream.push_back((uint8_t) xRandom());
+            m_NumJunkBytes += NumJunk;
+        }
+    }
+}
+
+void TS_StreamGenerator::xBuildPSI() {
+    //PAT - program 1
+    m_PAT = {0x00, 0xB0, 0x00, 0x00, 0x01, 0xC1, 0x00, 0x00,
+             0x00, 0x01, (uint8_t) (0xE0 | (m_Config.PmtPID >> 8)), (uint8_t) m_Config.PmtPID};
+    //PMT - PCR on the first elementary stream
+    const uint16_t PcrPID = m_Streams[0].PID;
+    m_PMT = {0x02, 0xB0, 0x00, 0x00, 0x01, 0xC1, 0x00, 0x00,
+             (uint8_t) (0xE0 | (PcrPID >> 8)), (uint8_t) PcrPID, 0xF0, 0x00};
+    for (const xStream &ES : m_Streams) {
+        m_PMT.push_back(ES.StreamId == 0xE0 ? PSI::eStreamType_H264 : PSI::eStreamType_MPEG2_Audio);
+        m_PMT.push_back((uint8_t) (0xE0 | (ES.PID >> 8)));
+        m_PMT.push_back((uint8_t) ES.PID);
+        m_PMT.push_back(0xF0);
+        m_PMT.push_back(0x00);
+    }
+    for (std::vector<uint8_t> *Section : {&m_PAT, &m_PMT}) {
+        const uint32_t SectionLength = (uint32_t) Section->size() - PSI::SectionHeaderLength + PSI::CRC32Length;
+        (*Section)[1] |= (uint8_t) (SectionLength >> 8);
+        (*Section)[2] = (uint8_t) SectionLength;
+        const uint32_t CRC = PSI::CRC32(Section->data(), (uint32_t) Section->size());
+        for (int32_t b = 3; b >= 0; b--) Section->push_back((uint8_t) (CRC >> (8 * b)));
+    }
+}
+
+void TS_StreamGenerator::xStartPES(xStream &ES, uint64_t PacketIndex) {
+    const uint32_t Size = xRandom(m_Config.MinPesSize, m_Config.MaxPesSize);
+    //PTS - transmission time plus 100 ms
+    const uint64_t PTS = (PacketIndex * m_Config.PacketSize * 8 * TS::BaseClockFrequency_Hz / m_Config.Bitrate +
+                          TS::BaseClockFrequency_Hz / 10) & (((uint64_t) 1 << 33) - 1);
+    const uint32_t PacketLength = Size + 8 <= 0xFFFF ? Size + 8 : 0;
+    ES.PES.resize(TS::PES_HeaderLength + 8 + Size);
+    uint8_t *H = ES.PES.data();
+    H[0] = 0x00;
+    H[1] = 0x00;
+    H[2] = 0x01;
+    H[3] = ES.StreamId;
+    H[4] = (uint8_t) (PacketLength >> 8);
+    H[5] = (uint8_t) PacketLength;
+    H[6] = 0x80;
+    H[7] = 0x80; //PTS only
+    H[8] = 5;
+    H[9] = (uint8_t) (0x21 | ((PTS >> 29) & 0x0E));
+    H[10] = (uint8_t) (PTS >> 22);
+    H[11] = (uint8_t) (((PTS >> 14) & 0xFE) | 1);
+    H[12] = (uint8_t) (PTS >> 7);
+    H[13] = (uint8_t) (((PTS << 1) & 0xFE) | 1);
+    //payload bytes taken least significant first - independent of the host byte order
+    for (uint32_t i = 14; i < ES.PES.size(); i += 8) {
+        const uint64_t R = xRandom();
+        const uint32_t NumBytes = (uint32_t) std::min<size_t>(8, ES.PES.size() - i);
+        for (uint32_t b = 0; b < NumBytes; b++) H[i + b] = (uint8_t) (R >> (8 * b));
+    }
+    ES.Pos = 0;
+    ES.NumPES++;
+    m_NumPES++;
+}
+
+void TS_StreamGenerator::xPacket(uint8_t *Packet, xStream &ES, int64_t PCR) {
+    const uint32_t Remaining = (uint32_t) ES.PES.size() - ES.Pos;
+    const bool RandomAF = m_Config.AdaptationFieldPermille &&
+                          xRandom(0, 999) < m_Config.AdaptationFieldPermille;
+    //adaptation_field_length + flags + PCR
+    uint32_t AFBytes = (PCR != NOT_VALID || RandomAF) ? 2 + (PCR != NOT_VALID ? 6 : 0) : 0;
+    if (Remaining + AFBytes < TS::TS_PacketLength - TS::TS_HeaderLength)
+        AFBytes = TS::TS_PacketLength - TS::TS_HeaderLength - Remaining;
+    const uint32_t PayloadSize = TS::TS_PacketLength - TS::TS_HeaderLength - AFBytes;
+
+    Packet[0] = TS::TS_SyncByte;
+    Packet[1] = (uint8_t) ((ES.Pos == 0 ? 0x40 : 0x00) | (ES.PID >> 8));
+    Packet[2] = (uint8_t) ES.PID;
+    Packet[3] = (uint8_t) ((AFBytes ? 0x30 : 0x10) | ES.CC);
+    ES.CC = (ES.CC + 1) & 0xF;
+    if (AFBytes) {
+        Packet[4] = (uint8_t) (AFBytes - 1);
+        if (AFBytes >= 2) {
+            memset(Packet + 5, 0xFF, AFBytes - 1);
+            Packet[5] = PCR != NOT_VALID ? 0x10 : 0x00;
+            if (PCR != NOT_VALID) {
+                const uint64_t Base = ((uint64_t) PCR / TS::BaseToExtendedClockMultiplier) & (((uint64_t) 1 << 33) - 1);
+                const uint32_t Extension = (uint32_t) ((uint64_t) PCR % TS::BaseToExtendedClockMultiplier);
+                Packet[6] = (uint8_t) (Base >> 25);
+                Packet[7] = (uint8_t) (Base >> 17);
+                Packet[8] = (uint8_t) (Base >> 9);
+                Packet[9] = (uint8_t) (Base >> 1);
+                Packet[10] = (uint8_t) (((Base & 1) << 7) | 0x7E | (Extension >> 8));
+                Packet[11] = (uint8_t) Extension;
+            }
+        }
+    }
+    memcpy(Packet + TS::TS_HeaderLength + AFBytes, ES.PES.data() + ES.Pos, PayloadSize);
+    ES.Pos += PayloadSize;
+}
+
+void TS_StreamGenerator::xSectionPacket(uint8_t *Packet, uint16_t PID, const std::vector<uint8_t> &Section,
+                                        uint8_t &CC) {
+    Packet[0] = TS::TS_SyncByte;
+    Packet[1] = (uint8_t) (0x40 | (PID >> 8));
+    Packet[2] = (uint8_t) PID;
+    Packet[3] = (uint8_t) (0x10 | CC);
+    CC = (CC + 1) & 0xF;
+    Packet[4] = 0x00; //pointer_field
+    memcpy(Packet + 5, Section.data(), Section.size());
+    memset(Packet + 5 + Section.size(), PSI::StuffingByte, TS::TS_PacketLength - 5 - Section.size());
+}
+
+void TS_StreamGenerator::xWrite(std::vector<uint8_t> &Stream, const uint8_t *Packet, uint64_t PacketIndex) {
+    if (m_Config.PacketSize == TS::M2TS_PacketLength) {
+        //TP_extra_header - 30 bit arrival time stamp (27 MHz)
+        const uint32_t ATS = (uint32_t) (PacketIndex * m_Config.PacketSize * 8 * TS::ExtendedClockFrequency_Hz /
+                                         m_Config.Bitrate) & 0x3FFFFFFF;
+        for (int32_t b = 3; b >= 0; b--) Stream.push_back((uint8_t) (ATS >> (8 * b)));
+    }
+    Stream.insert(Stream.end(), Packet, Packet + TS::TS_PacketLength);
+    //Reed-Solomon parity (not computed)
+    if (m_Config.PacketSize == TS::RS_PacketLength)
+        Stream.insert(Stream.end(), TS::RS_PacketLength - TS::TS_PacketLength, 0);
+    m_NumPackets++;
+}
+
+//=============================================================================================================================================================================
@@ -0,0 +1,67 @@
+#include "tsSyncScanner.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TS_SSE2_SCANNER 1
+#else
+#define TS_SSE2_SCANNER 0
+#endif
+
+constexpr uint32_t TS_SyncScanner::PacketSizes[TS_SyncScanner::NumPacketSizes];
+
+//=============================================================================================================================================================================
+// TS_SyncScanner
+//=============================================================================================================================================================================
+static inline uint32_t xCountTrailingZeros(uint32_t Value) {
+#if defined(_MSC_VER)
+    unsigned long Idx;
+    _BitScanForward(&Idx, Value);
+    return Idx;
+#else
+    return __builtin_ctz(Value);
+#endif
+}
+
+uint64_t TS_SyncScanner::FindSyncByte(const uint8_t *Data, uint64_t Begin, uint64_t End) {
+    uint64_t Pos = Begin;
+#if TS_SSE2_SCANNER
+    const __m128i Sync = _mm_set1_epi8((char) TS::TS_SyncByte);
+    for (; Pos + 16 <= End; Pos += 16) {
+        uint32_t Mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (Data + Pos)), Sync));
+        if (Mask) return Pos + xCountTrailingZeros(Mask);
+    }
+#endif
+    const void *Found = memchr(Data + Pos, TS::TS_SyncByte, End - Pos);
+    return Found ? (const uint8_t *) Found - Data : End;
+}
+
+TS_SyncScanner::eResult TS_SyncScanner::FindLock(const uint8_t *Data, uint64_t Size, bool EndOfStream,
+                                                 uint64_t &Offset, uint32_t &PacketSize) const {
+    for (uint64_t Pos = FindSyncByte(Data, 0, Size); Pos < Size; Pos = FindSyncByte(Data, Pos + 1, Size)) {
+        bool Truncated = false;
+        uint32_t TruncatedPacketSize = 0;
+        for (uint32_t PS : PacketSizes) {
+            uint32_t NumHits = CountAligned(Data + Pos, Size - Pos, PS, m_LockCount);
+            if (NumHits == m_LockCount) {
+                Offset = Pos;
+                PacketSize = PS;
+                return eResult::Locked;
+            }
+            //run ended because data ended, not because of a missing sync byte
+            if (Pos + (uint64_t) NumHits * PS + TS::TS_PacketLength > Size && !Truncated) {
+                Truncated = NumHits > 0 || !EndOfStream;
+                TruncatedPacketSize = PS;
+            }
+        }
+        if (Truncated) {
+            Offset = Pos;
+            PacketSize = TruncatedPacketSize;
+            return EndOfStream ? eResult::Locked : eResult::NeedMoreData;
+        }
+    }
+    Offset = Size;
+    return eResult::NotFound;
+}
+
+//=============================================================================================================================================================================
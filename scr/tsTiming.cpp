@@ -0,0 +1,149 @@
+#include "tsTiming.h"
+#include <cmath>
+#include <cstring>
+
+//=============================================================================================================================================================================
+// TS_PcrAnalyzer
+//=============================================================================================================================================================================
+TS_PcrAnalyzer::TS_PcrAnalyzer(uint16_t PID, int64_t WindowLength, uint32_t PacketSize) {
+    m_PID = PID;
+    m_WindowLength = WindowLength > 0 ? WindowLength : DefaultWindowLength;
+    m_PacketSize = PacketSize;
+    xStartWindow(0, 0);
+    m_Window = m_Current;
+}
+
+void TS_PcrAnalyzer::xStartSegment(uint64_t PacketIndex, int64_t PCR, int64_t ArrivalTime_ns) {
+    m_SegmentPCR = PCR;
+    m_SegmentElapsed = 0;
+    m_SegmentPacket = PacketIndex;
+    m_SegmentArrival = ArrivalTime_ns;
+    m_RateFit.Reset();
+    m_ClockFit.Reset();
+    m_RateFit.Add(0, 0);
+    if (ArrivalTime_ns != NOT_VALID) m_ClockFit.Add(0, 0);
+}
+
+void TS_PcrAnalyzer::xStartWindow(uint64_t PacketIndex, int64_t PCR) {
+    memset(&m_Current, 0, sizeof(m_Current));
+    m_Current.PID = m_PID;
+    m_Current.FirstPacket = PacketIndex;
+    m_Current.StartPCR = PCR;
+    m_Current.NumPCRs = 1;
+    m_Current.MinBitrate = DBL_MAX;
+    m_WindowStartElapsed = m_SegmentElapsed;
+}
+
+bool TS_PcrAnalyzer::xCloseWindow(uint64_t EndPacket) {
+    m_Current.Duration = m_SegmentElapsed - m_WindowStartElapsed;
+    m_Current.NumPackets = EndPacket - m_Current.FirstPacket;
+    if (m_Current.Duration <= 0) return false;
+    m_Current.Bitrate = (double) m_Current.NumPackets * m_PacketSize * 8 * TS::ExtendedClockFrequency_Hz /
+                        (double) m_Current.Duration;
+    if (m_Current.MinBitrate == DBL_MAX) m_Current.MinBitrate = 0;
+    if (m_ClockFit.isValid()) m_Current.FrequencyOffset_ppm = (m_ClockFit.getSlope() - 1) * 1e6;
+    m_Window = m_Current;
+    return true;
+}
+
+bool TS_PcrAnalyzer::AbsorbPCR(uint64_t PacketIndex, int64_t PCR, bool Discontinuity, int64_t ArrivalTime_ns) {
+    m_NumPCRs++;
+    if (m_LastPCR == NOT_VALID) {
+        xStartSegment(PacketIndex, PCR, ArrivalTime_ns);
+        xStartWindow(PacketIndex, PCR);
+        m_LastPCR = PCR;
+        m_LastPacket = PacketIndex;
+        return false;
+    }
+    int64_t Delta = PCR - m_LastPCR;
+    if (Delta < -PCR_Period / 2) Delta += PCR_Period; //wrap around
+
+    bool Completed = false;
+    if (Discontinuity || Delta < 0 || Delta > MaxDiscontinuity) {
+        if (Discontinuity) {
+            m_NumDiscontinuities++;
+            m_Current.NumDiscontinuities++;
+        } else {
+            m_NumDiscontinuityErrors++;
+            m_Current.NumDiscontinuityErrors++;
+        }
+        Completed = xCloseWindow(m_LastPacket);
+        xStartSegment(PacketIndex, PCR, ArrivalTime_ns);
+        xStartWindow(PacketIndex, PCR);
+        m_LastPCR = PCR;
+        m_LastPacket = PacketIndex;
+        return Completed;
+    }
+
+    const double Interval_ms = (double) Delta / TS::ExtendedClockFrequency_kHz;
+    if (Delta > MaxRepetitionInterval) {
+        m_NumRepetitionErrors++;
+        m_Current.NumRepetitionErrors++;
+    }
+    if (Interval_ms > m_Current.MaxInterval_ms) m_Current.MaxInterval_ms = Interval_ms;
+    if (Delta > 0) {
+        const double Bitrate = (double) (PacketIndex - m_LastPacket) * m_PacketSize * 8 *
+                               TS::ExtendedClockFrequency_Hz / (double) Delta;
+        if (Bitrate < m_Current.MinBitrate) m_Current.MinBitrate = Bitrate;
+        if (Bitrate > m_Current.MaxBitrate) m_Current.MaxBitrate = Bitrate;
+    }
+
+    //PCR_ac - deviation from the constant rate model (1 tick = 1000/27 ns)
+    m_SegmentElapsed += Delta;
+    const double Bytes = (double) (PacketIndex - m_SegmentPacket) * m_PacketSize;
+    m_RateFit.Add(Bytes, (double) m_SegmentElapsed);
+    if (m_RateFit.N > 2) {
+        const double Accuracy_ns = m_RateFit.getResidual(Bytes, (double) m_SegmentElapsed) * 1000 /
+                                   TS::ExtendedClockFrequency_kHz;
+        if (fabs(Accuracy_ns) > m_Current.MaxAccuracy_ns) m_Current.MaxAccuracy_ns = fabs(Accuracy_ns);
+    }
+
+    //PCR_oj / PCR_fo - arrival time against PCR time
+    if (ArrivalTime_ns != NOT_VALID && m_SegmentArrival != NOT_VALID) {
+        const double Elapsed_ns = (double) m_SegmentElapsed * 1000 / TS::ExtendedClockFrequency_kHz;
+        const double Arrival_ns = (double) (ArrivalTime_ns - m_SegmentArrival);
+        m_ClockFit.Add(Elapsed_ns, Arrival_ns);
+        if (m_ClockFit.N > 2) {
+            const double Jitter_ns = fabs(m_ClockFit.getResidual(Elapsed_ns, Arrival_ns));
+            if (Jitter_ns > m_Current.MaxOverallJitter_ns) m_Current.MaxOverallJitter_ns = Jitter_ns;
+        }
+    }
+
+    m_LastPCR = PCR;
+    m_LastPacket = PacketIndex;
+    m_Current.NumPCRs++;
+    if (m_SegmentElapsed - m_WindowStartElapsed >= m_WindowLength) {
+        Completed = xCloseWindow(PacketIndex);
+        xStartWindow(PacketIndex, PCR);
+    }
+    return Completed;
+}
+
+bool TS_PcrAnalyzer::Finish() {
+    if (m_LastPCR == NOT_VALID) return false;
+    const bool Completed = xCloseWindow(m_LastPacket);
+    xStartWindow(m_LastPacket, m_LastPCR);
+    return Completed;
+}
+
+double TS_PcrAnalyzer::getBitrate() const {
+    if (!m_RateFit.isValid()) return 0;
+    //slope is 27 MHz ticks per byte
+    return 8.0 * TS::ExtendedClockFrequency_Hz / m_RateFit.getSlope();
+}
+
+//=============================================================================================================================================================================
+// TS_TimingEngine
+//=============================================================================================================================================================================
+TS_PcrAnalyzer &TS_TimingEngine::xGetAnalyzer(uint16_t PID) {
+    std::unique_ptr<TS_PcrAnalyzer> &Analyzer = m_Analyzers[PID & (TS_Demuxer::NumPIDs - 1)];
+    if (!Analyzer) Analyzer.reset(new TS_PcrAnalyzer(PID, m_WindowLength, m_PacketSize));
+    return *Analyzer;
+}
+
+void TS_TimingEngine::Finish() {
+    for (std::unique_ptr<TS_PcrAnalyzer> &Analyzer : m_Analyzers)
+        if (Analyzer && Analyzer->Finish()) xWindowCompleted(Analyzer->getWindow());
+}
+
+//=============================================================================================================================================================================
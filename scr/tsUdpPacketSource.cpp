@@ -0,0 +1,219 @@
+#include "tsUdpPacketSource.h"
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <time.h>
+#define TS_HAS_UDP 1
+#else
+#define TS_HAS_UDP 0
+#endif
+
+//=============================================================================================================================================================================
+// TS_UdpPacketSource
+//=============================================================================================================================================================================
+static inline uint64_t xNow_ns() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+TS_UdpPacketSource::TS_UdpPacketSource(const char *Address, uint16_t Port, const char *Interface, uint32_t BatchSize,
+                                       uint32_t SocketBufferSize) {
+    m_BatchSize = BatchSize;
+    m_NumDatagrams = BatchSize / 7 ? BatchSize / 7 : 1;
+    const uint32_t MaxPackets = m_NumDatagrams * (DatagramSize / TS::TS_PacketLength);
+    m_Datagrams.resize((size_t) m_NumDatagrams * DatagramSize);
+    m_DatagramTimes.resize(m_NumDatagrams);
+    m_DatagramSizes.resize(m_NumDatagrams);
+    m_Buffer.resize((size_t) MaxPackets * TS::TS_PacketLength);
+    m_Timestamps.resize(MaxPackets);
+#if TS_HAS_UDP
+    m_Socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (m_Socket < 0) return;
+
+    int Enable = 1;
+    setsockopt(m_Socket, SOL_SOCKET, SO_REUSEADDR, &Enable, sizeof(Enable));
+    int BufferSize = (int) SocketBufferSize;
+    setsockopt(m_Socket, SOL_SOCKET, SO_RCVBUF, &BufferSize, sizeof(BufferSize));
+#if defined(SO_TIMESTAMPNS)
+    setsockopt(m_Socket, SOL_SOCKET, SO_TIMESTAMPNS, &Enable, sizeof(Enable));
+#endif
+    //timeout lets ReadBatch notice Stop() and idle timeout
+    struct timeval Timeout = {0, (suseconds_t) TimeoutCheck_ms * 1000};
+    setsockopt(m_Socket, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+
+    struct sockaddr_in Local;
+    memset(&Local, 0, sizeof(Local));
+    Local.sin_family = AF_INET;
+    Local.sin_port = htons(Port);
+    struct in_addr Group;
+    if (inet_pton(AF_INET, Address, &Group) != 1) return;
+    const bool Multicast = IN_MULTICAST(ntohl(Group.s_addr));
+    Local.sin_addr = Group;
+    if (bind(m_Socket, (struct sockaddr *) &Local, sizeof(Local)) != 0) return;
+
+    if (Multicast) {
+        struct ip_mreq Membership;
+        Membership.imr_multiaddr = Group;
+        Membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (Interface && inet_pton(AF_INET, Interface, &Membership.imr_interface) != 1) return;
+        if (setsockopt(m_Socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &Membership, sizeof(Membership)) != 0) return;
+    }
+    m_Good = true;
+#else
+    (void) Address;
+    (void) Port;
+    (void) Interface;
+    (void) SocketBufferSize;
+#endif
+}
+
+TS_UdpPacketSource::~TS_UdpPacketSource() {
+#if TS_HAS_UDP
+    if (m_Socket >= 0) close(m_Socket);
+#endif
+}
+
+uint16_t TS_UdpPacketSource::getLocalPort() const {
+#if TS_HAS_UDP
+    struct sockaddr_in Local;
+    socklen_t Length = sizeof(Local);
+    if (getsockname(m_Socket, (struct sockaddr *) &Local, &Length) == 0) return ntohs(Local.sin_port);
+#endif
+    return 0;
+}
+
+int32_t TS_UdpPacketSource::xReceive() {
+#if TS_HAS_UDP
+    const uint32_t ControlSize = 64; //multiple of the cmsghdr alignment - every message's block stays aligned
+    union {
+        struct cmsghdr Align;
+        uint8_t Data[ControlSize * 64];
+    } Control;
+    const uint32_t NumControl = m_NumDatagrams < 64 ? m_NumDatagrams : 64;
+#if defined(__linux__)
+    //one recvmmsg call for up to NumControl datagrams
+    struct mmsghdr Messages[64];
+    struct iovec IoVecs[64];
+    memset(Messages, 0, sizeof(Messages));
+    for (uint32_t i = 0; i < NumControl; i++) {
+        IoVecs[i].iov_base = &m_Datagrams[(size_t) i * DatagramSize];
+        IoVecs[i].iov_len = DatagramSize;
+        Messages[i].msg_hdr.msg_iov = &IoVecs[i];
+        Messages[i].msg_hdr.msg_iovlen = 1;
+        Messages[i].msg_hdr.msg_control = Control.Data + i * ControlSize;
+        Messages[i].msg_hdr.msg_controllen = ControlSize;
+    }
+    m_NumSystemCalls++;
+    int Received;
+    {
+        TS_STATS_TIMER(Read);
+        Received = recvmmsg(m_Socket, Messages, NumControl, MSG_WAITFORONE | (m_NonBlocking ? MSG_DONTWAIT : 0),
+                            nullptr);
+    }
+    if (Received < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    for (int i = 0; i < Received; i++) {
+        m_DatagramSizes[i] = Messages[i].msg_len;
+        m_DatagramTimes[i] = 0;
+        for (struct cmsghdr *C = CMSG_FIRSTHDR(&Messages[i].msg_hdr); C; C = CMSG_NXTHDR(&Messages[i].msg_hdr, C)) {
+#if defined(SO_TIMESTAMPNS)
+            if (C->cmsg_level == SOL_SOCKET && C->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec Time;
+                memcpy(&Time, CMSG_DATA(C), sizeof(Time));
+                m_DatagramTimes[i] = (uint64_t) Time.tv_sec * 1000000000ull + Time.tv_nsec;
+            }
+#endif
+        }
+        if (m_DatagramTimes[i] == 0) m_DatagramTimes[i] = xNow_ns();
+    }
+    return Received;
+#else
+    (void) Control;
+    (void) NumControl;
+    m_NumSystemCalls++;
+    ssize_t Received = recv(m_Socket, &m_Datagrams[0], DatagramSize, m_NonBlocking ? MSG_DONTWAIT : 0);
+    if (Received < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+    m_DatagramSizes[0] = (uint32_t) Received;
+    m_DatagramTimes[0] = xNow_ns();
+    return 1;
+#endif
+#else
+    return -1;
+#endif
+}
+
+void TS_UdpPacketSource::xProcessDatagram(const uint8_t *Data, uint32_t Size, uint64_t Timestamp,
+                                          uint32_t &NumPackets) {
+    m_NumDatagramsReceived++;
+    //RTP: version 2, payload does not start at the first byte
+    if (Size >= 12 && Data[0] != TS::TS_SyncByte && (Data[0] & 0xC0) == 0x80) {
+        uint32_t HeaderLength = 12 + 4 * (Data[0] & 0x0F);
+        if ((Data[0] & 0x10) && HeaderLength + 4 <= Size)
+            HeaderLength += 4 + 4 * ((Data[HeaderLength + 2] << 8) | Data[HeaderLength + 3]);
+        if (HeaderLength > Size) HeaderLength = Size;
+        const int32_t Sequence = (Data[2] << 8) | Data[3];
+        //signed 16 bit distance - only forward jumps are gaps, late (reordered) and duplicate datagrams do not move
+        //the last sequence number back
+        const int16_t Distance = (int16_t) (uint16_t) (Sequence - m_LastRtpSequence);
+        if (m_LastRtpSequence == NOT_VALID || Distance > 0) {
+            if (m_LastRtpSequence != NOT_VALID) m_NumRtpLost += Distance - 1;
+            m_LastRtpSequence = Sequence;
+        } else m_NumRtpLate++;
+        m_NumRtpDatagrams++;
+        Data += HeaderLength;
+        Size -= HeaderLength;
+    }
+    uint32_t Pos = 0;
+    for (; Pos + TS::TS_PacketLength <= Size; Pos += TS::TS_PacketLength) {
+        if (Data[Pos] != TS::TS_SyncByte) {
+            m_SkippedBytes += TS::TS_PacketLength;
+            continue;
+        }
+        memcpy(&m_Buffer[(size_t) NumPackets * TS::TS_PacketLength], Data + Pos, TS::TS_PacketLength);
+        m_Timestamps[NumPackets++] = Timestamp;
+    }
+    m_SkippedBytes += Size - Pos;
+}
+
+uint32_t TS_UdpPacketSource::ReadBatch(TS_PacketSpan &Span) {
+    Span.NumPackets = 0;
+    m_Pending = false;
+    if (!m_Good) return 0;
+    uint32_t IdleTime_ms = 0;
+    uint32_t NumPackets = 0;
+    while (NumPackets == 0) {
+        if (m_Stop) return 0;
+        const int32_t Received = xReceive();
+        if (Received < 0) {
+            m_Good = false;
+            return 0;
+        }
+        if (Received == 0) {
+            if (m_NonBlocking) {
+                m_Pending = true;
+                return 0;
+            }
+            IdleTime_ms += TimeoutCheck_ms;
+            if (m_IdleTimeout_ms && IdleTime_ms >= m_IdleTimeout_ms) return 0;
+            continue;
+        }
+        IdleTime_ms = 0;
+        for (int32_t i = 0; i < Received; i++)
+            xProcessDatagram(&m_Datagrams[(size_t) i * DatagramSize], m_DatagramSizes[i], m_DatagramTimes[i],
+                             NumPackets);
+    }
+    m_Locked = true;
+    Span.Data = m_Buffer.data();
+    Span.NumPackets = NumPackets;
+    Span.Stride = TS::TS_PacketLength;
+    Span.FirstPacketIndex = m_NumPackets;
+    m_NumPackets += NumPackets;
+    return NumPackets;
+}
+
+//=============================================================================================================================================================================
@@ -0,0 +1,398 @@
+#include "tsVideoSplitter.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define TS_SSE2_SCANNER 1
+#else
+#define TS_SSE2_SCANNER 0
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TS_AVX2_KERNEL 1
+#define TS_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(__AVX2__)
+#define TS_AVX2_KERNEL 1
+#define TS_AVX2_TARGET
+#else
+#define TS_AVX2_KERNEL 0
+#endif
+
+//=============================================================================================================================================================================
+// TS_StartCodeScanner
+//=============================================================================================================================================================================
+static inline uint32_t xCountTrailingZeros(uint32_t Value) {
+#if defined(_MSC_VER)
+    unsigned long Idx;
+    _BitScanForward(&Idx, Value);
+    return Idx;
+#else
+    return __builtin_ctz(Value);
+#endif
+}
+
+TS_StartCodeScanner::TS_StartCodeScanner() {
+    m_Kernel = isKernelSupported(eKernel::AVX2) ? eKernel::AVX2 :
+               isKernelSupported(eKernel::SSE2) ? eKernel::SSE2 : eKernel::Scalar;
+}
+
+bool TS_StartCodeScanner::isKernelSupported(eKernel Kernel) {
+    switch (Kernel) {
+        case eKernel::Scalar:
+            return true;
+        case eKernel::SSE2:
+            return TS_SSE2_SCANNER != 0;
+        case eKernel::AVX2:
+#if TS_AVX2_KERNEL && defined(__GNUC__)
+            return __builtin_cpu_supports("avx2");
+#elif TS_AVX2_KERNEL
+            return true;
+#else
+            return false;
+#endif
+    }
+    return false;
+}
+
+bool TS_StartCodeScanner::setKernel(eKernel Kernel) {
+    if (!isKernelSupported(Kernel)) return false;
+    m_Kernel = Kernel;
+    return true;
+}
+
+uint64_t TS_StartCodeScanner::Find(const uint8_t *Data, uint64_t Begin, uint64_t End) const {
+    switch (m_Kernel) {
+        case eKernel::AVX2:
+            return xFindAVX2(Data, Begin, End);
+        case eKernel::SSE2:
+            return xFindSSE2(Data, Begin, End);
+        default:
+            return xFindScalar(Data, Begin, End);
+    }
+}
+
+uint64_t TS_StartCodeScanner::xFindScalar(const uint8_t *Data, uint64_t Begin, uint64_t End) {
+    uint64_t Pos = Begin;
+    while (Pos + 3 <= End) {
+        //third byte above 1 - no start code can begin at Pos, Pos + 1 or Pos + 2
+        if (Data[Pos + 2] > 1) Pos += 3;
+        else if (Data[Pos + 2] == 1 && Data[Pos + 1] == 0 && Data[Pos] == 0) return Pos;
+        else Pos++;
+    }
+    return End;
+}
+
+#if TS_SSE2_SCANNER
+uint64_t TS_StartCodeScanner::xFindSSE2(const uint8_t *Data, uint64_t Begin, uint64_t End) {
+    const __m128i Zero = _mm_setzero_si128();
+    const __m128i One = _mm_set1_epi8(1);
+    uint64_t Pos = Begin;
+    //bytes Pos .. Pos + 17 have to be in range
+    for (; Pos + 18 <= End; Pos += 16) {
+        const __m128i B0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (Data + Pos)), Zero);
+        const __m128i B1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (Data + Pos + 1)), Zero);
+        const __m128i B2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (Data + Pos + 2)), One);
+        uint32_t Mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(B0, B1), B2));
+        if (Mask) return Pos + xCountTrailingZeros(Mask);
+    }
+    return xFindScalar(Data, Pos, End);
+}
+#else
+uint64_t TS_StartCodeScanner::xFindSSE2(const uint8_t *Data, uint64_t Begin, uint64_t End) {
+    return xFindScalar(Data, Begin, End);
+}
+#endif
+
+#if TS_AVX2_KERNEL
+TS_AVX2_TARGET uint64_t TS_StartCodeScanner::xFindAVX2(const uint8_t *Data, uint64_t Begin, uint64_t End) {
+    const __m256i Zero = _mm256_setzero_si256();
+    const __m256i One = _mm256_set1_epi8(1);
+    uint64_t Pos = Begin;
+    for (; Pos + 34 <= End; Pos += 32) {
+        const __m256i B0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (Data + Pos)), Zero);
+        const __m256i B1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (Data + Pos + 1)), Zero);
+        const __m256i B2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (Data + Pos + 2)), One);
+        uint32_t Mask = (uint32_t) _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(B0, B1), B2));
+        if (Mask) return Pos + xCountTrailingZeros(Mask);
+    }
+    return xFindSSE2(Data, Pos, End);
+}
+#else
+uint64_t TS_StartCodeScanner::xFindAVX2(const uint8_t *Data, uint64_t Begin, uint64_t End) {
+    return xFindSSE2(Data, Begin, End);
+}
+#endif
+
+//=============================================================================================================================================================================
+// xBitReader - RBSP reader (skips emulation prevention bytes), reads zeros past the end
+//=============================================================================================================================================================================
+struct xBitReader {
+    const uint8_t *Data;
+    uint64_t Size;
+    uint64_t Pos = 0;
+    uint32_t NumZeros = 0;
+    uint32_t Byte = 0;
+    uint32_t BitsLeft = 0;
+    bool Overrun = false;
+
+    xBitReader(const uint8_t *D, uint64_t S) : Data(D), Size(S) {}
+
+    uint32_t ReadBit() {
+        if (BitsLeft == 0) {
+            if (Pos >= Size) {
+                Overrun = true;
+                return 0;
+            }
+            Byte = Data[Pos++];
+            if (NumZeros >= 2 && Byte == 3) {
+                NumZeros = 0;
+                if (Pos >= Size) {
+                    Overrun = true;
+                    return 0;
+                }
+                Byte = Data[Pos++];
+            }
+            NumZeros = Byte == 0 ? NumZeros + 1 : 0;
+            BitsLeft = 8;
+        }
+        BitsLeft--;
+        return (Byte >> BitsLeft) & 1;
+    }
+
+    uint32_t ReadBits(uint32_t NumBits) {
+        uint32_t Value = 0;
+        for (uint32_t i = 0; i < NumBits; i++) Value = (Value << 1) | ReadBit();
+        return Value;
+    }
+
+    //ue(v)
+    uint32_t ReadUE() {
+        uint32_t LeadingZeros = 0;
+        while (ReadBit() == 0) {
+            if (Overrun || ++LeadingZeros > 31) {
+                Overrun = true;
+                return 0;
+            }
+        }
+        return (uint32_t) (((uint64_t) 1 << LeadingZeros) - 1 + ReadBits(LeadingZeros));
+    }
+};
+
+//=============================================================================================================================================================================
+// TS_AccessUnitSplitter
+//=============================================================================================================================================================================
+TS_AccessUnitSplitter::TS_AccessUnitSplitter(eCodec Codec) : m_Codec(Codec) {
+    memset(&m_AU, 0, sizeof(m_AU));
+}
+
+bool TS_AccessUnitSplitter::isKeyframe(eCodec Codec, uint8_t NalType) {
+    if (Codec == eCodec::H264) return NalType == eNalH264_IDR;
+    return NalType >= eNalHEVC_BLA_W_LP && NalType <= eNalHEVC_IRAP_Last;
+}
+
+bool TS_AccessUnitSplitter::ClassifyNAL(const uint8_t *Data, uint64_t Size, NalInfo &Info) {
+    Info.VCL = false;
+    Info.FirstSlice = false;
+    Info.SliceType = TS_AccessUnit::eSliceType::Unknown;
+    if (m_Codec == eCodec::H264) {
+        if (Size < 1) return false;
+        Info.Type = Data[0] & 0x1F;
+        if (Info.Type < 1 || Info.Type > eNalH264_IDR) return true;
+        Info.VCL = true;
+        //slice data partitions B and C carry no slice header
+        if (Info.Type == 3 || Info.Type == 4) return true;
+        xBitReader Reader(Data + 1, Size - 1);
+        const uint32_t FirstMb = Reader.ReadUE();
+        const uint32_t SliceType = Reader.ReadUE();
+        if (Reader.Overrun) return false;
+        Info.FirstSlice = FirstMb == 0;
+        switch (SliceType % 5) {
+            case 0:
+            case 3: //SP
+                Info.SliceType = TS_AccessUnit::eSliceType::P;
+                break;
+            case 1:
+                Info.SliceType = TS_AccessUnit::eSliceType::B;
+                break;
+            default: //I, SI
+                Info.SliceType = TS_AccessUnit::eSliceType::I;
+                break;
+        }
+        return true;
+    }
+
+    if (Size < 2) return false;
+    Info.Type = (Data[0] >> 1) & 0x3F;
+    xBitReader Reader(Data + 2, Size - 2);
+    if (Info.Type == eNalHEVC_PPS) {
+        const uint32_t PpsId = Reader.ReadUE();
+        Reader.ReadUE();   //pps_seq_parameter_set_id
+        Reader.ReadBits(2); //dependent_slice_segments_enabled_flag, output_flag_present_flag
+        const uint32_t ExtraBits = Reader.ReadBits(3);
+        if (Reader.Overrun || PpsId >= NumHEVCPPS) return false;
+        m_ExtraSliceHeaderBits[PpsId] = (uint8_t) ExtraBits;
+        return true;
+    }
+    if (Info.Type >= 32) return true;
+    Info.VCL = true;
+    Info.FirstSlice = Reader.ReadBit() != 0;
+    //slice_type without SPS is reachable in the first slice segment only
+    if (!Info.FirstSlice) return !Reader.Overrun;
+    if (Info.Type >= eNalHEVC_BLA_W_LP && Info.Type <= eNalHEVC_IRAP_Last) Reader.ReadBit(); //no_output_of_prior_pics_flag
+    const uint32_t PpsId = Reader.ReadUE();
+    if (PpsId >= NumHEVCPPS) return false;
+    Reader.ReadBits(m_ExtraSliceHeaderBits[PpsId]);
+    const uint32_t SliceType = Reader.ReadUE();
+    if (Reader.Overrun) return false;
+    switch (SliceType) {
+        case 0:
+            Info.SliceType = TS_AccessUnit::eSliceType::B;
+            break;
+        case 1:
+            Info.SliceType = TS_AccessUnit::eSliceType::P;
+            break;
+        case 2:
+            Info.SliceType = TS_AccessUnit::eSliceType::I;
+            break;
+    }
+    return true;
+}
+
+void TS_AccessUnitSplitter::AbsorbPES(const PES_PacketHeader &PESH, const TS_PayloadView *Views, uint32_t NumViews) {
+    xCompact();
+    uint64_t Total = 0;
+    for (uint32_t v = 0; v < NumViews; v++) Total += Views[v].Size;
+    if (m_Size + Total > m_Buffer.size()) m_Buffer.resize(std::max<uint64_t>(m_Size + Total, 2 * m_Buffer.size()));
+
+    xTimestamp Timestamp;
+    Timestamp.Pos = m_Size;
+    Timestamp.PTS = PESH.hasPTS() ? (int64_t) PESH.getPTS() : NOT_VALID;
+    //DTS absent - equal to PTS
+    Timestamp.DTS = PESH.hasDTS() ? (int64_t) PESH.getDTS() : Timestamp.PTS;
+    m_Timestamps.push_back(Timestamp);
+
+    for (uint32_t v = 0; v < NumViews; v++) {
+        memcpy(m_Buffer.data() + m_Size, Views[v].Data, Views[v].Size);
+        m_Size += Views[v].Size;
+    }
+    xScan(false);
+}
+
+void TS_AccessUnitSplitter::Finish() {
+    xScan(true);
+    m_Size = 0;
+    m_ScanPos = 0;
+    m_Timestamps.clear();
+}
+
+void TS_AccessUnitSplitter::xScan(bool EndOfStream) {
+    const uint8_t *Buffer = m_Buffer.data();
+    for (;;) {
+        const uint64_t Pos = m_Scanner.Find(Buffer, m_ScanPos, m_Size);
+        if (Pos >= m_Size) break;
+        if (m_NalStart != NOT_VALID) xAbsorbNAL((uint64_t) m_NalStart, Pos);
+        m_NalStart = (int64_t) Pos;
+        m_ScanPos = Pos + 3;
+    }
+    //start code may continue in the next PES
+    if (m_Size >= 2) m_ScanPos = std::max(m_ScanPos, m_Size - 2);
+    if (!EndOfStream) return;
+
+    if (m_NalStart != NOT_VALID) xAbsorbNAL((uint64_t) m_NalStart, m_Size);
+    m_NalStart = NOT_VALID;
+    xEmitAccessUnit(m_Size);
+}
+
+void TS_AccessUnitSplitter::xAbsorbNAL(uint64_t Start, uint64_t End) {
+    const uint8_t *Buffer = m_Buffer.data();
+    const uint64_t Header = Start + 3;
+    uint64_t PayloadEnd = End;
+    //trailing_zero_8bits
+    while (PayloadEnd > Header && Buffer[PayloadEnd - 1] == 0) PayloadEnd--;
+    NalInfo Info;
+    if (PayloadEnd <= Header || !ClassifyNAL(Buffer + Header, PayloadEnd - Header, Info)) {
+        if (PayloadEnd <= Header) return;
+        //damaged header - still part of the access unit
+        Info.Type = m_Codec == eCodec::H264 ? (Buffer[Header] & 0x1F) : ((Buffer[Header] >> 1) & 0x3F);
+    }
+    m_NumNALs++;
+
+    if (m_AUStart == NOT_VALID || xStartsAccessUnit(Info)) {
+        //zero_byte of 4 byte start code belongs to the new access unit
+        uint64_t AUStart = Start;
+        if (AUStart > 0 && Buffer[AUStart - 1] == 0 && (m_AUStart == NOT_VALID || (int64_t) AUStart > m_AUStart))
+            AUStart--;
+        xEmitAccessUnit(AUStart);
+        xStartAccessUnit(AUStart);
+    }
+
+    m_AU.NumNALs++;
+    m_AU.NalTypes |= (uint64_t) 1 << (Info.Type & 63);
+    if (isKeyframe(m_Codec, Info.Type)) m_AU.Keyframe = true;
+    if (!Info.VCL) return;
+    m_HasVCL = true;
+    if (Info.SliceType == TS_AccessUnit::eSliceType::Unknown) return;
+    if (m_AU.SliceType == TS_AccessUnit::eSliceType::Unknown) m_AU.SliceType = Info.SliceType;
+    else if (m_Codec == eCodec::H264) {
+        if (Info.SliceType == TS_AccessUnit::eSliceType::B ||
+            (Info.SliceType == TS_AccessUnit::eSliceType::P && m_AU.SliceType == TS_AccessUnit::eSliceType::I))
+            m_AU.SliceType = Info.SliceType;
+    }
+}
+
+bool TS_AccessUnitSplitter::xStartsAccessUnit(const NalInfo &Info) const {
+    if (!m_HasVCL) return false;
+    if (Info.VCL) return Info.FirstSlice;
+    if (m_Codec == eCodec::H264)
+        return (Info.Type >= eNalH264_SEI && Info.Type <= eNalH264_AUD) || (Info.Type >= 14 && Info.Type <= 18);
+    return (Info.Type >= eNalHEVC_VPS && Info.Type <= eNalHEVC_AUD) || Info.Type == eNalHEVC_PrefixSEI ||
+           (Info.Type >= 41 && Info.Type <= 44) || (Info.Type >= 48 && Info.Type <= 55);
+}
+
+void TS_AccessUnitSplitter::xStartAccessUnit(uint64_t Start) {
+    m_AUStart = (int64_t) Start;
+    m_HasVCL = false;
+    memset(&m_AU, 0, sizeof(m_AU));
+    m_AU.Number = m_NumAccessUnits;
+    m_AU.SliceType = TS_AccessUnit::eSliceType::Unknown;
+    m_AU.PTS = NOT_VALID;
+    m_AU.DTS = NOT_VALID;
+    //timestamps belong to the first access unit starting in the PES packet (start code 00 00 01 at Start + 2)
+    const uint64_t StartCodeEnd = Start + 2 + (m_Buffer[Start + 2] == 0 ? 1 : 0);
+    bool Found = false;
+    while (!m_Timestamps.empty() && m_Timestamps.front().Pos <= StartCodeEnd) {
+        m_AU.PTS = m_Timestamps.front().PTS;
+        m_AU.DTS = m_Timestamps.front().DTS;
+        Found = true;
+        m_Timestamps.pop_front();
+    }
+    if (!Found) m_AU.PTS = m_AU.DTS = NOT_VALID;
+}
+
+void TS_AccessUnitSplitter::xEmitAccessUnit(uint64_t End) {
+    if (m_AUStart == NOT_VALID) return;
+    const uint64_t Start = (uint64_t) m_AUStart;
+    m_AUStart = NOT_VALID;
+    if (m_AU.NumNALs == 0 || End <= Start) return;
+    m_AU.Data = m_Buffer.data() + Start;
+    m_AU.Size = (uint32_t) (End - Start);
+    m_NumAccessUnits++;
+    if (m_AU.Keyframe) m_NumKeyframes++;
+    xAccessUnit(m_AU);
+}
+
+void TS_AccessUnitSplitter::xCompact() {
+    //keep the access unit being collected, or the NAL unit being received (with possible zero_byte)
+    uint64_t Drop = m_AUStart != NOT_VALID ? (uint64_t) m_AUStart : m_NalStart != NOT_VALID ? (uint64_t) m_NalStart : m_ScanPos;
+    if (m_AUStart == NOT_VALID && Drop > 0) Drop--;
+    if (Drop == 0) return;
+    memmove(m_Buffer.data(), m_Buffer.data() + Drop, m_Size - Drop);
+    m_Size -= Drop;
+    m_ScanPos -= Drop;
+    if (m_NalStart != NOT_VALID) m_NalStart -= Drop;
+    if (m_AUStart != NOT_VALID) m_AUStart -= Drop;
+    for (xTimestamp &Timestamp : m_Timestamps) Timestamp.Pos = Timestamp.Pos > Drop ? Timestamp.Pos - Drop : 0;
+}
+
+//=============================================================================================================================================================================